@@ -0,0 +1,1213 @@
+#include "banphraseautomaton.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "logger.hpp"
+
+namespace
+{
+    std::atomic<std::uint64_t> next_automaton_id{ 1 };
+
+    std::atomic<std::uint64_t> budget_steps{ 1000000 };
+    std::atomic<std::int64_t> budget_us{ 50000 };
+
+    struct BudgetExceeded
+    {
+    };
+
+    // counts the moves of the boost matcher, the clock is only read every few thousand of them
+    struct StepBudget
+    {
+        std::uint64_t steps = 0;
+        std::uint64_t max_steps;
+        std::chrono::steady_clock::time_point deadline;
+        bool timed;
+
+        void step()
+        {
+            ++steps;
+            if (max_steps != 0 && steps > max_steps)
+            {
+                throw BudgetExceeded{};
+            }
+            if (timed && (steps & 4095) == 0 && std::chrono::steady_clock::now() > deadline)
+            {
+                throw BudgetExceeded{};
+            }
+        }
+    };
+
+    class BudgetedIterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = char;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char*;
+        using reference = const char&;
+
+        BudgetedIterator() = default;
+        BudgetedIterator(const char* position, StepBudget* budget)
+            : position(position)
+            , budget(budget)
+        {}
+
+        reference operator*() const { return *position; }
+        BudgetedIterator& operator++() { ++position; budget->step(); return *this; }
+        BudgetedIterator operator++(int) { auto old = *this; ++*this; return old; }
+        BudgetedIterator& operator--() { --position; budget->step(); return *this; }
+        BudgetedIterator operator--(int) { auto old = *this; --*this; return old; }
+        bool operator==(const BudgetedIterator& other) const { return position == other.position; }
+
+    private:
+        const char* position = nullptr;
+        StepBudget* budget = nullptr;
+    };
+
+    constexpr std::uint64_t pack(std::uint32_t pattern, std::uint32_t state)
+    {
+        return (static_cast<std::uint64_t>(pattern) << 32) | state;
+    }
+
+    // DFA state keys also hold the patterns matched on entering, so states only differing in those stay apart
+    constexpr std::uint32_t match_marker = 0xFFFFFFFF;
+    constexpr std::uint32_t end_match_marker = 0xFFFFFFFE;
+
+    struct Node
+    {
+        enum class Kind
+        {
+            Set,
+            Empty,
+            Concat,
+            Alt,
+            Repeat
+        };
+        Kind kind = Kind::Empty;
+        std::bitset<256> set;
+        std::vector<Node> children;
+        int min = 0;
+        // -1 for unbounded
+        int max = 0;
+    };
+
+    std::bitset<256> range_set(unsigned char first, unsigned char last)
+    {
+        std::bitset<256> set;
+        for (unsigned c = first; c <= last; ++c)
+        {
+            set.set(c);
+        }
+        return set;
+    }
+
+    std::bitset<256> digit_set()
+    {
+        return range_set('0', '9');
+    }
+
+    std::bitset<256> word_set()
+    {
+        return range_set('a', 'z') | range_set('A', 'Z') | digit_set() | range_set('_', '_');
+    }
+
+    std::bitset<256> space_set()
+    {
+        return range_set(' ', ' ') | range_set('\t', '\r');
+    }
+
+    // the subset of boost's perl syntax that keeps its meaning in an automaton, anything else fails the parse
+    class PatternParser
+    {
+    public:
+        explicit PatternParser(std::string_view pattern)
+            : pattern(pattern)
+        {}
+
+        std::optional<Node> parse(bool& anchored_start, bool& anchored_end)
+        {
+            if (peek('^'))
+            {
+                ++pos;
+                anchored_start = true;
+            }
+            auto root = parse_alt(0);
+            if (!ok || pos != pattern.size())
+            {
+                return std::nullopt;
+            }
+            anchored_end = this->anchored_end;
+            // ^a|b anchors only the first branch
+            if ((anchored_start || anchored_end) && root.kind == Node::Kind::Alt)
+            {
+                return std::nullopt;
+            }
+            return root;
+        }
+
+    private:
+        std::string_view pattern;
+        std::size_t pos = 0;
+        bool ok = true;
+        bool anchored_end = false;
+
+        static constexpr int max_depth = 64;
+
+        bool peek(char c) const
+        {
+            return pos < pattern.size() && pattern[pos] == c;
+        }
+
+        Node fail()
+        {
+            ok = false;
+            return Node{};
+        }
+
+        Node parse_alt(int depth)
+        {
+            if (depth > max_depth)
+            {
+                return fail();
+            }
+            Node alt;
+            alt.kind = Node::Kind::Alt;
+            alt.children.push_back(parse_concat(depth));
+            while (ok && peek('|'))
+            {
+                ++pos;
+                alt.children.push_back(parse_concat(depth));
+            }
+            if (alt.children.size() == 1)
+            {
+                return std::move(alt.children[0]);
+            }
+            return alt;
+        }
+
+        Node parse_concat(int depth)
+        {
+            Node concat;
+            concat.kind = Node::Kind::Concat;
+            while (ok && pos < pattern.size() && !peek('|') && !peek(')'))
+            {
+                concat.children.push_back(parse_repeat(depth));
+            }
+            return concat;
+        }
+
+        Node parse_repeat(int depth)
+        {
+            auto atom = parse_atom(depth);
+            while (ok && pos < pattern.size())
+            {
+                int min = 0;
+                int max = -1;
+                char c = pattern[pos];
+                if (c == '*')
+                {
+                    ++pos;
+                }
+                else if (c == '+')
+                {
+                    ++pos;
+                    min = 1;
+                }
+                else if (c == '?')
+                {
+                    ++pos;
+                    max = 1;
+                }
+                else if (c == '{')
+                {
+                    if (!parse_bounds(min, max))
+                    {
+                        return fail();
+                    }
+                }
+                else
+                {
+                    break;
+                }
+
+                if (atom.kind == Node::Kind::Empty)
+                {
+                    return fail();
+                }
+                // lazy quantifiers find the same matches, possessive ones do not
+                if (peek('?'))
+                {
+                    ++pos;
+                }
+                else if (peek('+'))
+                {
+                    return fail();
+                }
+
+                Node repeat;
+                repeat.kind = Node::Kind::Repeat;
+                repeat.min = min;
+                repeat.max = max;
+                repeat.children.push_back(std::move(atom));
+                atom = std::move(repeat);
+                // boost does not nest stacked quantifiers like a??+ or a*?{2}
+                if (pos < pattern.size() && std::string_view("*+?{").find(pattern[pos]) != std::string_view::npos)
+                {
+                    return fail();
+                }
+            }
+            return atom;
+        }
+
+        bool parse_number(int& value)
+        {
+            auto start = pos;
+            value = 0;
+            while (pos < pattern.size() && pattern[pos] >= '0' && pattern[pos] <= '9' && value < 100000)
+            {
+                value = value * 10 + (pattern[pos] - '0');
+                ++pos;
+            }
+            return pos != start;
+        }
+
+        bool parse_bounds(int& min, int& max)
+        {
+            ++pos;
+            if (!parse_number(min))
+            {
+                return false;
+            }
+            max = min;
+            if (peek(','))
+            {
+                ++pos;
+                max = -1;
+                if (!peek('}') && !parse_number(max))
+                {
+                    return false;
+                }
+            }
+            if (!peek('}') || (max != -1 && max < min))
+            {
+                return false;
+            }
+            ++pos;
+            return true;
+        }
+
+        Node set_node(const std::bitset<256>& set)
+        {
+            Node node;
+            node.kind = Node::Kind::Set;
+            node.set = set;
+            return node;
+        }
+
+        Node parse_atom(int depth)
+        {
+            char c = pattern[pos];
+            switch (c)
+            {
+            case '(':
+            {
+                ++pos;
+                if (peek('?'))
+                {
+                    if (pos + 1 >= pattern.size() || pattern[pos + 1] != ':')
+                    {
+                        return fail();
+                    }
+                    pos += 2;
+                }
+                auto inner = parse_alt(depth + 1);
+                if (!peek(')'))
+                {
+                    return fail();
+                }
+                ++pos;
+                return inner;
+            }
+            case '[':
+                ++pos;
+                return parse_class();
+            case '.':
+                ++pos;
+                return set_node(std::bitset<256>().set());
+            case '\\':
+            {
+                ++pos;
+                std::bitset<256> set;
+                if (!parse_escape(set))
+                {
+                    return fail();
+                }
+                return set_node(set);
+            }
+            case '$':
+                // only as the last character of the whole pattern
+                if (pos + 1 != pattern.size() || depth != 0)
+                {
+                    return fail();
+                }
+                ++pos;
+                anchored_end = true;
+                return Node{};
+            case ')':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case '^':
+                return fail();
+            default:
+                ++pos;
+                return set_node(range_set(static_cast<unsigned char>(c), static_cast<unsigned char>(c)));
+            }
+        }
+
+        // after the backslash, adds what the escape matches to set
+        bool parse_escape(std::bitset<256>& set)
+        {
+            if (pos >= pattern.size())
+            {
+                return false;
+            }
+            char c = pattern[pos++];
+            switch (c)
+            {
+            case 'd': set |= digit_set(); return true;
+            case 'D': set |= ~digit_set(); return true;
+            case 'w': set |= word_set(); return true;
+            case 'W': set |= ~word_set(); return true;
+            case 's': set |= space_set(); return true;
+            case 'S': set |= ~space_set(); return true;
+            case 't': set.set('\t'); return true;
+            case 'n': set.set('\n'); return true;
+            case 'r': set.set('\r'); return true;
+            case 'f': set.set('\f'); return true;
+            case 'a': set.set('\a'); return true;
+            case 'e': set.set(27); return true;
+            case 'x':
+            {
+                int value = 0;
+                for (int i = 0; i < 2; ++i)
+                {
+                    if (pos >= pattern.size() || !std::isxdigit(static_cast<unsigned char>(pattern[pos])))
+                    {
+                        return false;
+                    }
+                    char h = pattern[pos++];
+                    value = value * 16 + (h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+                }
+                set.set(value);
+                return true;
+            }
+            default:
+                // escaped punctuation is literal, other letters and digits are backreferences, assertions or classes we do not model;
+                // \< \> are word start and end and \` \' the buffer start and end in boost's perl syntax
+                if (std::isalnum(static_cast<unsigned char>(c)) || c == '<' || c == '>' || c == '`' || c == '\'')
+                {
+                    return false;
+                }
+                set.set(static_cast<unsigned char>(c));
+                return true;
+            }
+        }
+
+        // single byte of a class, false for a class escape as a range end
+        bool parse_class_byte(unsigned char& byte)
+        {
+            if (pattern[pos] != '\\')
+            {
+                byte = static_cast<unsigned char>(pattern[pos++]);
+                return true;
+            }
+            ++pos;
+            std::bitset<256> set;
+            if (!parse_escape(set) || set.count() != 1)
+            {
+                return false;
+            }
+            for (unsigned b = 0; b < 256; ++b)
+            {
+                if (set.test(b))
+                {
+                    byte = static_cast<unsigned char>(b);
+                }
+            }
+            return true;
+        }
+
+        Node parse_class()
+        {
+            std::bitset<256> set;
+            bool negate = false;
+            if (peek('^'))
+            {
+                ++pos;
+                negate = true;
+            }
+
+            bool first = true;
+            while (true)
+            {
+                if (pos >= pattern.size())
+                {
+                    return fail();
+                }
+                char c = pattern[pos];
+                if (c == ']' && !first)
+                {
+                    ++pos;
+                    break;
+                }
+                first = false;
+                // [:alpha:] and friends
+                if (c == '[' && pos + 1 < pattern.size() && (pattern[pos + 1] == ':' || pattern[pos + 1] == '.' || pattern[pos + 1] == '='))
+                {
+                    return fail();
+                }
+
+                if (c == '\\' && pos + 1 < pattern.size() && std::string_view("dDwWsS").find(pattern[pos + 1]) != std::string_view::npos)
+                {
+                    ++pos;
+                    parse_escape(set);
+                    continue;
+                }
+
+                unsigned char low = 0;
+                if (!parse_class_byte(low))
+                {
+                    return fail();
+                }
+                if (peek('-') && pos + 1 < pattern.size() && pattern[pos + 1] != ']')
+                {
+                    ++pos;
+                    unsigned char high = 0;
+                    // ranges are collation dependent outside ascii
+                    if (!parse_class_byte(high) || high < low || high >= 0x80)
+                    {
+                        return fail();
+                    }
+                    set |= range_set(low, high);
+                }
+                else
+                {
+                    set.set(low);
+                }
+            }
+
+            if (negate)
+            {
+                set.flip();
+            }
+            return set_node(set);
+        }
+    };
+
+    // Thompson construction, every node is compiled in front of the state it continues to
+    class NfaBuilder
+    {
+    public:
+        explicit NfaBuilder(BanphraseAutomaton::CompiledPattern& compiled)
+            : compiled(compiled)
+        {}
+
+        bool ok = true;
+
+        std::uint32_t add(BanphraseAutomaton::NfaState::Kind kind, std::uint32_t out = 0, std::uint32_t out1 = 0, std::uint32_t set = 0)
+        {
+            if (compiled.states.size() >= BanphraseAutomaton::max_pattern_states)
+            {
+                ok = false;
+                return 0;
+            }
+            compiled.states.push_back({ kind, set, out, out1 });
+            return static_cast<std::uint32_t>(compiled.states.size() - 1);
+        }
+
+        std::uint32_t build(const Node& node, std::uint32_t next)
+        {
+            using Kind = BanphraseAutomaton::NfaState::Kind;
+            if (!ok)
+            {
+                return 0;
+            }
+
+            switch (node.kind)
+            {
+            case Node::Kind::Empty:
+                return next;
+            case Node::Kind::Set:
+            {
+                compiled.sets.push_back(node.set);
+                for (unsigned b = 1; b < 256; ++b)
+                {
+                    if (node.set.test(b) != node.set.test(b - 1))
+                    {
+                        compiled.boundaries.set(b);
+                    }
+                }
+                return add(Kind::Byte, next, 0, static_cast<std::uint32_t>(compiled.sets.size() - 1));
+            }
+            case Node::Kind::Concat:
+            {
+                auto start = next;
+                for (auto it = node.children.rbegin(); it != node.children.rend(); ++it)
+                {
+                    start = build(*it, start);
+                }
+                return start;
+            }
+            case Node::Kind::Alt:
+            {
+                auto start = build(node.children.back(), next);
+                for (auto it = std::next(node.children.rbegin()); it != node.children.rend(); ++it)
+                {
+                    start = add(Kind::Split, build(*it, next), start);
+                }
+                return start;
+            }
+            case Node::Kind::Repeat:
+            {
+                auto&& child = node.children[0];
+                auto start = next;
+                if (node.max == -1)
+                {
+                    // loop: split back into the child or continue
+                    auto loop = add(Kind::Split);
+                    if (!ok)
+                    {
+                        return 0;
+                    }
+                    auto body = build(child, loop);
+                    compiled.states[loop].out = body;
+                    compiled.states[loop].out1 = next;
+                    start = loop;
+                }
+                else
+                {
+                    // each optional copy either continues to the next one or skips to next
+                    for (int i = node.min; i < node.max && ok; ++i)
+                    {
+                        start = add(Kind::Split, build(child, start), next);
+                    }
+                }
+                for (int i = 0; i < node.min && ok; ++i)
+                {
+                    start = build(child, start);
+                }
+                return start;
+            }
+            }
+            return next;
+        }
+
+    private:
+        BanphraseAutomaton::CompiledPattern& compiled;
+    };
+
+    void find_start_states(BanphraseAutomaton::CompiledPattern& compiled)
+    {
+        std::vector<bool> visited(compiled.states.size());
+        std::vector<std::uint32_t> stack{ compiled.start };
+        while (!stack.empty())
+        {
+            auto s = stack.back();
+            stack.pop_back();
+            if (visited[s])
+            {
+                continue;
+            }
+            visited[s] = true;
+            auto&& state = compiled.states[s];
+            if (state.kind == BanphraseAutomaton::NfaState::Kind::Byte)
+            {
+                compiled.start_states.push_back(s);
+                compiled.first_bytes |= compiled.sets[state.set];
+            }
+            else if (state.kind == BanphraseAutomaton::NfaState::Kind::Split)
+            {
+                stack.push_back(state.out1);
+                stack.push_back(state.out);
+            }
+        }
+    }
+
+    bool is_nullable(const BanphraseAutomaton::CompiledPattern& compiled)
+    {
+        std::vector<bool> visited(compiled.states.size());
+        std::vector<std::uint32_t> stack{ compiled.start };
+        while (!stack.empty())
+        {
+            auto s = stack.back();
+            stack.pop_back();
+            if (visited[s])
+            {
+                continue;
+            }
+            visited[s] = true;
+            auto&& state = compiled.states[s];
+            if (state.kind == BanphraseAutomaton::NfaState::Kind::Match)
+            {
+                return true;
+            }
+            if (state.kind == BanphraseAutomaton::NfaState::Kind::Split)
+            {
+                stack.push_back(state.out);
+                stack.push_back(state.out1);
+            }
+        }
+        return false;
+    }
+}
+
+std::shared_ptr<const BanphraseAutomaton::CompiledPattern> BanphraseAutomaton::compile(std::string_view pattern)
+{
+    auto compiled = std::make_shared<CompiledPattern>();
+    PatternParser parser(pattern);
+    auto root = parser.parse(compiled->anchored_start, compiled->anchored_end);
+    if (!root)
+    {
+        return nullptr;
+    }
+
+    NfaBuilder builder(*compiled);
+    auto match = builder.add(NfaState::Kind::Match);
+    compiled->start = builder.build(*root, match);
+    // an empty match counts at every position with boost, leave those patterns to it
+    if (!builder.ok || is_nullable(*compiled))
+    {
+        return nullptr;
+    }
+    find_start_states(*compiled);
+    return compiled;
+}
+
+BanphraseAutomaton::BanphraseAutomaton(const std::vector<std::pair<boost::regex, int>>& banphrases, const BanphraseAutomaton* previous)
+    : id(next_automaton_id.fetch_add(1, std::memory_order_relaxed))
+{
+    std::unordered_map<std::string, const Pattern*> reusable;
+    if (previous)
+    {
+        for (auto&& pattern : previous->patterns)
+        {
+            reusable.emplace(pattern.regex.str(), &pattern);
+        }
+    }
+
+    std::bitset<256> boundaries;
+    std::vector<std::string> literals;
+    for (auto&& [regex, timeout] : banphrases)
+    {
+        auto index = static_cast<std::uint32_t>(patterns.size());
+        auto expression = regex.str();
+        std::shared_ptr<const CompiledPattern> compiled;
+        std::shared_ptr<PatternStats> stats;
+        if (auto it = reusable.find(expression); it != reusable.end())
+        {
+            compiled = it->second->compiled;
+            stats = it->second->stats;
+        }
+        else
+        {
+            compiled = compile(expression);
+            stats = std::make_shared<PatternStats>();
+        }
+
+        // literals are matched case sensitively
+        auto literal = regex.flags() & boost::regex_constants::icase ? std::string() : LiteralPrefilter::required_literal(expression);
+        literals.push_back(literal);
+        patterns.push_back(Pattern{ regex, timeout, compiled, std::move(literal), std::move(stats) });
+        if (!compiled)
+        {
+            fallback_indexes.push_back(index);
+            if (literals.back().empty())
+            {
+                unfiltered_fallback_indexes.push_back(index);
+            }
+            continue;
+        }
+        compiled_indexes.push_back(index);
+        if (!literals.back().empty())
+        {
+            // run on its own where the prefilter finds the literal, a union with thousands of such
+            // patterns makes DFA states too large to build on every new byte
+            continue;
+        }
+        dfa_unfiltered = true;
+        boundaries |= compiled->boundaries;
+        (compiled->anchored_start ? anchored_starts : unanchored_starts).push_back(pack(index, compiled->start));
+    }
+
+    for (unsigned b = 0; b < 256; ++b)
+    {
+        if (b == 0 || boundaries.test(b))
+        {
+            class_representatives.push_back(static_cast<std::uint8_t>(b));
+        }
+        byte_classes[b] = static_cast<std::uint8_t>(class_representatives.size() - 1);
+    }
+    class_count = static_cast<std::uint16_t>(class_representatives.size());
+    prefilter = LiteralPrefilter(literals);
+}
+
+const std::vector<BanphraseAutomaton::Pattern>& BanphraseAutomaton::get_patterns() const
+{
+    return patterns;
+}
+
+std::size_t BanphraseAutomaton::fallback_count() const
+{
+    return fallback_indexes.size();
+}
+
+// lazily built DFA of one automaton, every thread keeps its own so matching never locks
+struct BanphraseDfa
+{
+    struct State
+    {
+        std::vector<std::uint64_t> key;
+        std::vector<std::uint32_t> matches;
+        std::vector<std::uint32_t> end_matches;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const std::vector<std::uint64_t>& key) const
+        {
+            std::uint64_t h = 14695981039346656037ull;
+            for (auto v : key)
+            {
+                h = (h ^ v) * 1099511628211ull;
+            }
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    std::uint64_t automaton_id = 0;
+    std::uint16_t class_count = 0;
+    std::vector<State> states;
+    // class_count entries per state, -1 until computed
+    std::vector<std::int32_t> transitions;
+    std::unordered_map<std::vector<std::uint64_t>, std::int32_t, KeyHash> index;
+    // the unanchored starts stepped over each class, the same for every state
+    std::vector<std::optional<std::vector<std::uint64_t>>> start_steps;
+
+    std::unordered_set<std::uint64_t> visited;
+    std::vector<std::uint32_t> stack;
+    State scratch;
+
+    std::vector<std::uint32_t> found_generation;
+    std::uint32_t generation = 0;
+
+    void reset(const BanphraseAutomaton& automaton)
+    {
+        automaton_id = automaton.id;
+        class_count = automaton.class_count;
+        states.clear();
+        transitions.clear();
+        index.clear();
+        start_steps.assign(class_count, std::nullopt);
+        found_generation.assign(automaton.patterns.size(), 0);
+        generation = 0;
+        add_initial_state(automaton);
+    }
+
+    void add_initial_state(const BanphraseAutomaton& automaton)
+    {
+        begin_state();
+        for (auto start : automaton.anchored_starts)
+        {
+            closure(automaton, start);
+        }
+        finish_state();
+    }
+
+    void begin_state()
+    {
+        visited.clear();
+        scratch.key.clear();
+        scratch.matches.clear();
+        scratch.end_matches.clear();
+    }
+
+    void closure(const BanphraseAutomaton& automaton, std::uint64_t seed)
+    {
+        auto pattern = static_cast<std::uint32_t>(seed >> 32);
+        auto&& compiled = *automaton.patterns[pattern].compiled;
+        stack.push_back(static_cast<std::uint32_t>(seed));
+        while (!stack.empty())
+        {
+            auto s = stack.back();
+            stack.pop_back();
+            if (!visited.insert(pack(pattern, s)).second)
+            {
+                continue;
+            }
+            auto&& state = compiled.states[s];
+            switch (state.kind)
+            {
+            case BanphraseAutomaton::NfaState::Kind::Byte:
+                scratch.key.push_back(pack(pattern, s));
+                break;
+            case BanphraseAutomaton::NfaState::Kind::Split:
+                stack.push_back(state.out1);
+                stack.push_back(state.out);
+                break;
+            case BanphraseAutomaton::NfaState::Kind::Match:
+                (compiled.anchored_end ? scratch.end_matches : scratch.matches).push_back(pattern);
+                scratch.key.push_back(pack(pattern, compiled.anchored_end ? end_match_marker : match_marker));
+                break;
+            }
+        }
+    }
+
+    // successors of the Byte states in key over byte, not yet closed
+    static void step_states(const BanphraseAutomaton& automaton, const std::vector<std::uint64_t>& key, std::uint8_t byte, std::vector<std::uint64_t>& out)
+    {
+        for (auto id : key)
+        {
+            if (static_cast<std::uint32_t>(id) >= end_match_marker)
+            {
+                continue;
+            }
+            auto pattern = static_cast<std::uint32_t>(id >> 32);
+            auto&& compiled = *automaton.patterns[pattern].compiled;
+            auto&& state = compiled.states[static_cast<std::uint32_t>(id)];
+            if (compiled.sets[state.set].test(byte))
+            {
+                out.push_back(pack(pattern, state.out));
+            }
+        }
+    }
+
+    const std::vector<std::uint64_t>& start_step(const BanphraseAutomaton& automaton, std::uint16_t byte_class)
+    {
+        auto&& step = start_steps[byte_class];
+        if (!step)
+        {
+            // closures of the starts are fixed, the byte states they reach are cached per class
+            std::vector<std::uint64_t> starts;
+            for (auto start : automaton.unanchored_starts)
+            {
+                begin_state();
+                closure(automaton, start);
+                starts.insert(starts.end(), scratch.key.begin(), scratch.key.end());
+            }
+            step.emplace();
+            step_states(automaton, starts, automaton.class_representatives[byte_class], *step);
+        }
+        return *step;
+    }
+
+    std::int32_t finish_state()
+    {
+        std::sort(scratch.key.begin(), scratch.key.end());
+        if (auto it = index.find(scratch.key); it != index.end())
+        {
+            return it->second;
+        }
+        auto id = static_cast<std::int32_t>(states.size());
+        index.emplace(scratch.key, id);
+        states.push_back(scratch);
+        transitions.resize(transitions.size() + class_count, -1);
+        return id;
+    }
+
+    std::int32_t step(const BanphraseAutomaton& automaton, std::int32_t from, std::uint16_t byte_class)
+    {
+        std::vector<std::uint64_t> seeds;
+        step_states(automaton, states[from].key, automaton.class_representatives[byte_class], seeds);
+        auto&& starts = start_step(automaton, byte_class);
+        seeds.insert(seeds.end(), starts.begin(), starts.end());
+
+        begin_state();
+        for (auto seed : seeds)
+        {
+            closure(automaton, seed);
+        }
+
+        if (states.size() >= BanphraseAutomaton::max_dfa_states)
+        {
+            // start over, keeping only the state about to be entered
+            auto next = std::move(scratch);
+            states.clear();
+            transitions.clear();
+            index.clear();
+            add_initial_state(automaton);
+            scratch = std::move(next);
+            return finish_state();
+        }
+
+        auto to = finish_state();
+        transitions[static_cast<std::size_t>(from) * class_count + byte_class] = to;
+        return to;
+    }
+
+    void record(const std::vector<std::uint32_t>& patterns, std::vector<std::size_t>& matches)
+    {
+        for (auto pattern : patterns)
+        {
+            if (found_generation[pattern] != generation)
+            {
+                found_generation[pattern] = generation;
+                matches.push_back(pattern);
+            }
+        }
+    }
+};
+
+namespace
+{
+    thread_local BanphraseDfa thread_dfa;
+
+    // the NFA of a single pattern simulated over a line, for compiled patterns outside the DFA
+    struct PatternRun
+    {
+        std::vector<std::uint32_t> current;
+        std::vector<std::uint32_t> next;
+        std::vector<std::uint32_t> stack;
+        // generation each NFA state was last added in
+        std::vector<std::uint32_t> added;
+        std::uint32_t generation = 0;
+
+        void next_generation()
+        {
+            if (++generation == 0)
+            {
+                std::fill(added.begin(), added.end(), 0);
+                generation = 1;
+            }
+        }
+
+        // adds the Byte states reachable from s to to, true when the Match state is reachable
+        bool add(const BanphraseAutomaton::CompiledPattern& compiled, std::uint32_t s, std::vector<std::uint32_t>& to)
+        {
+            bool matched = false;
+            stack.push_back(s);
+            while (!stack.empty())
+            {
+                auto t = stack.back();
+                stack.pop_back();
+                if (added[t] == generation)
+                {
+                    continue;
+                }
+                added[t] = generation;
+                auto&& state = compiled.states[t];
+                switch (state.kind)
+                {
+                case BanphraseAutomaton::NfaState::Kind::Byte:
+                    to.push_back(t);
+                    break;
+                case BanphraseAutomaton::NfaState::Kind::Split:
+                    stack.push_back(state.out1);
+                    stack.push_back(state.out);
+                    break;
+                case BanphraseAutomaton::NfaState::Kind::Match:
+                    matched = true;
+                    break;
+                }
+            }
+            return matched;
+        }
+
+        bool matches(const BanphraseAutomaton::CompiledPattern& compiled, std::string_view line)
+        {
+            if (added.size() < compiled.states.size())
+            {
+                added.resize(compiled.states.size(), 0);
+            }
+            current.clear();
+            for (std::size_t i = 0; i < line.size(); ++i)
+            {
+                auto byte = static_cast<unsigned char>(line[i]);
+                bool starts = i == 0 || !compiled.anchored_start;
+                // nothing in progress, only a byte a match can begin with needs work
+                if (current.empty() && !(starts && compiled.first_bytes.test(byte)))
+                {
+                    if (!starts)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+
+                bool at_end = i + 1 == line.size();
+                next_generation();
+                next.clear();
+                auto step = [&](std::uint32_t s)
+                {
+                    auto&& state = compiled.states[s];
+                    return compiled.sets[state.set].test(byte) && add(compiled, state.out, next) && (!compiled.anchored_end || at_end);
+                };
+                for (auto s : current)
+                {
+                    if (step(s))
+                    {
+                        return true;
+                    }
+                }
+                if (starts)
+                {
+                    // compiled patterns never match the empty string, a match needs at least this byte
+                    for (auto s : compiled.start_states)
+                    {
+                        if (step(s))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                std::swap(current, next);
+            }
+            return false;
+        }
+    };
+
+    thread_local PatternRun thread_pattern_run;
+}
+
+void BanphraseAutomaton::find_matches(std::string_view line, std::vector<std::size_t>& matches, const boost::dynamic_bitset<>* scope) const
+{
+    auto in_scope = [this, scope](std::size_t index)
+    {
+        return (!scope || scope->test(index)) && !patterns[index].stats->disabled.load(std::memory_order_relaxed);
+    };
+
+    thread_local std::vector<std::uint32_t> candidates;
+    candidates.clear();
+    prefilter.find(line, candidates);
+
+    // compiled patterns with a literal are only run where the prefilter found it
+    for (auto index : candidates)
+    {
+        if (patterns[index].compiled && in_scope(index) && thread_pattern_run.matches(*patterns[index].compiled, line))
+        {
+            matches.push_back(index);
+        }
+    }
+
+    if (dfa_unfiltered)
+    {
+        auto&& dfa = thread_dfa;
+        if (dfa.automaton_id != id)
+        {
+            dfa.reset(*this);
+        }
+        if (++dfa.generation == 0)
+        {
+            std::fill(dfa.found_generation.begin(), dfa.found_generation.end(), 0);
+            dfa.generation = 1;
+        }
+
+        auto first_match = matches.size();
+        std::int32_t state = 0;
+        for (char c : line)
+        {
+            auto byte_class = byte_classes[static_cast<unsigned char>(c)];
+            auto next = dfa.transitions[static_cast<std::size_t>(state) * class_count + byte_class];
+            state = next >= 0 ? next : dfa.step(*this, state, byte_class);
+            if (!dfa.states[state].matches.empty())
+            {
+                dfa.record(dfa.states[state].matches, matches);
+            }
+        }
+        dfa.record(dfa.states[state].end_matches, matches);
+        matches.erase(std::remove_if(matches.begin() + static_cast<std::ptrdiff_t>(first_match), matches.end(), [&](std::size_t index) { return !in_scope(index); }), matches.end());
+    }
+
+    auto search = [&](std::uint32_t index)
+    {
+        if (in_scope(index) && run_regex(index, line, false).value_or(0) > 0)
+        {
+            matches.push_back(index);
+        }
+    };
+    for (auto index : unfiltered_fallback_indexes)
+    {
+        search(index);
+    }
+    for (auto index : candidates)
+    {
+        if (!patterns[index].compiled)
+        {
+            search(index);
+        }
+    }
+}
+
+void BanphraseAutomaton::set_budget(std::uint64_t max_steps, std::chrono::microseconds max_time)
+{
+    budget_steps.store(max_steps, std::memory_order_relaxed);
+    budget_us.store(max_time.count(), std::memory_order_relaxed);
+}
+
+std::optional<std::size_t> BanphraseAutomaton::run_regex(std::size_t index, std::string_view line, bool count_all) const
+{
+    auto&& pattern = patterns[index];
+    auto&& stats = *pattern.stats;
+    auto started = std::chrono::steady_clock::now();
+    auto time_limit = budget_us.load(std::memory_order_relaxed);
+    StepBudget budget{ 0, budget_steps.load(std::memory_order_relaxed), started + std::chrono::microseconds(time_limit), time_limit > 0 };
+
+    std::optional<std::size_t> count = 0;
+    try
+    {
+        BudgetedIterator begin(line.data(), &budget);
+        BudgetedIterator end(line.data() + line.size(), &budget);
+        if (count_all)
+        {
+            boost::regex_iterator<BudgetedIterator> it(begin, end, pattern.regex);
+            for (boost::regex_iterator<BudgetedIterator> last; it != last; ++it)
+            {
+                ++*count;
+            }
+        }
+        else
+        {
+            *count = boost::regex_search(begin, end, pattern.regex) ? 1 : 0;
+        }
+    }
+    catch (const BudgetExceeded&)
+    {
+        count = std::nullopt;
+    }
+    catch (const std::runtime_error&)
+    {
+        // boost's own complexity limit
+        count = std::nullopt;
+    }
+
+    auto elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+    stats.evaluations.fetch_add(1, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(elapsed, std::memory_order_relaxed);
+    auto max = stats.max_ns.load(std::memory_order_relaxed);
+    while (elapsed > max && !stats.max_ns.compare_exchange_weak(max, elapsed, std::memory_order_relaxed))
+    {
+    }
+
+    if (!count)
+    {
+        stats.aborts.fetch_add(1, std::memory_order_relaxed);
+        if (!stats.disabled.exchange(true, std::memory_order_relaxed))
+        {
+            log_warning(LogCategory::Commands, "Banphrase " + pattern.regex.str() + " exceeded its budget after " + std::to_string(budget.steps) + " steps, disabled");
+        }
+        return std::nullopt;
+    }
+    // a fallback pattern runs twice on a matching line, hits come from the counting run only
+    if (count_all && *count > 0)
+    {
+        stats.hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    return count;
+}
\ No newline at end of file
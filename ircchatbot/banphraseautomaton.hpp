@@ -0,0 +1,138 @@
+#ifndef BANPHRASEAUTOMATON_HPP_
+#define BANPHRASEAUTOMATON_HPP_
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/regex.hpp>
+
+#include "literalprefilter.hpp"
+
+// all banphrases in one automaton: every pattern is compiled to its own NFA. Patterns without a
+// required literal are matched by walking a lazily built DFA over the union of their NFAs, so one
+// pass over a line finds every one of them that matches somewhere in it; patterns with a literal
+// have their NFA simulated only on lines where the prefilter found the literal. Patterns outside
+// the supported syntax (backreferences, lookaround, \b, inline flags, patterns matching the empty
+// string, ...) are run with boost::regex instead, also only where their literal occurs
+class BanphraseAutomaton
+{
+public:
+    struct NfaState
+    {
+        enum class Kind : std::uint8_t
+        {
+            Byte,
+            Split,
+            Match
+        };
+        Kind kind;
+        // Byte: index into CompiledPattern::sets
+        std::uint32_t set = 0;
+        std::uint32_t out = 0;
+        std::uint32_t out1 = 0;
+    };
+
+    struct CompiledPattern
+    {
+        std::vector<NfaState> states;
+        std::vector<std::bitset<256>> sets;
+        std::uint32_t start = 0;
+        // ^ at the start, only tried from the first byte
+        bool anchored_start = false;
+        // $ at the end, only matches at the end of the line
+        bool anchored_end = false;
+        // bytes where some set changes membership, used to build the byte classes
+        std::bitset<256> boundaries;
+        // Byte states right at the start and the bytes they take, a line is only simulated from where a match can begin
+        std::vector<std::uint32_t> start_states;
+        std::bitset<256> first_bytes;
+    };
+
+    // nullptr when the pattern needs boost::regex
+    static std::shared_ptr<const CompiledPattern> compile(std::string_view pattern);
+
+    // kept across rebuilds while the pattern exists, updated from any thread
+    struct PatternStats
+    {
+        // boost::regex runs: searches of fallback patterns and match counting of matched ones
+        std::atomic<std::uint64_t> evaluations{ 0 };
+        // lines the pattern matched in
+        std::atomic<std::uint64_t> hits{ 0 };
+        std::atomic<std::uint64_t> total_ns{ 0 };
+        std::atomic<std::uint64_t> max_ns{ 0 };
+        std::atomic<std::uint64_t> aborts{ 0 };
+        // set when a run exceeded the budget, the pattern is skipped from then on
+        std::atomic<bool> disabled{ false };
+    };
+
+    struct Pattern
+    {
+        boost::regex regex;
+        int timeout;
+        std::shared_ptr<const CompiledPattern> compiled;
+        // every match contains it, empty when the pattern requires none
+        std::string literal;
+        std::shared_ptr<PatternStats> stats;
+    };
+
+    // regex and timeout of every banphrase, their order gives the pattern indexes;
+    // patterns already compiled in previous are shared instead of compiled again
+    BanphraseAutomaton(const std::vector<std::pair<boost::regex, int>>& banphrases, const BanphraseAutomaton* previous = nullptr);
+    BanphraseAutomaton(const BanphraseAutomaton&) = delete;
+    BanphraseAutomaton& operator=(const BanphraseAutomaton&) = delete;
+
+    const std::vector<Pattern>& get_patterns() const;
+    std::size_t fallback_count() const;
+
+    // indexes into get_patterns() of every pattern matching somewhere in line, safe from any thread;
+    // with a scope only patterns whose bit is set there are reported
+    void find_matches(std::string_view line, std::vector<std::size_t>& matches, const boost::dynamic_bitset<>* scope = nullptr) const;
+
+    // runs the boost::regex of a pattern over line within the budget, counting every match or stopping
+    // at the first; nullopt when the budget ran out or boost gave up, the pattern is disabled then
+    std::optional<std::size_t> run_regex(std::size_t index, std::string_view line, bool count_all) const;
+
+    // limits of a single run_regex, steps are iterator moves of the boost matcher; 0 for no limit
+    static void set_budget(std::uint64_t max_steps, std::chrono::microseconds max_time);
+
+    // per thread DFA cache limit, the cache starts over when it is exceeded
+    static constexpr std::size_t max_dfa_states = 4096;
+    // longer patterns, mostly from large {m,n}, go to boost::regex
+    static constexpr std::size_t max_pattern_states = 4096;
+
+private:
+    // unique per automaton, the thread local DFA caches are keyed by it
+    std::uint64_t id;
+    std::vector<Pattern> patterns;
+    std::vector<std::uint32_t> compiled_indexes;
+    std::vector<std::uint32_t> fallback_indexes;
+
+    LiteralPrefilter prefilter;
+    // some compiled pattern has no literal, the DFA of those runs on every line
+    bool dfa_unfiltered = false;
+    std::vector<std::uint32_t> unfiltered_fallback_indexes;
+
+    std::uint16_t class_count = 0;
+    std::array<std::uint8_t, 256> byte_classes{};
+    // one byte of every class
+    std::vector<std::uint8_t> class_representatives;
+
+    // start states of the DFA patterns as pattern << 32 | nfa state, DFA states are sets of such Byte states
+    std::vector<std::uint64_t> anchored_starts;
+    std::vector<std::uint64_t> unanchored_starts;
+
+    friend struct BanphraseDfa;
+};
+
+#endif // BANPHRASEAUTOMATON_HPP_
\ No newline at end of file
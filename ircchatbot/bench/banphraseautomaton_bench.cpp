@@ -0,0 +1,133 @@
+#include "../banphraseautomaton.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "timing.hpp"
+
+// BanphraseAutomaton::find_matches against running every boost::regex over the line one after
+// another, the way is_banphrased checked lines before the automaton, for 10, 1k and 10k patterns
+
+namespace
+{
+
+std::string random_word(std::mt19937& random, std::size_t min_length, std::size_t max_length)
+{
+    std::uniform_int_distribution<std::size_t> length(min_length, max_length);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string word(length(random), ' ');
+    for (auto&& c : word)
+    {
+        c = static_cast<char>(letter(random));
+    }
+    return word;
+}
+
+// the shapes banphrases usually have: words, look-alike classes, optional separators and alternations
+std::vector<std::pair<boost::regex, int>> make_banphrases(std::size_t count, std::mt19937& random)
+{
+    std::vector<std::pair<boost::regex, int>> banphrases;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto word = random_word(random, 6, 10);
+        std::string phrase;
+        switch (i % 4)
+        {
+        case 0:
+            phrase = word;
+            break;
+        case 1:
+            phrase = word.substr(0, 2) + "[a4@]" + word.substr(3);
+            break;
+        case 2:
+            phrase = word.substr(0, 3) + "\\s*" + word.substr(3) + "\\d+";
+            break;
+        case 3:
+            phrase = "(" + word.substr(0, 4) + "|" + random_word(random, 5, 7) + ")" + word.substr(4);
+            break;
+        }
+        banphrases.emplace_back(boost::regex(phrase, boost::regex_constants::no_except), 1);
+    }
+    return banphrases;
+}
+
+// chat lines of 5 to 15 short words
+std::vector<std::string> make_lines(std::size_t count, std::mt19937& random)
+{
+    std::uniform_int_distribution<std::size_t> words(5, 15);
+    std::vector<std::string> lines;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string line;
+        for (std::size_t n = words(random); n > 0; --n)
+        {
+            line += random_word(random, 2, 7);
+            line += ' ';
+        }
+        line.pop_back();
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+std::size_t total_bytes(const std::vector<std::string>& lines)
+{
+    std::size_t bytes = 0;
+    for (auto&& line : lines)
+    {
+        bytes += line.size();
+    }
+    return bytes;
+}
+
+}
+
+int main()
+{
+    std::mt19937 random(36);
+    auto lines = make_lines(2000, random);
+    // the regex loop at 10k patterns needs a while per line
+    std::vector<std::string> few_lines(lines.begin(), lines.begin() + 50);
+
+    for (std::size_t count : { 10, 1000, 10000 })
+    {
+        auto banphrases = make_banphrases(count, random);
+
+        auto build_started = std::chrono::steady_clock::now();
+        BanphraseAutomaton automaton(banphrases);
+        auto build_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - build_started);
+        std::printf("%zu patterns, %zu on boost::regex, built in %lld us\n", count, automaton.fallback_count(), static_cast<long long>(build_time.count()));
+
+        std::vector<std::size_t> matches;
+        measure("  automaton", total_bytes(lines), lines.size(), [&]
+        {
+            std::size_t found = 0;
+            for (auto&& line : lines)
+            {
+                matches.clear();
+                automaton.find_matches(line, matches);
+                found += matches.size();
+            }
+            return found;
+        });
+
+        auto&& loop_lines = count > 1000 ? few_lines : lines;
+        measure("  boost::regex loop", total_bytes(loop_lines), loop_lines.size(), [&]
+        {
+            std::size_t found = 0;
+            for (auto&& line : loop_lines)
+            {
+                for (auto&& [regex, timeout] : banphrases)
+                {
+                    found += boost::regex_search(line, regex);
+                }
+            }
+            return found;
+        });
+    }
+    return 0;
+}
\ No newline at end of file
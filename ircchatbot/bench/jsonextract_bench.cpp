@@ -0,0 +1,75 @@
+#include "../jsonextract.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "timing.hpp"
+
+// JsonExtractor over an 8 MiB generated API response fed in 16 KiB chunks as curl hands them over: the value
+// at the very end, so everything before it is skipped, and the value near the start, where feeding stops
+// with the first chunk
+
+namespace
+{
+
+// an array of objects with strings, escapes, numbers and nested containers, then the looked for member
+std::string make_document(std::size_t size, std::mt19937& random)
+{
+    std::uniform_int_distribution<int> number(0, 1000000);
+    std::string document = R"({"first": "at the start", "items": [)";
+    for (std::size_t i = 0; document.size() < size; ++i)
+    {
+        auto n = std::to_string(number(random));
+        document += i == 0 ? "" : ",";
+        document += R"({"id": )" + std::to_string(i) + R"(, "name": "user)" + n + R"(", "bio": "says \"hi\" and \\o/ \u00e9\ud83d\ude00 [not] {json}",)"
+            + R"( "score": -)" + n + R"(.5e2, "flags": [true, false, null], "stats": {"views": )" + n + R"(, "tags": ["a", "b", [1, [2]]]}})";
+    }
+    document += R"(], "last": {"value": "found it"}})";
+    return document;
+}
+
+}
+
+int main()
+{
+    std::mt19937 random(50);
+    auto document = make_document(8u << 20, random);
+    constexpr std::size_t chunk = 16384;
+
+    for (auto&& [path, expected] : { std::pair{ "$.last.value", "found it" }, std::pair{ "$.first", "at the start" } })
+    {
+        auto steps = *JsonExtractor::parse_path(path);
+        // the bytes handed over until the result is known, MB/s are over those
+        auto extract = [&](std::size_t& fed)
+        {
+            JsonExtractor extractor(steps, 400);
+            fed = 0;
+            while (fed < document.size())
+            {
+                auto piece = std::string_view(document).substr(fed, chunk);
+                fed += piece.size();
+                if (extractor.feed(piece) != JsonExtractor::Result::NeedMore)
+                {
+                    break;
+                }
+            }
+            return extractor.take_value() == expected ? std::size_t(1) : std::size_t(0);
+        };
+        std::size_t fed = 0;
+        if (extract(fed) != 1)
+        {
+            std::printf("%s not found\n", path);
+            return 1;
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "extract %s, %zu bytes fed", path, fed);
+        measure(name, fed, 1, [&]
+        {
+            return extract(fed);
+        });
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "../messageshape.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "timing.hpp"
+
+// MessageShape::measure over chat lines of 40 to 500 bytes and over 64 KiB blocks, of plain ascii and of emoji and art, the messageshape_avx2_bench
+// build of this file takes the AVX2 path
+
+namespace
+{
+
+const std::vector<std::string> ascii_words{
+    "hello", "chat", "KEKW", "what", "is", "this", "LULW", "omg", "no", "way", "123", "!!!", "PogChamp",
+};
+
+// the same words with the odd emoji, emoji with skin tone and piece of braille art between them
+const std::vector<std::string> mixed_words{
+    "hello", "chat", "KEKW", "what", "is", "this", "LULW", "omg", "no", "way", "123", "!!!", "PogChamp",
+    "\xF0\x9F\x98\x82", "\xF0\x9F\x91\x8B\xF0\x9F\x8F\xBB", "\xE2\xA3\xBF\xE2\xA3\xBF\xE2\xA0\x80", "caf\xC3\xA9",
+};
+
+std::string make_line(const std::vector<std::string>& words, std::size_t length, std::mt19937& random)
+{
+    std::uniform_int_distribution<std::size_t> word(0, words.size() - 1);
+    std::string line;
+    while (line.size() < length)
+    {
+        line += words[word(random)];
+        line += ' ';
+    }
+    line.resize(length);
+    return line;
+}
+
+std::size_t total_bytes(const std::vector<std::string>& lines)
+{
+    std::size_t bytes = 0;
+    for (auto&& line : lines)
+    {
+        bytes += line.size();
+    }
+    return bytes;
+}
+
+}
+
+int main()
+{
+#if defined(__AVX2__)
+    std::printf("AVX2 build\n");
+#elif defined(__SSE2__)
+    std::printf("SSE2 build\n");
+#else
+    std::printf("scalar build\n");
+#endif
+
+    std::mt19937 random(41);
+    for (auto&& [words, kind] : { std::pair{ &ascii_words, "ascii" }, std::pair{ &mixed_words, "emoji and art" } })
+    {
+        for (std::size_t length : { 40, 120, 500, 65536 })
+        {
+            std::vector<std::string> lines;
+            for (std::size_t total = 0; total < (1u << 18); total += length)
+            {
+                lines.push_back(make_line(*words, length, random));
+            }
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "measure, %zu byte %s lines", length, kind);
+            measure(name, total_bytes(lines), lines.size(), [&]
+            {
+                std::size_t sum = 0;
+                for (auto&& line : lines)
+                {
+                    auto shape = MessageShape::measure(line);
+                    sum += shape.letters + shape.symbols + shape.graphemes + shape.longest_run;
+                }
+                return sum;
+            });
+        }
+    }
+    return 0;
+}
\ No newline at end of file
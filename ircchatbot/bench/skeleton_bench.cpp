@@ -0,0 +1,92 @@
+#include "../skeleton.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "timing.hpp"
+
+// the cost Skeleton::fold adds in front of banphrase matching: ascii lines that are passed through as they
+// are, and lines of 40 to 500 bytes with accented, cyrillic, fullwidth and styled letters and zero width
+// characters that are folded into the buffer
+
+namespace
+{
+
+const std::vector<std::string> ascii_words{
+    "hello", "chat", "KEKW", "what", "is", "this", "LULW", "omg", "no", "way", "123", "!!!", "PogChamp",
+};
+
+// looks of "hello": accented, cyrillic, with a zero width space and a combining mark
+const std::vector<std::string> latin_words{
+    "hello", "chat", "KEKW", "what", "is", "this", "LULW", "omg", "no", "way", "123", "!!!", "PogChamp",
+    "h\xC3\xA9llo", "\xD1\x81hat", "h\xD0\xB5ll\xD0\xBE", "he\xE2\x80\x8Bllo", "he\xCC\x81llo",
+};
+
+// fullwidth, mathematical bold and circled letters, all three and four byte code points
+const std::vector<std::string> wide_words{
+    "hello", "chat", "KEKW", "what", "is", "this", "LULW", "omg", "no", "way", "123", "!!!", "PogChamp",
+    "\xEF\xBD\x88\xEF\xBD\x85\xEF\xBD\x8C\xEF\xBD\x8C\xEF\xBD\x8F", "\xF0\x9D\x90\xA1\xF0\x9D\x90\x9E\xF0\x9D\x90\xA5\xF0\x9D\x90\xA5\xF0\x9D\x90\xA8",
+    "\xE2\x93\x97\xE2\x93\x94\xE2\x93\x9B\xE2\x93\x9B\xE2\x93\x9E",
+};
+
+std::string make_line(const std::vector<std::string>& words, std::size_t length, std::mt19937& random)
+{
+    std::uniform_int_distribution<std::size_t> word(0, words.size() - 1);
+    std::string line;
+    while (line.size() < length)
+    {
+        line += words[word(random)];
+        line += ' ';
+    }
+    // whole words only, a code point cut in half would not be folded
+    while (line.size() > length && line.find(' ') != line.rfind(' '))
+    {
+        line.erase(line.rfind(' ', line.size() - 2) + 1);
+    }
+    return line;
+}
+
+std::size_t total_bytes(const std::vector<std::string>& lines)
+{
+    std::size_t bytes = 0;
+    for (auto&& line : lines)
+    {
+        bytes += line.size();
+    }
+    return bytes;
+}
+
+}
+
+int main()
+{
+    std::mt19937 random(45);
+    for (auto&& [words, kind] : { std::pair{ &ascii_words, "ascii" }, std::pair{ &latin_words, "latin and cyrillic" }, std::pair{ &wide_words, "wide" } })
+    {
+        for (std::size_t length : { 40, 120, 500 })
+        {
+            std::vector<std::string> lines;
+            for (std::size_t total = 0; total < (1u << 18); total += length)
+            {
+                lines.push_back(make_line(*words, length, random));
+            }
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "fold, %zu byte %s lines", length, kind);
+            std::string buffer;
+            measure(name, total_bytes(lines), lines.size(), [&]
+            {
+                std::size_t sum = 0;
+                for (auto&& line : lines)
+                {
+                    sum += Skeleton::fold(line, buffer).size();
+                }
+                return sum;
+            });
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef TIMING_HPP_
+#define TIMING_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+
+// keeps the results of measured work alive so the optimizer cannot drop it
+inline volatile std::size_t bench_sink = 0;
+
+// runs body again and again for at least min_time and prints MB/s over bytes_per_run and the rate of
+// items_per_run; body returns something derived from its work
+template <typename Body>
+void measure(std::string_view name, std::size_t bytes_per_run, std::size_t items_per_run, Body&& body, std::chrono::milliseconds min_time = std::chrono::milliseconds(500))
+{
+    using Clock = std::chrono::steady_clock;
+    std::size_t runs = 0;
+    std::size_t sink = 0;
+    auto started = Clock::now();
+    Clock::duration elapsed;
+    do
+    {
+        sink += body();
+        ++runs;
+        elapsed = Clock::now() - started;
+    } while (elapsed < min_time);
+    bench_sink = sink;
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double mb_per_second = static_cast<double>(bytes_per_run) * static_cast<double>(runs) / seconds / 1e6;
+    double items_per_second = static_cast<double>(items_per_run) * static_cast<double>(runs) / seconds;
+    std::printf("%-44.*s %10.1f MB/s %14.0f /s\n", static_cast<int>(name.size()), name.data(), mb_per_second, items_per_second);
+}
+
+#endif // TIMING_HPP_
\ No newline at end of file
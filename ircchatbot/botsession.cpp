@@ -0,0 +1,187 @@
+#include "botsession.hpp"
+
+#include "logger.hpp"
+
+BotSession::BotSession(boost::asio::io_context& io_context, std::size_t index, const IrcClient::Server& server, const std::string& irc_nick, const std::string& irc_pass,
+    const std::string& channels_db_name, int messages_per_window, LineHandler line_handler)
+    : index(index)
+    , irc_nick(irc_nick)
+    , channels(io_context, channels_db_name)
+    , messages_per_window(messages_per_window > 0 ? messages_per_window : 1)
+    , send_timer(io_context)
+    , line_handler(std::move(line_handler))
+{
+    irc_auth.auth_sequence_messages.insert(irc_auth.auth_sequence_messages.end(), { "PASS " + irc_pass, "NICK " + irc_nick, "CAP REQ :twitch.tv/tags", "CAP REQ :twitch.tv/commands" });
+    irc_client = std::make_unique<IrcClient>(io_context, irc_auth, server, [this](std::string&& line) { this->line_handler(*this, std::move(line)); });
+}
+
+std::size_t BotSession::get_index() const
+{
+    return index;
+}
+
+const std::string& BotSession::get_nick() const
+{
+    return irc_nick;
+}
+
+const Channels& BotSession::get_channels() const
+{
+    return channels;
+}
+
+void BotSession::join_saved_channels()
+{
+    if (cluster_managed)
+    {
+        return;
+    }
+    // join without saving to db
+    irc_client->join_channel(irc_nick);
+    for (auto&& channel : channels.get_channels())
+    {
+        irc_client->join_channel(channel);
+    }
+}
+
+void BotSession::join_channel(std::string_view channel_name)
+{
+    channels.add_channel(channel_name);
+    if (!cluster_managed)
+    {
+        irc_client->join_channel(channel_name);
+    }
+}
+
+void BotSession::part_channel(std::string_view channel_name)
+{
+    channels.remove_channel(channel_name);
+    if (!cluster_managed)
+    {
+        irc_client->part_channel(channel_name);
+    }
+}
+
+void BotSession::set_cluster_managed(bool managed)
+{
+    cluster_managed = managed;
+}
+
+void BotSession::attach_channel(std::string_view channel_name)
+{
+    irc_client->join_channel(channel_name);
+}
+
+void BotSession::detach_channel(std::string_view channel_name)
+{
+    irc_client->part_channel(channel_name);
+}
+
+void BotSession::send_command(std::string&& command)
+{
+    irc_client->send_command(std::move(command));
+}
+
+bool BotSession::try_take_send_slot()
+{
+    auto now = std::chrono::steady_clock::now();
+    while (!sent_times.empty() && now - sent_times.front() >= rate_limit_window)
+    {
+        sent_times.pop_front();
+    }
+    if (sent_times.size() >= static_cast<std::size_t>(messages_per_window))
+    {
+        return false;
+    }
+    sent_times.push_back(now);
+    return true;
+}
+
+void BotSession::send_message(std::string_view channel_name, const std::string& message)
+{
+    send_frame("PRIVMSG #" + std::string(channel_name) + " :" + message);
+}
+
+void BotSession::send_frame(std::string&& command)
+{
+    if (queued_messages.empty() && try_take_send_slot())
+    {
+        irc_client->send_command(std::move(command));
+        return;
+    }
+
+    if (queued_messages.size() >= max_queued_messages)
+    {
+        // the oldest regular message goes, priority ones are kept
+        if (queued_priority_messages == queued_messages.size())
+        {
+            log_warning(LogCategory::Irc, irc_nick + " over the message rate limit, dropping " + command);
+            return;
+        }
+        auto oldest = queued_messages.begin() + static_cast<std::ptrdiff_t>(queued_priority_messages);
+        log_warning(LogCategory::Irc, irc_nick + " over the message rate limit, dropping " + *oldest);
+        queued_messages.erase(oldest);
+    }
+    queued_messages.push_back(std::move(command));
+    schedule_queued_messages();
+}
+
+void BotSession::send_priority_message(std::string_view channel_name, const std::string& message)
+{
+    std::string command = "PRIVMSG #" + std::string(channel_name) + " :" + message;
+    if (try_take_send_slot())
+    {
+        irc_client->send_command(std::move(command));
+        return;
+    }
+
+    if (queued_messages.size() >= max_queued_messages)
+    {
+        log_warning(LogCategory::Irc, irc_nick + " over the message rate limit, dropping " + queued_messages.back());
+        if (queued_priority_messages == queued_messages.size())
+        {
+            --queued_priority_messages;
+        }
+        queued_messages.pop_back();
+    }
+    // behind the priority messages already waiting, ahead of the regular ones
+    queued_messages.insert(queued_messages.begin() + static_cast<std::ptrdiff_t>(queued_priority_messages), std::move(command));
+    ++queued_priority_messages;
+    schedule_queued_messages();
+}
+
+void BotSession::schedule_queued_messages()
+{
+    if (send_timer_armed || queued_messages.empty())
+    {
+        return;
+    }
+
+    // the oldest send leaves the window first
+    send_timer_armed = true;
+    send_timer.expires_at(sent_times.front() + rate_limit_window);
+    send_timer.async_wait([this](const boost::system::error_code& error)
+    {
+        send_timer_armed = false;
+        if (error)
+        {
+            return;
+        }
+        while (!queued_messages.empty() && try_take_send_slot())
+        {
+            irc_client->send_command(std::move(queued_messages.front()));
+            queued_messages.pop_front();
+            if (queued_priority_messages > 0)
+            {
+                --queued_priority_messages;
+            }
+        }
+        schedule_queued_messages();
+    });
+}
+
+void BotSession::quit()
+{
+    send_timer.cancel();
+    irc_client->quit();
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef BOTSESSION_HPP_
+#define BOTSESSION_HPP_
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ircauthsequence.hpp"
+#include "ircclient.hpp"
+#include "channels.hpp"
+
+// one twitch account: its connection, its channels and its message rate limit,
+// everything else is shared by all sessions of the process
+class BotSession
+{
+public:
+    using LineHandler = std::function<void(BotSession& session, std::string&& line)>;
+
+    // messages_per_window PRIVMSGs per rate_limit_window, twitch allows 20 for regular and 100 for moderator accounts
+    BotSession(boost::asio::io_context& io_context, std::size_t index, const IrcClient::Server& server, const std::string& irc_nick, const std::string& irc_pass,
+        const std::string& channels_db_name, int messages_per_window, LineHandler line_handler);
+    BotSession(const BotSession&) = delete;
+    BotSession& operator=(const BotSession&) = delete;
+
+    std::size_t get_index() const;
+    const std::string& get_nick() const;
+    const Channels& get_channels() const;
+
+    // joins the own channel and every channel saved for this account
+    void join_saved_channels();
+    // saved and joined, in cluster mode only saved and the cluster decides which node joins
+    void join_channel(std::string_view channel_name);
+    void part_channel(std::string_view channel_name);
+
+    // cluster mode, JOIN and PART without touching the saved channels
+    void set_cluster_managed(bool managed);
+    void attach_channel(std::string_view channel_name);
+    void detach_channel(std::string_view channel_name);
+
+    // PRIVMSGs over the rate limit wait in a bounded queue, the oldest are dropped when it is full
+    void send_message(std::string_view channel_name, const std::string& message);
+    // a whole PRIVMSG line built elsewhere, under the same limit and queue as send_message
+    void send_frame(std::string&& command);
+    // moderation actions, they take a free slot even ahead of queued messages and otherwise wait in front of them
+    void send_priority_message(std::string_view channel_name, const std::string& message);
+    void send_command(std::string&& command);
+
+    void quit();
+
+    static constexpr std::chrono::seconds rate_limit_window{ 30 };
+    static constexpr std::size_t max_queued_messages = 100;
+
+private:
+    std::size_t index;
+    std::string irc_nick;
+    IrcAuthSequence irc_auth;
+    Channels channels;
+    bool cluster_managed = false;
+
+    int messages_per_window;
+    // send times inside the current window, oldest first
+    std::deque<std::chrono::steady_clock::time_point> sent_times;
+    std::deque<std::string> queued_messages;
+    // at the front of queued_messages
+    std::size_t queued_priority_messages = 0;
+    boost::asio::steady_timer send_timer;
+    bool send_timer_armed = false;
+    bool try_take_send_slot();
+    void schedule_queued_messages();
+
+    LineHandler line_handler;
+    // declared last so a connection callback never sees a half constructed session
+    std::unique_ptr<IrcClient> irc_client;
+};
+
+#endif // BOTSESSION_HPP_
\ No newline at end of file
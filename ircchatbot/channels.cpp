@@ -1,11 +1,10 @@
 #include "channels.hpp"
 
-#include <iostream>
+#include "logger.hpp"
 
-constexpr std::string_view channels_db_name = "channels.db";
-
-Channels::Channels()
-    : channels_db(channels_db_name)
+Channels::Channels(boost::asio::io_context& io_context, const std::string& db_name)
+    : io_context(io_context)
+    , channels_db(db_name)
 {
     init_db();
 }
@@ -16,7 +15,7 @@ void Channels::init_db()
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Channels DB table channels error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Channels, msg);
         throw std::runtime_error(msg);
     }
 
@@ -25,7 +24,7 @@ void Channels::init_db()
         if (result.rc != SQLITE_OK)
         {
             std::string msg = "Channels DB table channels select all error: " + result.errmsg;
-            std::cerr << msg << std::endl;
+            log_error(LogCategory::Channels, msg);
             throw std::runtime_error(msg);
         }
 
@@ -41,23 +40,19 @@ const std::set<std::string, std::less<>>& Channels::get_channels() const
     return channels;
 }
 
-bool Channels::add_channel(std::string_view channel)
+void Channels::add_channel(std::string_view channel)
 {
-    auto result = channels_db.execute_prepared_statement("INSERT INTO channels (channel) VALUES (?);", { std::string(channel) });
+    channels_db.async_execute_prepared_statement(io_context.get_executor(), "INSERT INTO channels (channel) VALUES (?);", { std::string(channel) });
 
     channels.insert(std::string(channel));
-
-    return result.rc == SQLITE_OK;
 }
 
-bool Channels::remove_channel(std::string_view channel)
+void Channels::remove_channel(std::string_view channel)
 {
-    auto result = channels_db.execute_prepared_statement("DELETE FROM channels WHERE channel=?;", { std::string(channel) });
+    channels_db.async_execute_prepared_statement(io_context.get_executor(), "DELETE FROM channels WHERE channel=?;", { std::string(channel) });
 
     if (auto it = channels.find(channel); it != channels.end())
     {
         channels.erase(it);
     }
-
-    return result.rc == SQLITE_OK;
 }
\ No newline at end of file
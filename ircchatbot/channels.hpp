@@ -5,17 +5,23 @@
 #include <string>
 #include <string_view>
 
+#include <boost/asio/io_context.hpp>
+
 #include "database.hpp"
 
 class Channels
 {
 public:
-    Channels();
+    Channels(boost::asio::io_context& io_context, const std::string& db_name = std::string(default_db_name));
+
+    static constexpr std::string_view default_db_name = "channels.db";
 
     const std::set<std::string, std::less<>>& get_channels() const;
-    bool add_channel(std::string_view channel);
-    bool remove_channel(std::string_view channel);
+    // the set changes immediately, the db write happens on the db thread
+    void add_channel(std::string_view channel);
+    void remove_channel(std::string_view channel);
 private:
+    boost::asio::io_context& io_context;
     Database channels_db;
     void init_db();
 
@@ -1,23 +1,31 @@
 #include "chatbot.hpp"
 
-#include <iostream>
+#include <algorithm>
 
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include <unistd.h>
+
+#include "logger.hpp"
 
 constexpr std::string_view config_db_name = "config.db";
+constexpr std::chrono::seconds users_flush_interval{ 5 };
 
 Chatbot::Chatbot()
-    : config_db(config_db_name)
+    : users(io_context)
+    , users_flush_timer(io_context)
+    , config_db(config_db_name)
+    , commands_handler(io_context)
 {
     get_irc_nick_pass_from_config_db();
     init();
 }
 
 Chatbot::Chatbot(const std::string& irc_nick, const std::string& irc_pass)
-    : config_db(config_db_name)
+    : users(io_context)
+    , users_flush_timer(io_context)
+    , config_db(config_db_name)
     , irc_nick(irc_nick)
     , irc_pass(irc_pass)
+    , commands_handler(io_context)
 {
     init_config_db();
     init();
@@ -25,15 +33,87 @@ Chatbot::Chatbot(const std::string& irc_nick, const std::string& irc_pass)
 
 void Chatbot::init()
 {
-    init_auth(irc_nick, irc_pass);
-    init_irc_client();
-    // join without saving to db
-    irc_client->join_channel(irc_nick);
-    for (auto&& channel : channels.get_channels())
+    init_logger();
+    init_worker_pool();
+    init_echo_page();
+    init_banphrase_budget();
+    init_moderation();
+    init_duplicates();
+    init_recent_messages();
+    init_firehose();
+    init_pipeline();
+    init_sessions();
+    init_cluster();
+    for (auto&& session : sessions)
+    {
+        session->join_saved_channels();
+    }
+    publish_channels();
+}
+
+void Chatbot::publish_channels()
+{
+    std::set<ChannelName, std::less<>> channels;
+    for (auto&& session : sessions)
     {
-        // join from db
-        join_channel(channel);
+        channels.insert(session->get_nick());
+        channels.insert(session->get_channels().get_channels().begin(), session->get_channels().get_channels().end());
     }
+    commands_handler.set_channels(std::move(channels));
+}
+
+void Chatbot::init_sessions()
+{
+    // optional key rate_limit: messages per 30 seconds of the primary account
+    int primary_rate_limit = 20;
+    if (auto rate_limit = get_config_value("rate_limit"))
+    {
+        primary_rate_limit = std::stoi(*rate_limit);
+    }
+    // optional keys irc_host and irc_port, e.g. for a local test server
+    IrcClient::Server server;
+    if (auto host = get_config_value("irc_host"))
+    {
+        server.host = *host;
+    }
+    if (auto port = get_config_value("irc_port"))
+    {
+        server.port = *port;
+    }
+    add_session(server, irc_nick, irc_pass, std::string(Channels::default_db_name), primary_rate_limit);
+
+    auto result = config_db.execute_statement("CREATE TABLE IF NOT EXISTS accounts (nick TEXT NOT NULL PRIMARY KEY, pass TEXT NOT NULL, rate_limit INTEGER NOT NULL DEFAULT 20);");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Config DB table accounts error: " + result.errmsg;
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+
+    result = config_db.execute_statement("SELECT nick, pass, rate_limit FROM accounts ORDER BY nick ASC;");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Config DB table accounts select all error: " + result.errmsg;
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+
+    for (auto&& line : result.data)
+    {
+        if (!line[0] || !line[1] || *line[0] == irc_nick)
+        {
+            continue;
+        }
+        // every further account keeps its own channel list
+        add_session(server, *line[0], *line[1], "channels_" + *line[0] + ".db", line[2] ? std::stoi(*line[2]) : 20);
+    }
+}
+
+void Chatbot::add_session(const IrcClient::Server& server, const std::string& nick, const std::string& pass, const std::string& channels_db_name, int messages_per_window)
+{
+    sessions.push_back(std::make_unique<BotSession>(io_context, sessions.size(), server, nick, pass, channels_db_name, messages_per_window,
+        [this](BotSession& session, std::string&& line) { this->handle_line(session, std::move(line)); }));
+    log_info(LogCategory::General, "Account " + nick + " with " + std::to_string(sessions.back()->get_channels().get_channels().size()) + " channels");
 }
 
 void Chatbot::get_irc_nick_pass_from_config_db()
@@ -42,13 +122,13 @@ void Chatbot::get_irc_nick_pass_from_config_db()
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Config DB error, unable to get irc_nick and irc_pass: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::General, msg);
         throw std::runtime_error(msg);
     }
     if (result.data.size() != 2)
     {
         std::string msg = "Config DB error, no irc_nick and irc_pass found";
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::General, msg);
         throw std::runtime_error(msg);
     }
     // ASC order: irc_nick, irc_pass
@@ -60,18 +140,391 @@ void Chatbot::get_irc_nick_pass_from_config_db()
     else
     {
         std::string msg = "Config DB error, null data in irc_nick or irc_pass found";
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::General, msg);
         throw std::runtime_error(msg);
     }
 }
 
+std::optional<std::string> Chatbot::get_config_value(std::string_view key)
+{
+    auto result = config_db.execute_prepared_statement("SELECT value FROM config WHERE key=?;", { std::string(key) });
+    if (result.rc != SQLITE_OK || result.data.size() != 1 || !result.data[0][0])
+    {
+        return std::nullopt;
+    }
+    return result.data[0][0];
+}
+
+void Chatbot::init_worker_pool()
+{
+    std::size_t thread_count = std::max(2u, std::thread::hardware_concurrency());
+    if (auto threads = get_config_value("worker_threads"))
+    {
+        thread_count = std::stoul(*threads);
+    }
+    worker_pool = std::make_unique<WorkStealingPool>(thread_count);
+}
+
+void Chatbot::init_echo_page()
+{
+    long max_connections = 16;
+    if (auto connections = get_config_value("fetch_connections"))
+    {
+        max_connections = std::stol(*connections);
+    }
+    echo_page = std::make_unique<Hemirt::Utility::EchoPage>(io_context, max_connections);
+
+    std::size_t max_bytes = 4 * 1024 * 1024;
+    if (auto bytes = get_config_value("fetch_cache_bytes"))
+    {
+        max_bytes = std::stoul(*bytes);
+    }
+    std::chrono::seconds stale_for{ 60 };
+    if (auto stale = get_config_value("fetch_cache_stale"))
+    {
+        stale_for = std::chrono::seconds(std::stoi(*stale));
+    }
+    // fetch_lines: first keeps a page up to its first line break, join keeps every line with the breaks as spaces
+    auto lines = Hemirt::Utility::EchoPage::Slice::Lines::First;
+    if (auto keep = get_config_value("fetch_lines"); keep && *keep == "join")
+    {
+        lines = Hemirt::Utility::EchoPage::Slice::Lines::Join;
+    }
+    page_cache = std::make_unique<PageCache>(*echo_page, max_bytes, stale_for, lines);
+}
+
+void Chatbot::init_banphrase_budget()
+{
+    // optional keys: banphrase_step_budget (matcher steps per boost::regex run), banphrase_time_budget_us; 0 disables either
+    std::uint64_t max_steps = 1000000;
+    std::chrono::microseconds max_time{ 50000 };
+    if (auto steps = get_config_value("banphrase_step_budget"))
+    {
+        max_steps = std::stoull(*steps);
+    }
+    if (auto time = get_config_value("banphrase_time_budget_us"))
+    {
+        max_time = std::chrono::microseconds(std::stoll(*time));
+    }
+    BanphraseAutomaton::set_budget(max_steps, max_time);
+}
+
+void Chatbot::init_moderation()
+{
+    // optional keys: moderation (0 disables it), moderation_batch (messages per batch), moderation_delay_ms (longest wait for a batch to fill)
+    if (auto enabled = get_config_value("moderation"); enabled && *enabled == "0")
+    {
+        return;
+    }
+
+    std::size_t max_batch = 64;
+    std::chrono::milliseconds max_delay{ 2 };
+    if (auto batch = get_config_value("moderation_batch"))
+    {
+        max_batch = std::stoul(*batch);
+    }
+    if (auto delay = get_config_value("moderation_delay_ms"))
+    {
+        max_delay = std::chrono::milliseconds(std::stoi(*delay));
+    }
+
+    moderation = std::make_unique<ModerationStage>(io_context, *worker_pool, [this]
+    {
+        return commands_handler.load_published_tables();
+    }, [this](const ModerationStage::Verdict& verdict)
+    {
+        ban_user(*sessions[verdict.session], verdict.channel, verdict.user, verdict.timeout);
+    }, max_batch, max_delay);
+}
+
+void Chatbot::init_recent_messages()
+{
+    // optional keys: recent_messages (0 disables it), retro_action (delete or timeout), retro_interval_ms (pause between actions)
+    if (auto enabled = get_config_value("recent_messages"); enabled && *enabled == "0")
+    {
+        return;
+    }
+
+    bool timeout_authors = false;
+    std::chrono::milliseconds interval{ 200 };
+    if (auto action = get_config_value("retro_action"))
+    {
+        timeout_authors = *action == "timeout";
+    }
+    if (auto delay = get_config_value("retro_interval_ms"))
+    {
+        interval = std::chrono::milliseconds(std::stoi(*delay));
+    }
+
+    recent_messages = std::make_unique<RecentMessages>(io_context, *worker_pool, [this, timeout_authors](const RecentMessages::Match& match)
+    {
+        auto&& entry = match.entry;
+        log_info(LogCategory::Commands, "Retroactive " + std::string(timeout_authors ? "timeout" : "delete") + " of " + entry.user + " in #" + entry.channel);
+        if (timeout_authors)
+        {
+            ban_user(*sessions[entry.session], entry.channel, entry.user, match.timeout);
+        }
+        else
+        {
+            sessions[entry.session]->send_priority_message(entry.channel, "/delete " + entry.message_id);
+        }
+    }, interval);
+}
+
+void Chatbot::moderate(BotSession& session, const IrcMessage& ircmessage)
+{
+    if (recent_messages)
+    {
+        recent_messages->add(session.get_index(), ircmessage);
+    }
+    if (moderation)
+    {
+        auto emotes = ircmessage.tags.find("emotes");
+        moderation->submit(session.get_index(), ircmessage.channel, ircmessage.user, ircmessage.message, emotes != ircmessage.tags.end() ? emotes->second.raw_value : std::string_view());
+    }
+}
+
+void Chatbot::init_duplicates()
+{
+    // optional keys: duplicate_timeout (enables it), duplicate_window_s, duplicate_distance (differing bits of 64),
+    // duplicate_user_repeats, duplicate_channel_repeats (0 turns either off), duplicate_min_length
+    auto timeout = get_config_value("duplicate_timeout");
+    if (!timeout || std::stoi(*timeout) == 0)
+    {
+        return;
+    }
+    duplicate_timeout = std::stoi(*timeout);
+
+    DuplicateDetector::Settings settings;
+    if (auto window = get_config_value("duplicate_window_s"))
+    {
+        settings.window = std::chrono::seconds(std::stoi(*window));
+    }
+    if (auto distance = get_config_value("duplicate_distance"))
+    {
+        settings.max_distance = std::stoi(*distance);
+    }
+    if (auto repeats = get_config_value("duplicate_user_repeats"))
+    {
+        settings.user_repeats = std::stoul(*repeats);
+    }
+    if (auto repeats = get_config_value("duplicate_channel_repeats"))
+    {
+        settings.channel_repeats = std::stoul(*repeats);
+    }
+    if (auto length = get_config_value("duplicate_min_length"))
+    {
+        settings.min_length = std::stoul(*length);
+    }
+    duplicate_settings = settings;
+    duplicates = std::make_unique<DuplicateDetector>(settings);
+}
+
+bool Chatbot::is_duplicate_spam(DuplicateDetector& detector, const IrcMessage& ircmessage)
+{
+    if (!detector.check(ircmessage.channel, ircmessage.user_id, ircmessage.message))
+    {
+        return false;
+    }
+    log_info(LogCategory::Commands, "Moderated " + std::string(ircmessage.user) + " in #" + std::string(ircmessage.channel) + " for duplicates, timeout " + std::to_string(duplicate_timeout));
+    return true;
+}
+
+void Chatbot::init_firehose()
+{
+    // optional keys: firehose_name (e.g. /ircbot-firehose), firehose_records, firehose_bytes
+    auto name = get_config_value("firehose_name");
+    if (!name || name->empty())
+    {
+        return;
+    }
+
+    std::size_t record_count = 65536;
+    std::size_t data_capacity = 16 * 1024 * 1024;
+    if (auto records = get_config_value("firehose_records"))
+    {
+        record_count = std::stoul(*records);
+    }
+    if (auto bytes = get_config_value("firehose_bytes"))
+    {
+        data_capacity = std::stoul(*bytes);
+    }
+    firehose = std::make_unique<ChatFirehose>(*name, record_count, data_capacity);
+}
+
+BotSession* Chatbot::find_session(std::string_view nick)
+{
+    for (auto&& session : sessions)
+    {
+        if (session->get_nick() == nick)
+        {
+            return session.get();
+        }
+    }
+    return nullptr;
+}
+
+void Chatbot::init_cluster()
+{
+    // optional keys: cluster_db (path of the file shared by all nodes), cluster_node (unique name, default host:pid)
+    auto db_file = get_config_value("cluster_db");
+    if (!db_file || db_file->empty())
+    {
+        return;
+    }
+
+    std::string node_id;
+    if (auto node = get_config_value("cluster_node"))
+    {
+        node_id = *node;
+    }
+    else
+    {
+        char hostname[256] = {};
+        gethostname(hostname, sizeof(hostname) - 1);
+        node_id = std::string(hostname) + ":" + std::to_string(getpid());
+    }
+
+    for (auto&& session : sessions)
+    {
+        session->set_cluster_managed(true);
+    }
+
+    cluster = std::make_unique<ClusterMembership>(io_context, *db_file, node_id, [this]
+    {
+        // the own channel of every account is divided like any other channel
+        std::vector<ClusterMembership::ChannelKey> keys;
+        for (auto&& session : sessions)
+        {
+            keys.push_back({ session->get_nick(), session->get_nick() });
+            for (auto&& channel : session->get_channels().get_channels())
+            {
+                keys.push_back({ session->get_nick(), channel });
+            }
+        }
+        return keys;
+    }, [this](const ClusterMembership::ChannelKey& key)
+    {
+        if (auto session = find_session(key.account))
+        {
+            log_info(LogCategory::Channels, key.account + " took over #" + key.channel);
+            session->attach_channel(key.channel);
+        }
+    }, [this](const ClusterMembership::ChannelKey& key)
+    {
+        if (auto session = find_session(key.account))
+        {
+            log_info(LogCategory::Channels, key.account + " handed over #" + key.channel);
+            session->detach_channel(key.channel);
+        }
+    });
+    cluster->start();
+}
+
+void Chatbot::init_pipeline()
+{
+    auto shards = get_config_value("pipeline_shards");
+    if (!shards)
+    {
+        return;
+    }
+
+    int shard_count = std::stoi(*shards);
+    if (shard_count <= 0)
+    {
+        return;
+    }
+
+    shard_states = std::vector<ShardState>(shard_count);
+    if (duplicate_settings)
+    {
+        for (auto&& shard : shard_states)
+        {
+            shard.duplicates = std::make_unique<DuplicateDetector>(*duplicate_settings);
+        }
+    }
+    // sessions are all added by init_sessions, before the first line reaches a shard
+    pipeline = std::make_unique<MessagePipeline>(io_context, shard_count, [this](std::size_t shard, std::size_t session, std::string&& line)
+    {
+        handle_privmsg_in_shard(shard_states[shard], *sessions[session], IrcMessage(std::move(line)));
+    });
+    log_info(LogCategory::General, "Pipeline mode with " + std::to_string(shard_count) + " shards");
+}
+
+void Chatbot::init_logger()
+{
+    // optional keys: log_file, log_max_size, log_max_files, log_level (0 debug .. 3 error), log_sample_<category>
+    auto result = config_db.execute_statement("SELECT key, value FROM config WHERE key LIKE 'log\\_%' ESCAPE '\\';");
+    if (result.rc != SQLITE_OK)
+    {
+        log_warning(LogCategory::General, "Config DB error, unable to read logger settings: " + result.errmsg);
+        return;
+    }
+
+    constexpr std::array<std::pair<std::string_view, LogCategory>, 7> sample_keys{ {
+        { "log_sample_general", LogCategory::General },
+        { "log_sample_irc", LogCategory::Irc },
+        { "log_sample_database", LogCategory::Database },
+        { "log_sample_users", LogCategory::Users },
+        { "log_sample_commands", LogCategory::Commands },
+        { "log_sample_channels", LogCategory::Channels },
+        { "log_sample_http", LogCategory::Http },
+    } };
+
+    auto& logger = Logger::get_instance();
+    std::string log_file;
+    std::size_t max_size = 64 * 1024 * 1024;
+    int max_files = 5;
+    for (auto&& line : result.data)
+    {
+        if (!line[0] || !line[1])
+        {
+            continue;
+        }
+        auto&& key = *line[0];
+        auto&& value = *line[1];
+
+        if (key == "log_file")
+        {
+            log_file = value;
+        }
+        else if (key == "log_max_size")
+        {
+            max_size = std::stoull(value);
+        }
+        else if (key == "log_max_files")
+        {
+            max_files = std::stoi(value);
+        }
+        else if (key == "log_level")
+        {
+            logger.set_level(static_cast<LogLevel>(std::clamp(std::stoi(value), 0, 3)));
+        }
+        else
+        {
+            for (auto&& [sample_key, category] : sample_keys)
+            {
+                if (key == sample_key)
+                {
+                    logger.set_sampling(category, std::stoul(value));
+                }
+            }
+        }
+    }
+
+    if (!log_file.empty())
+    {
+        logger.set_file(log_file, max_size, max_files);
+    }
+}
+
 void Chatbot::init_config_db()
 {
     auto result = config_db.execute_statement("CREATE TABLE IF NOT EXISTS config (key TEXT NOT NULL PRIMARY KEY, value TEXT NOT NULL);");
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Config DB error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::General, msg);
         throw std::runtime_error(msg);
     }
 
@@ -79,252 +532,588 @@ void Chatbot::init_config_db()
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Config DB error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::General, msg);
         throw std::runtime_error(msg);
     }
 }
 
-void Chatbot::init_auth(const std::string& irc_nick, const std::string& irc_pass)
+void Chatbot::handle_line(BotSession& session, std::string&& line)
 {
-    irc_auth.auth_sequence_messages.insert(irc_auth.auth_sequence_messages.end(), { "PASS " + irc_pass, "NICK " + irc_nick, "CAP REQ :twitch.tv/tags", "CAP REQ :twitch.tv/commands" });
-}
+    // published here rather than in handle_ircmessage so pipeline mode PRIVMSGs are included
+    if (firehose)
+    {
+        firehose->publish(line, session.get_index());
+    }
 
-void Chatbot::init_irc_client()
-{
-    irc_client = std::make_unique<IrcClient>(io_context, irc_auth, [this](IrcMessage&& ircmessage) { this->handle_ircmessage(std::move(ircmessage)); });
+    auto channel = IrcMessage::peek_privmsg_channel(line);
+    // a channel being handed over may still deliver a few lines, only the lease holder replies
+    if (cluster && !channel.empty() && !cluster->holds(session.get_nick(), channel))
+    {
+        return;
+    }
+
+    // only PRIVMSGs go to the shards, everything else is cheap and stays on the io thread
+    if (pipeline && !channel.empty())
+    {
+        pipeline->dispatch(channel, session.get_index(), std::move(line));
+        return;
+    }
+
+    handle_ircmessage(session, IrcMessage(std::move(line)));
 }
 
-void Chatbot::handle_ircmessage(IrcMessage&& ircmessage)
+void Chatbot::handle_ircmessage(BotSession& session, IrcMessage&& ircmessage)
 {
     switch (ircmessage.type)
     {
     case IrcMessage::Type::PRIVMSG:
     {
-        handle_privmsg(ircmessage);
+        handle_privmsg(session, ircmessage);
         break;
     }
     case IrcMessage::Type::PING:
     {
-        handle_ping(ircmessage);
+        handle_ping(session, ircmessage);
+        break;
+    }
+    case IrcMessage::Type::CLEARMSG:
+    {
+        if (recent_messages)
+        {
+            recent_messages->remove_message(ircmessage.channel, ircmessage.message_id);
+        }
+        break;
+    }
+    case IrcMessage::Type::CLEARCHAT:
+    {
+        if (recent_messages)
+        {
+            if (ircmessage.user_id.empty())
+            {
+                recent_messages->clear_channel(ircmessage.channel);
+            }
+            else
+            {
+                recent_messages->remove_user(ircmessage.channel, ircmessage.user_id);
+            }
+        }
         break;
     }
     default:
-        std::cout << ircmessage.original_line << std::endl;
+        log_info(LogCategory::Irc, ircmessage.original_line);
         break;
     }
 }
 
-void Chatbot::handle_ping(const IrcMessage& ircmessage)
+void Chatbot::handle_ping(BotSession& session, const IrcMessage& ircmessage)
 {
     std::string pong = "PONG ";
     pong += ircmessage.params[0];
-    irc_client->send_command(std::move(pong));
+    session.send_command(std::move(pong));
 }
 
-void Chatbot::handle_privmsg(const IrcMessage& ircmessage)
+void Chatbot::add_known_user(std::string_view user_id, std::string_view user, std::string_view display_name)
 {
-    /* add as known user */
-    if (ircmessage.display_name.empty())
+    if (display_name.empty())
     {
-        users.add_user(ircmessage.user_id, ircmessage.user);
+        users.add_user(user_id, user);
     }
     else
     {
-        users.add_user(ircmessage.user_id, ircmessage.user, ircmessage.display_name);
+        users.add_user(user_id, user, display_name);
     }
+}
+
+void Chatbot::handle_privmsg(BotSession& session, const IrcMessage& ircmessage)
+{
+    /* add as known user */
+    add_known_user(ircmessage.user_id, ircmessage.user, ircmessage.display_name);
 
     auto user_is_admin = users.get_admin_permissions(ircmessage.user_id);
 
     if (user_is_admin) /* check admin commands */
     {
-        if (check_admin_commands(*user_is_admin, ircmessage)) return;;
+        if (check_admin_commands(session, *user_is_admin, ircmessage)) return;;
     }
-    else /* check banphrases */
+    else /* check copy paste spam inline and banphrases off the io thread */
     {
-        /*
-        auto timeout = commands_handler.is_banphrased(ircmessage.message);
-        if (timeout)
+        if (duplicates && is_duplicate_spam(*duplicates, ircmessage))
         {
-            ban_user(ircmessage.channel, ircmessage.user, timeout);
+            ban_user(session, ircmessage.channel, ircmessage.user, duplicate_timeout);
             return;
         }
-        */
+        moderate(session, ircmessage);
+    }
+
+    /* check textcommands */
+    if (auto response = commands_handler.handle_privmsg(ircmessage))
+    {
+        if (response->has_fetches)
+        {
+            send_fetched_response(session, std::string(ircmessage.channel), commands_handler.get_tables(), std::move(response->pieces), response->fetch_ttl);
+        }
+        else if (!commands_handler.is_banphrased(response->text, ircmessage.channel))
+        {
+            send_response(session, ircmessage.channel, std::move(*response));
+        }
+    }
+}
+
+void Chatbot::send_response(BotSession& session, std::string_view channel, CommandResponse&& response)
+{
+    // static responses come with their PRIVMSG line already built
+    if (!response.frame.empty())
+    {
+        session.send_frame(std::move(response.frame));
+    }
+    else
+    {
+        session.send_message(channel, response.text);
+    }
+}
+
+void Chatbot::send_fetched_response(BotSession& session, std::string channel, std::shared_ptr<const CommandTables> tables, ResponsePieces pieces, int fetch_ttl)
+{
+    // every fetch fills its page slot, whichever finishes last sends the response
+    struct Fetches
+    {
+        ResponsePieces pieces;
+        std::vector<std::string> pages;
+        std::size_t remaining = 0;
+    };
+    auto fetches = std::make_shared<Fetches>();
+    fetches->pieces = std::move(pieces);
+    fetches->pages.resize(fetches->pieces.fetches.size());
+
+    // a page never gets more than the room the text leaves in the PRIVMSG line, the transfer stops there
+    std::size_t used = std::string_view("PRIVMSG # :").size() + channel.size();
+    for (auto&& text : fetches->pieces.texts)
+    {
+        used += text.size();
+    }
+    std::size_t room = used < IrcClient::max_irc_command_length ? IrcClient::max_irc_command_length - used : 0;
+
+    auto finish = [this, session = &session, channel = std::move(channel), tables = std::move(tables), fetches]
+    {
+        auto&& texts = fetches->pieces.texts;
+        std::string expanded = texts.front();
+        for (std::size_t i = 0; i < fetches->pages.size(); ++i)
+        {
+            expanded += fetches->pages[i];
+            expanded += texts[i + 1];
+        }
+        worker_pool->post([tables, channel, expanded = std::move(expanded)]() -> std::optional<std::string>
+        {
+            if (tables->is_banphrased(expanded, channel))
+            {
+                return std::nullopt;
+            }
+            return expanded;
+        }, io_context.get_executor(), [session, channel](std::optional<std::string> response)
+        {
+            if (response)
+            {
+                session->send_message(channel, *response);
+            }
+        });
+    };
+
+    auto&& placeholders = fetches->pieces.fetches;
+    if (room > 0)
+    {
+        fetches->remaining = static_cast<std::size_t>(std::ranges::count_if(placeholders, [](auto&& fetch) { return !fetch.url.empty(); }));
+    }
+    if (fetches->remaining == 0)
+    {
+        finish();
+        return;
+    }
+    for (std::size_t i = 0; i < placeholders.size(); ++i)
+    {
+        if (placeholders[i].url.empty())
+        {
+            continue;
+        }
+        page_cache->get(placeholders[i].url, placeholders[i].json_path, std::chrono::seconds(fetch_ttl), room, [fetches, i, finish](std::string page)
+        {
+            fetches->pages[i] = std::move(page);
+            if (--fetches->remaining == 0)
+            {
+                finish();
+            }
+        });
+    }
+}
+
+void Chatbot::handle_privmsg_in_shard(ShardState& shard, BotSession& session, const IrcMessage& ircmessage)
+{
+    /* add as known user, repeats are absorbed by the shard */
+    if (auto known = shard.known_users.find(ircmessage.user_id); known == shard.known_users.end() || known->second != ircmessage.display_name)
+    {
+        if (shard.known_users.size() >= Users::max_known_users)
+        {
+            shard.known_users.clear();
+        }
+        shard.known_users.insert_or_assign(std::string(ircmessage.user_id), std::string(ircmessage.display_name));
+        pipeline->post_to_writer([this, user_id = std::string(ircmessage.user_id), user = std::string(ircmessage.user), display_name = std::string(ircmessage.display_name)]
+        {
+            add_known_user(user_id, user, display_name);
+        });
+    }
+
+    if (auto generation = users.admins_generation(); generation != shard.admins_generation)
+    {
+        shard.admins = users.load_published_admins();
+        shard.admins_generation = generation;
+    }
+    if (shard.admins->contains(ircmessage.user_id))
+    {
+        // admin commands change shared state, run the whole message on the io thread
+        pipeline->post_to_writer([this, session = &session, line = ircmessage.original_line]
+        {
+            handle_privmsg(*session, IrcMessage(line));
+        });
+        return;
+    }
+
+    if (shard.duplicates && is_duplicate_spam(*shard.duplicates, ircmessage))
+    {
+        pipeline->post_to_writer([this, session = &session, channel = std::string(ircmessage.channel), user = std::string(ircmessage.user)]
+        {
+            ban_user(*session, channel, user, duplicate_timeout);
+        });
+        return;
+    }
+    moderate(session, ircmessage);
+
+    if (auto generation = commands_handler.tables_generation(); generation != shard.tables_generation)
+    {
+        shard.tables = commands_handler.load_published_tables();
+        shard.tables_generation = generation;
     }
 
     /* check textcommands */
-    if (auto response = commands_handler.handle_privmsg(ircmessage); response && !commands_handler.is_banphrased(*response))
+    auto response = shard.tables->handle_privmsg(ircmessage);
+    if (!response)
+    {
+        return;
+    }
+    if (response->has_fetches)
     {
-        irc_client->send_message(ircmessage.channel, *response);
+        // fetches are driven by the io thread
+        pipeline->post_to_writer([this, session = &session, channel = std::string(ircmessage.channel), tables = shard.tables, pieces = std::move(response->pieces),
+            fetch_ttl = response->fetch_ttl]() mutable
+        {
+            send_fetched_response(*session, std::move(channel), std::move(tables), std::move(pieces), fetch_ttl);
+        });
+    }
+    else if (!shard.tables->is_banphrased(response->text, ircmessage.channel))
+    {
+        pipeline->post_to_writer([this, session = &session, channel = std::string(ircmessage.channel), response = std::move(*response)]() mutable
+        {
+            send_response(*session, channel, std::move(response));
+        });
     }
 }
 
-void Chatbot::ban_user(std::string_view channel, std::string_view username, int timeout)
+void Chatbot::ban_user(BotSession& session, std::string_view channel, std::string_view username, int timeout)
 {
     if (timeout == -1)
     {
-        irc_client->send_message(std::string(channel), "/ban " + std::string(username));
+        session.send_priority_message(std::string(channel), "/ban " + std::string(username));
     }
     else
     {
-        irc_client->send_message(std::string(channel), "/timeout " + std::string(username) + " " + std::to_string(timeout));
+        session.send_priority_message(std::string(channel), "/timeout " + std::string(username) + " " + std::to_string(timeout));
     }
 }
 
 void Chatbot::run()
 {
     dummy_work = std::make_unique<boost::asio::io_service::work>(io_context);
+    schedule_users_flush();
     io_context.run();
 }
 
 void Chatbot::stop_gracefully()
 {
-    irc_client->quit();
+    if (cluster)
+    {
+        cluster->stop();
+    }
+    for (auto&& session : sessions)
+    {
+        session->quit();
+    }
+    users_flush_timer.cancel();
     dummy_work.reset();
 }
 
-void Chatbot::join_channel(std::string_view channel_name)
+void Chatbot::schedule_users_flush()
 {
-    channels.add_channel(channel_name);
-    irc_client->join_channel(channel_name);
+    users_flush_timer.expires_after(users_flush_interval);
+    users_flush_timer.async_wait([this](const boost::system::error_code& error)
+    {
+        if (error)
+        {
+            return;
+        }
+        users.flush_pending_users();
+        schedule_users_flush();
+    });
 }
 
-void Chatbot::part_channel(std::string_view channel_name)
+constexpr std::array<Chatbot::AdminCommand, Chatbot::admin_command_count> Chatbot::admin_commands{ {
+    { "!quit", 100, 1, &Chatbot::admin_quit },
+    { "!addcmd", 100, 3, &Chatbot::admin_addcmd },
+    { "!delcmd", 100, 2, &Chatbot::admin_delcmd },
+    { "!addbanphrase", 100, 3, &Chatbot::admin_addbanphrase },
+    { "!delbanphrase", 100, 2, &Chatbot::admin_delbanphrase },
+    { "!banphraseaddchn", 100, 3, &Chatbot::admin_banphraseaddchn },
+    { "!banphrasetogglechns", 100, 2, &Chatbot::admin_banphrasetogglechns },
+    { "!banphrasestats", 100, 1, &Chatbot::admin_banphrasestats },
+    { "!shaperule", 100, 8, &Chatbot::admin_shaperule },
+    { "!delshaperule", 100, 2, &Chatbot::admin_delshaperule },
+    { "!linkrule", 100, 3, &Chatbot::admin_linkrule },
+    { "!linkallow", 100, 3, &Chatbot::admin_linkallow },
+    { "!linkdisallow", 100, 3, &Chatbot::admin_linkdisallow },
+    { "!addadmin", 100, 3, &Chatbot::admin_addadmin },
+    { "!deladmin", 100, 2, &Chatbot::admin_deladmin },
+    { "!joinchn", 100, 2, &Chatbot::admin_joinchn },
+    { "!partchn", 100, 2, &Chatbot::admin_partchn },
+    { "!cmdaddchn", 100, 3, &Chatbot::admin_cmdaddchn },
+    { "!cmdadduid", 100, 3, &Chatbot::admin_cmdadduid },
+    { "!cmdtogglechns", 100, 2, &Chatbot::admin_cmdtogglechns },
+    { "!cmdtoggleuids", 100, 2, &Chatbot::admin_cmdtoggleuids },
+    { "!cmdshow", 100, 2, &Chatbot::admin_cmdshow },
+    { "!cmdttl", 100, 3, &Chatbot::admin_cmdttl },
+    { "!poolstats", 100, 1, &Chatbot::admin_poolstats },
+    { "!modstats", 100, 1, &Chatbot::admin_modstats },
+    { "!fetchstats", 100, 1, &Chatbot::admin_fetchstats },
+} };
+
+constexpr PerfectHash::Table<PerfectHash::slot_count(Chatbot::admin_command_count)> Chatbot::admin_commands_index = PerfectHash::build(Chatbot::admin_commands, &Chatbot::AdminCommand::trigger);
+
+void Chatbot::AdminReply::operator()(std::string_view text) const
 {
-    channels.remove_channel(channel_name);
-    irc_client->part_channel(channel_name);
+    session->send_message(channel, user + ", " + std::string(text));
 }
 
-std::string connect_tokens(const std::vector<std::string_view>& tokens, std::size_t start, std::size_t end)
+DoneHandler Chatbot::AdminReply::done(std::string success, std::string failure) const
 {
-    std::string result;
-    for (std::size_t i = start; i < end; ++i)
-    {
-        result += tokens[i];
-        result += ' ';
-    }
-    if (!result.empty())
+    return [reply = *this, success = std::move(success), failure = std::move(failure)](bool ok)
     {
-        // remove extra space
-        result.pop_back();
-    }
-    return result;
+        reply(ok ? success : failure);
+    };
 }
 
-bool Chatbot::check_admin_commands(int permissions, const IrcMessage& ircmessage)
+bool Chatbot::check_admin_commands(BotSession& session, int permissions, const IrcMessage& ircmessage)
 {
-    if (permissions < 100)
+    static_assert(std::ranges::none_of(admin_commands, [](auto&& command) { return command.handler == nullptr; }), "admin_command_count is larger than the table");
+    auto trigger = ircmessage.message.substr(0, ircmessage.message.find(' '));
+    auto command = admin_commands_index.find(admin_commands, &AdminCommand::trigger, trigger);
+    if (!command || permissions < command->min_permissions)
     {
         return false;
     }
 
-    std::vector<std::string_view> tokens;
-    boost::algorithm::split(tokens, ircmessage.message, boost::algorithm::is_any_of(" "));
-    if (tokens.size() == 0)
+    CommandArguments args(ircmessage.message);
+    if (args.size() < command->min_tokens)
     {
         return false;
     }
 
-    auto&& trigger = tokens[0];
-    if (trigger == "!quit")
+    // the views into ircmessage do not outlive this call, completions keep their own copies
+    AdminReply reply{ &session, std::string(ircmessage.channel), std::string(ircmessage.user) };
+    (this->*command->handler)(AdminCommandContext{ session, ircmessage, permissions, args, reply });
+    return true;
+}
+
+void Chatbot::admin_quit(const AdminCommandContext&)
+{
+    stop_gracefully();
+}
+
+void Chatbot::admin_addcmd(const AdminCommandContext& context)
+{
+    auto&& args = context.args;
+    commands_handler.add_textcommand(args[1], args.rest(2), context.reply.done("added a new command", "failed to add a new command"));
+}
+
+void Chatbot::admin_delcmd(const AdminCommandContext& context)
+{
+    commands_handler.remove_textcommand(context.args[1], context.reply.done("removed a command", "failed to remove a command"));
+}
+
+void Chatbot::admin_addbanphrase(const AdminCommandContext& context)
+{
+    auto&& args = context.args;
+    std::string timeout_str(args.back());
+    int timeout = std::atoi(timeout_str.c_str());
+    if (timeout == 0)
     {
-        stop_gracefully();
-        return true;
+        context.reply("zero or no timeout duration provided");
+        return;
     }
-    else if (trigger == "!addcmd" && tokens.size() >= 3)
-    {
-        auto&& command_trigger = tokens[1];
-        std::string response = connect_tokens(tokens, 2, tokens.size());
 
-        if (commands_handler.add_textcommand(command_trigger, response))
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", added a new command");
-        }
-        else
+    // messages already in chat are checked once the banphrase is stored
+    commands_handler.add_banphrase(args.join(1, args.size() - 1), timeout, [this, reply = context.reply](bool ok)
+    {
+        reply(ok ? "added a new banphrase" : "failed to add a new banphrase");
+        if (ok && recent_messages)
         {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", failed to add a new command");
+            recent_messages->rescan(commands_handler.get_tables());
         }
-        return true;
+    });
+}
+
+void Chatbot::admin_delbanphrase(const AdminCommandContext& context)
+{
+    commands_handler.remove_banphrase(context.args.rest(1), context.reply.done("removed a banphrase", "failed to remove a banphrase"));
+}
+
+void Chatbot::admin_banphraseaddchn(const AdminCommandContext& context)
+{
+    // channel first, the phrase may contain spaces
+    commands_handler.add_channel_to_banphrase(context.args.rest(2), context.args[1], context.reply.done("true", "false"));
+}
+
+void Chatbot::admin_banphrasetogglechns(const AdminCommandContext& context)
+{
+    commands_handler.toggle_channels_to_banphrase(context.args.rest(1), [reply = context.reply](int ret) { reply(std::to_string(ret)); });
+}
+
+void Chatbot::admin_banphrasestats(const AdminCommandContext& context)
+{
+    auto&& automaton = commands_handler.get_tables()->banphrase_automaton;
+    if (!automaton || automaton->get_patterns().empty())
+    {
+        context.reply("no banphrases");
+        return;
     }
-    else if (trigger == "!delcmd" && tokens.size() >= 2)
+    auto&& patterns = automaton->get_patterns();
+
+    auto describe = [](const BanphraseAutomaton::Pattern& pattern)
     {
-        auto&& command_trigger = tokens[1];
+        auto&& stats = *pattern.stats;
+        return pattern.regex.str()
+            + (stats.disabled ? " (disabled)" : "")
+            + ": runs " + std::to_string(stats.evaluations.load())
+            + ", hits " + std::to_string(stats.hits.load())
+            + ", total " + std::to_string(stats.total_ns.load() / 1000) + "us"
+            + ", worst " + std::to_string(stats.max_ns.load() / 1000) + "us"
+            + ", aborts " + std::to_string(stats.aborts.load());
+    };
 
-        if (commands_handler.remove_textcommand(command_trigger))
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", removed a command");
-        }
-        else
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", failed to remove a command");
-        }
-        return true;
-    }
-    else if (trigger == "!addbanphrase" && tokens.size() >= 3)
+    // !banphrasestats <phrase> for one banphrase, otherwise the most expensive ones
+    if (context.args.size() > 1)
     {
-        std::string timeout_str(tokens.back());
-        int timeout = std::atoi(timeout_str.c_str());
-        if (timeout == 0)
+        auto phrase = context.args.rest(1);
+        for (auto&& pattern : patterns)
         {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", zero or no timeout duration provided");
-            return true;
+            if (pattern.regex.str() == phrase)
+            {
+                context.reply(describe(pattern));
+                return;
+            }
         }
-        std::string phrase = connect_tokens(tokens, 1, tokens.size() - 1);
+        context.reply("no such banphrase");
+        return;
+    }
 
-        if (commands_handler.add_banphrase(phrase, timeout))
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", added a new banphrase");
-        }
-        else
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", failed to add a new banphrase");
-        }
-        return true;
+    std::vector<const BanphraseAutomaton::Pattern*> costliest;
+    std::size_t disabled = 0;
+    for (auto&& pattern : patterns)
+    {
+        costliest.push_back(&pattern);
+        disabled += pattern.stats->disabled ? 1 : 0;
     }
-    else if (trigger == "!delbanphrase" && tokens.size() >= 2)
+    auto shown = std::min<std::size_t>(costliest.size(), 3);
+    std::partial_sort(costliest.begin(), costliest.begin() + static_cast<std::ptrdiff_t>(shown), costliest.end(), [](auto&& a, auto&& b)
     {
-        std::string phrase = connect_tokens(tokens, 1, tokens.size());
+        return a->stats->total_ns.load() > b->stats->total_ns.load();
+    });
 
-        if (commands_handler.remove_banphrase(phrase))
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", removed a banphrase");
-        }
-        else
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", failed to remove a banphrase");
-        }
-        return true;
+    std::string text = std::to_string(patterns.size()) + " banphrases, " + std::to_string(automaton->fallback_count()) + " on boost, " + std::to_string(disabled) + " disabled";
+    for (std::size_t i = 0; i < shown; ++i)
+    {
+        text += " | " + describe(*costliest[i]);
     }
-    else if (trigger == "!addadmin" && tokens.size() >= 3)
+    context.reply(text);
+}
+
+void Chatbot::admin_shaperule(const AdminCommandContext& context)
+{
+    // !shaperule <channel> <caps%> <symbols%> <run> <graphemes> <emotes> <timeout>, 0 turns a check off
+    auto&& args = context.args;
+    auto number = [&](std::size_t index) { return std::atoi(std::string(args[index]).c_str()); };
+    ShapeRule rule;
+    rule.max_caps_percent = number(2);
+    rule.max_symbols_percent = number(3);
+    rule.max_run = static_cast<std::size_t>(std::max(number(4), 0));
+    rule.max_graphemes = static_cast<std::size_t>(std::max(number(5), 0));
+    rule.max_emotes = static_cast<std::size_t>(std::max(number(6), 0));
+    rule.timeout = number(7);
+    if (rule.timeout == 0)
     {
-        auto&& newadmin = tokens[1];
-        std::string perms(tokens[2]);
-        int new_perm = std::atoi(perms.c_str());
-        if (new_perm > permissions)
-        {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", not enough permissions");
-            return true;
-        }
+        context.reply("zero or no timeout duration provided");
+        return;
+    }
+
+    commands_handler.set_shape_rule(args[1], rule, context.reply.done("set the shape rule", "failed to set the shape rule"));
+}
+
+void Chatbot::admin_delshaperule(const AdminCommandContext& context)
+{
+    commands_handler.remove_shape_rule(context.args[1], context.reply.done("removed the shape rule", "failed to remove the shape rule"));
+}
+
+void Chatbot::admin_linkrule(const AdminCommandContext& context)
+{
+    // !linkrule <channel> <timeout>, 0 stops timing out links
+    auto&& args = context.args;
+    int timeout = std::atoi(std::string(args[2]).c_str());
+    commands_handler.set_link_rule(args[1], timeout, context.reply.done("set the link rule", "failed to set the link rule"));
+}
 
-        auto AdminUser = users.get_user_by_username(newadmin);
+void Chatbot::admin_linkallow(const AdminCommandContext& context)
+{
+    commands_handler.add_allowed_domain(context.args[1], context.args[2], context.reply.done("allowed the domain", "failed to allow the domain"));
+}
+
+void Chatbot::admin_linkdisallow(const AdminCommandContext& context)
+{
+    commands_handler.remove_allowed_domain(context.args[1], context.args[2], context.reply.done("disallowed the domain", "failed to disallow the domain"));
+}
+
+void Chatbot::admin_addadmin(const AdminCommandContext& context)
+{
+    std::string newadmin(context.args[1]);
+    std::string perms(context.args[2]);
+    int new_perm = std::atoi(perms.c_str());
+    if (new_perm > context.permissions)
+    {
+        context.reply("not enough permissions");
+        return;
+    }
+
+    users.get_user_by_username(newadmin, [this, reply = context.reply, newadmin, new_perm](std::optional<Users::User> AdminUser)
+    {
         if (AdminUser)
         {
-            users.add_admin(AdminUser->twitchid, new_perm);
-            std::string message(ircmessage.user);
-            message += ", added new admin ";
-            message += newadmin;
-            irc_client->send_message(ircmessage.channel, message);
+            users.add_admin(AdminUser->twitchid, new_perm, reply.done("added new admin " + newadmin, "failed to add admin " + newadmin));
         }
         else
         {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", could not find user in database");
+            reply("could not find user in database");
         }
-        return true;
-    }
-    else if (trigger == "!deladmin" && tokens.size() >= 2)
-    {
-        auto&& newadmin = tokens[1];
+    });
+}
 
-        auto AdminUser = users.get_user_by_username(newadmin);
+void Chatbot::admin_deladmin(const AdminCommandContext& context)
+{
+    users.get_user_by_username(context.args[1], [this, reply = context.reply, permissions = context.permissions](std::optional<Users::User> AdminUser)
+    {
         if (AdminUser)
         {
             auto other_perm = users.get_admin_permissions(AdminUser->twitchid);
@@ -332,73 +1121,111 @@ bool Chatbot::check_admin_commands(int permissions, const IrcMessage& ircmessage
             {
                 if (other_perm > permissions)
                 {
-                    irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", not enough permissions");
+                    reply("not enough permissions");
                 }
                 else
                 {
-                    users.remove_admin(AdminUser->twitchid);
-                    irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", removed admin user " + AdminUser->username);
+                    users.remove_admin(AdminUser->twitchid, reply.done("removed admin user " + AdminUser->username, "failed to remove admin user " + AdminUser->username));
                 }
             }
             else
             {
-                irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", user is not an admin");
+                reply("user is not an admin");
             }
         }
         else
         {
-            irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", could not find user in database");
+            reply("could not find user in database");
         }
-        return true;
-    }
-    else if (trigger == "!joinchn" && tokens.size() >= 2)
-    {
-        auto&& channel = tokens[1];
-        join_channel(channel);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", joined channel " + std::string(channel));
-    }
-    else if (trigger == "!partchn" && tokens.size() >= 2)
-    {
-        auto&& channel = tokens[1];
-        part_channel(channel);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", parted channel " + std::string(channel));
-    }
-    else if (trigger == "!cmdaddchn" && tokens.size() >= 3)
-    {
-        auto&& cmd = tokens[1];
-        auto&& channel = tokens[2];
-        
-        auto ret = commands_handler.add_channel_to_command(cmd, channel);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", " + (ret ? "true" : "false"));
-    }
-    else if (trigger == "!cmdadduid" && tokens.size() >= 3)
-    {
-        auto&& cmd = tokens[1];
-        auto&& uid = tokens[2];
-        
-        auto ret = commands_handler.add_userid_to_command(cmd, uid);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", " + (ret ? "true" : "false"));
-    }
-    else if (trigger == "!cmdtogglechns" && tokens.size() >= 2)
-    {
-        auto&& cmd = tokens[1];
-        
-        auto ret = commands_handler.toggle_channels_to_command(cmd);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", " + std::to_string(ret));
-    }
-    else if (trigger == "!cmdtoggleuids" && tokens.size() >= 2)
-    {
-        auto&& cmd = tokens[1];
-        
-        auto ret = commands_handler.toggle_userids_to_command(cmd);
-        irc_client->send_message(ircmessage.channel, std::string(ircmessage.user) + ", " + std::to_string(ret));
-    }
-    else if (trigger == "!cmdshow" && tokens.size() >= 2)
-    {
-        auto && cmd = tokens[1];
+    });
+}
+
+void Chatbot::admin_joinchn(const AdminCommandContext& context)
+{
+    auto channel = context.args[1];
+    context.session.join_channel(channel);
+    publish_channels();
+    context.reply("joined channel " + std::string(channel));
+}
+
+void Chatbot::admin_partchn(const AdminCommandContext& context)
+{
+    auto channel = context.args[1];
+    context.session.part_channel(channel);
+    publish_channels();
+    context.reply("parted channel " + std::string(channel));
+}
+
+void Chatbot::admin_cmdaddchn(const AdminCommandContext& context)
+{
+    commands_handler.add_channel_to_command(context.args[1], context.args[2], context.reply.done("true", "false"));
+}
+
+void Chatbot::admin_cmdadduid(const AdminCommandContext& context)
+{
+    commands_handler.add_userid_to_command(context.args[1], context.args[2], context.reply.done("true", "false"));
+}
+
+void Chatbot::admin_cmdtogglechns(const AdminCommandContext& context)
+{
+    commands_handler.toggle_channels_to_command(context.args[1], [reply = context.reply](int ret) { reply(std::to_string(ret)); });
+}
+
+void Chatbot::admin_cmdtoggleuids(const AdminCommandContext& context)
+{
+    commands_handler.toggle_userids_to_command(context.args[1], [reply = context.reply](int ret) { reply(std::to_string(ret)); });
+}
 
-        irc_client->send_message(ircmessage.channel, commands_handler.show_cmd(cmd));
+void Chatbot::admin_cmdshow(const AdminCommandContext& context)
+{
+    context.session.send_message(context.ircmessage.channel, commands_handler.show_cmd(context.args[1]));
+}
+
+void Chatbot::admin_poolstats(const AdminCommandContext& context)
+{
+    auto stats = worker_pool->get_stats();
+    context.reply("workers " + std::to_string(stats.threads)
+        + ", queued " + std::to_string(stats.queue_depth)
+        + ", executed " + std::to_string(stats.executed)
+        + ", steals " + std::to_string(stats.steals)
+        + ", avg latency " + std::to_string(stats.average_latency.count()) + "us"
+        + ", max latency " + std::to_string(stats.max_latency.count()) + "us"
+        + (pipeline ? ", pipeline dropped " + std::to_string(pipeline->dropped_lines()) : ""));
+}
+
+void Chatbot::admin_cmdttl(const AdminCommandContext& context)
+{
+    // !cmdttl <trigger> <seconds>, 0 fetches its pages on every trigger
+    int fetch_ttl = std::atoi(std::string(context.args[2]).c_str());
+    commands_handler.set_command_ttl(context.args[1], fetch_ttl, context.reply.done("set the fetch ttl", "failed to set the fetch ttl"));
+}
+
+void Chatbot::admin_modstats(const AdminCommandContext& context)
+{
+    if (!moderation)
+    {
+        context.reply("moderation is disabled");
+        return;
     }
-    else return false;
-    return true;
+    auto stats = moderation->get_stats();
+    context.reply("submitted " + std::to_string(stats.submitted)
+        + ", evaluated " + std::to_string(stats.evaluated)
+        + ", batches " + std::to_string(stats.batches)
+        + ", actions " + std::to_string(stats.actions)
+        + ", dropped " + std::to_string(stats.dropped)
+        + ", avg latency " + std::to_string(stats.average_latency.count()) + "us"
+        + ", max latency " + std::to_string(stats.max_latency.count()) + "us");
 }
+
+void Chatbot::admin_fetchstats(const AdminCommandContext& context)
+{
+    auto stats = page_cache->get_stats();
+    context.reply("in flight " + std::to_string(echo_page->in_flight())
+        + ", fetches " + std::to_string(stats.fetches)
+        + ", hits " + std::to_string(stats.hits)
+        + ", stale hits " + std::to_string(stats.stale_hits)
+        + ", shared " + std::to_string(stats.shared_fetches)
+        + ", not modified " + std::to_string(stats.not_modified)
+        + ", pages " + std::to_string(stats.pages)
+        + ", bytes " + std::to_string(stats.bytes));
+}
\ No newline at end of file
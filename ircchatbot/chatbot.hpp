@@ -3,18 +3,36 @@
 
 #include <boost/asio.hpp>
 
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
-#include "ircauthsequence.hpp"
-#include "ircclient.hpp"
 #include "ircmessage.hpp"
 #include "database.hpp"
 #include "users.hpp"
 #include "commandshandler.hpp"
-#include "channels.hpp"
+#include "botsession.hpp"
+#include "commandarguments.hpp"
+#include "perfecthash.hpp"
+#include "messagepipeline.hpp"
+#include "workstealingpool.hpp"
+#include "stringhash.hpp"
+#include "chatfirehose.hpp"
+#include "clustermembership.hpp"
+#include "moderationstage.hpp"
+#include "duplicatedetector.hpp"
+#include "recentmessages.hpp"
+#include "echopage.hpp"
+#include "pagecache.hpp"
 
 class Chatbot
 {
+    // declared first so it outlives the db threads that post completions to it
+    boost::asio::io_context io_context;
+
 public:
     // irc_nick and irc_pass from db
     Chatbot();
@@ -23,38 +41,159 @@ public:
 
     void run();
     void stop_gracefully();
-    void join_channel(std::string_view channel_name);
-    void part_channel(std::string_view channel_name);
 
     Users users;
 private:
-    std::unique_ptr<IrcClient> irc_client;
-    IrcAuthSequence irc_auth;
+    // the primary account, further accounts come from the accounts table in config.db
     std::string irc_nick;
     std::string irc_pass;
+    // never shrinks, sessions are referenced by pointer and by index
+    std::vector<std::unique_ptr<BotSession>> sessions;
+    void init_sessions();
+    void add_session(const IrcClient::Server& server, const std::string& nick, const std::string& pass, const std::string& channels_db_name, int messages_per_window);
+    BotSession* find_session(std::string_view nick);
 
-    void init();
+    // cluster mode, enabled with the cluster_db config key; channels are divided between all processes using that file
+    std::unique_ptr<ClusterMembership> cluster;
+    void init_cluster();
 
-    void init_auth(const std::string& irc_nick, const std::string& irc_pass);
-    void init_irc_client();
+    void init();
+    void init_logger();
+    std::optional<std::string> get_config_value(std::string_view key);
 
-    void handle_ircmessage(IrcMessage&& ircmessage);
+    void handle_line(BotSession& session, std::string&& line);
+    void handle_ircmessage(BotSession& session, IrcMessage&& ircmessage);
 
-    boost::asio::io_context io_context;
     std::unique_ptr<boost::asio::io_service::work> dummy_work;
 
+    boost::asio::steady_timer users_flush_timer;
+    void schedule_users_flush();
+
     Database config_db;
     void init_config_db();
     void get_irc_nick_pass_from_config_db();
 
-    void handle_ping(const IrcMessage& ircmessage);
-    void handle_privmsg(const IrcMessage& ircmessage);
+    void handle_ping(BotSession& session, const IrcMessage& ircmessage);
+    void handle_privmsg(BotSession& session, const IrcMessage& ircmessage);
+    void add_known_user(std::string_view user_id, std::string_view user, std::string_view display_name);
 
     CommandsHandler commands_handler;
-    void ban_user(std::string_view channel, std::string_view user_id, int timeout);
-    bool check_admin_commands(int permissions, const IrcMessage& ircmessage);
+    void ban_user(BotSession& session, std::string_view channel, std::string_view user_id, int timeout);
+    bool check_admin_commands(BotSession& session, int permissions, const IrcMessage& ircmessage);
+
+    // replies to the admin who sent a command, copyable into db completions
+    struct AdminReply
+    {
+        BotSession* session;
+        std::string channel;
+        std::string user;
+        void operator()(std::string_view text) const;
+        DoneHandler done(std::string success, std::string failure) const;
+    };
+    struct AdminCommandContext
+    {
+        // the account that received the command
+        BotSession& session;
+        const IrcMessage& ircmessage;
+        int permissions;
+        const CommandArguments& args;
+        const AdminReply& reply;
+    };
+    struct AdminCommand
+    {
+        std::string_view trigger;
+        int min_permissions;
+        // including the trigger
+        std::size_t min_tokens;
+        void (Chatbot::*handler)(const AdminCommandContext& context);
+    };
+    // the number of entries in admin_commands, a mismatch fails to compile
+    static constexpr std::size_t admin_command_count = 26;
+    static const std::array<AdminCommand, admin_command_count> admin_commands;
+    static const PerfectHash::Table<PerfectHash::slot_count(admin_command_count)> admin_commands_index;
+
+    void admin_quit(const AdminCommandContext& context);
+    void admin_addcmd(const AdminCommandContext& context);
+    void admin_delcmd(const AdminCommandContext& context);
+    void admin_addbanphrase(const AdminCommandContext& context);
+    void admin_delbanphrase(const AdminCommandContext& context);
+    void admin_banphraseaddchn(const AdminCommandContext& context);
+    void admin_banphrasetogglechns(const AdminCommandContext& context);
+    void admin_banphrasestats(const AdminCommandContext& context);
+    void admin_shaperule(const AdminCommandContext& context);
+    void admin_delshaperule(const AdminCommandContext& context);
+    void admin_linkrule(const AdminCommandContext& context);
+    void admin_linkallow(const AdminCommandContext& context);
+    void admin_linkdisallow(const AdminCommandContext& context);
+    void admin_addadmin(const AdminCommandContext& context);
+    void admin_deladmin(const AdminCommandContext& context);
+    void admin_joinchn(const AdminCommandContext& context);
+    void admin_partchn(const AdminCommandContext& context);
+    void admin_cmdaddchn(const AdminCommandContext& context);
+    void admin_cmdadduid(const AdminCommandContext& context);
+    void admin_cmdtogglechns(const AdminCommandContext& context);
+    void admin_cmdtoggleuids(const AdminCommandContext& context);
+    void admin_cmdshow(const AdminCommandContext& context);
+    void admin_cmdttl(const AdminCommandContext& context);
+    void admin_poolstats(const AdminCommandContext& context);
+    void admin_modstats(const AdminCommandContext& context);
+    void admin_fetchstats(const AdminCommandContext& context);
+
+    // banphrase, shape rule and link checks of inbound chat from non admins, disabled with moderation set to 0;
+    // declared before the pool so its workers are joined before the stage they report to goes away
+    std::unique_ptr<ModerationStage> moderation;
+    void init_moderation();
+    void moderate(BotSession& session, const IrcMessage& ircmessage);
+    // copy paste spam checked inline, enabled with the duplicate_timeout config key; the io thread
+    // and every shard have their own detector
+    std::optional<DuplicateDetector::Settings> duplicate_settings;
+    int duplicate_timeout = 0;
+    std::unique_ptr<DuplicateDetector> duplicates;
+    void init_duplicates();
+    // true when the message was spam and its user is being timed out
+    bool is_duplicate_spam(DuplicateDetector& detector, const IrcMessage& ircmessage);
+    // recent chat rescanned when a banphrase is added, disabled with recent_messages set to 0;
+    // declared before the pool like moderation
+    std::unique_ptr<RecentMessages> recent_messages;
+    void init_recent_messages();
+    // limits of every boost::regex run of a banphrase, a pattern exceeding them is disabled
+    void init_banphrase_budget();
+
+    // blocking side work such as banphrase rescans, sized by the worker_threads config key
+    std::unique_ptr<WorkStealingPool> worker_pool;
+    void init_worker_pool();
+    // io thread, a response that passed the banphrase check
+    void send_response(BotSession& session, std::string_view channel, CommandResponse&& response);
+    // hands the channels of every session to the command tables, after joins and parts
+    void publish_channels();
+    // $url{} fetches, io thread; the fetch_connections config key caps the open connections,
+    // fetch_cache_bytes and fetch_cache_stale size the page cache in front of them
+    std::unique_ptr<Hemirt::Utility::EchoPage> echo_page;
+    std::unique_ptr<PageCache> page_cache;
+    void init_echo_page();
+    // fetches $url{} pages concurrently, checks banphrases on the pool once the last one is in and sends from the io thread
+    void send_fetched_response(BotSession& session, std::string channel, std::shared_ptr<const CommandTables> tables, ResponsePieces pieces, int fetch_ttl);
+
+    // every inbound line for local consumers, enabled with the firehose_name config key
+    std::unique_ptr<ChatFirehose> firehose;
+    void init_firehose();
 
-    Channels channels;
+    // pipeline mode, enabled with the pipeline_shards config key; each shard only touches its own state
+    struct alignas(64) ShardState
+    {
+        // twitch id to display name of users already reported to the io thread
+        std::unordered_map<std::string, std::string, StringHash, std::equal_to<>> known_users;
+        std::shared_ptr<const Users::AdminTable> admins;
+        std::uint64_t admins_generation = std::numeric_limits<std::uint64_t>::max();
+        std::shared_ptr<const CommandTables> tables;
+        std::uint64_t tables_generation = std::numeric_limits<std::uint64_t>::max();
+        std::unique_ptr<DuplicateDetector> duplicates;
+    };
+    std::vector<ShardState> shard_states;
+    // declared last so the shards stop before anything they read is destroyed
+    std::unique_ptr<MessagePipeline> pipeline;
+    void init_pipeline();
+    void handle_privmsg_in_shard(ShardState& shard, BotSession& session, const IrcMessage& ircmessage);
 };
 
 #endif // CHATBOT_HPP_
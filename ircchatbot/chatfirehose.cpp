@@ -0,0 +1,308 @@
+#include "chatfirehose.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ircmessage.hpp"
+#include "logger.hpp"
+
+namespace
+{
+    constexpr std::size_t header_size = (sizeof(Firehose::Header) + 63) / 64 * 64;
+
+    std::size_t records_size(std::size_t record_count)
+    {
+        return (sizeof(Firehose::Record) * record_count + 63) / 64 * 64;
+    }
+
+    std::uint64_t completed_stamp(std::uint64_t sequence)
+    {
+        return 2 * sequence + 2;
+    }
+}
+
+Firehose::LineFields Firehose::scan_line(std::string_view line)
+{
+    LineFields fields;
+    std::string_view rest = line;
+    auto offset_of = [&line](std::string_view part) { return static_cast<std::uint32_t>(part.data() - line.data()); };
+
+    if (rest.starts_with('@'))
+    {
+        auto pos = rest.find(' ');
+        if (pos == std::string_view::npos)
+        {
+            return fields;
+        }
+        rest.remove_prefix(pos + 1);
+    }
+
+    if (rest.starts_with(':'))
+    {
+        auto pos = rest.find(' ');
+        if (pos == std::string_view::npos)
+        {
+            return fields;
+        }
+        auto prefix = rest.substr(1, pos - 1);
+        if (auto bang = prefix.find('!'); bang != std::string_view::npos)
+        {
+            fields.user_offset = offset_of(prefix);
+            fields.user_length = static_cast<std::uint32_t>(bang);
+        }
+        rest.remove_prefix(pos + 1);
+    }
+
+    auto pos = rest.find(' ');
+    fields.type = static_cast<std::uint16_t>(IrcMessage::type_from_command(rest.substr(0, pos)));
+    if (pos == std::string_view::npos)
+    {
+        return fields;
+    }
+    rest.remove_prefix(pos + 1);
+
+    // first #channel among the middle params, then the trailing param as message
+    while (!rest.empty())
+    {
+        if (rest.starts_with(':'))
+        {
+            rest.remove_prefix(1);
+            fields.message_offset = offset_of(rest);
+            fields.message_length = static_cast<std::uint32_t>(rest.size());
+            break;
+        }
+        pos = rest.find(' ');
+        auto param = rest.substr(0, pos);
+        if (fields.channel_length == 0 && param.size() > 1 && param.starts_with('#'))
+        {
+            fields.channel_offset = offset_of(param) + 1;
+            fields.channel_length = static_cast<std::uint32_t>(param.size() - 1);
+        }
+        if (pos == std::string_view::npos)
+        {
+            break;
+        }
+        rest.remove_prefix(pos + 1);
+    }
+    return fields;
+}
+
+ChatFirehose::ChatFirehose(const std::string& name, std::size_t record_count, std::size_t data_capacity)
+    : name(name)
+{
+    record_count = std::bit_ceil(std::max<std::size_t>(record_count, 2));
+    data_capacity = std::bit_ceil(std::max<std::size_t>(data_capacity, 4096));
+    mapping_size = header_size + records_size(record_count) + data_capacity;
+
+    // a fresh object every run, readers still mapping the previous one see it closed
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        std::string msg = "Firehose shm_open " + name + " failed: " + std::strerror(errno);
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+    if (ftruncate(fd, static_cast<off_t>(mapping_size)) == -1)
+    {
+        std::string msg = "Firehose ftruncate " + name + " failed: " + std::strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        std::string msg = "Firehose mmap " + name + " failed: " + std::strerror(errno);
+        shm_unlink(name.c_str());
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+
+    // ftruncate zero fills, so every record stamp starts as "never written"
+    auto bytes = static_cast<char*>(mapping);
+    header = new (bytes) Firehose::Header{};
+    records = reinterpret_cast<Firehose::Record*>(bytes + header_size);
+    data = bytes + header_size + records_size(record_count);
+
+    header->version = Firehose::version;
+    header->record_count = static_cast<std::uint32_t>(record_count);
+    header->data_capacity = data_capacity;
+    header->closed.store(0, std::memory_order_relaxed);
+    header->write_sequence.store(0, std::memory_order_relaxed);
+    header->data_head.store(0, std::memory_order_relaxed);
+    // readers check magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = Firehose::magic;
+
+    log_info(LogCategory::General, "Firehose " + name + " with " + std::to_string(record_count) + " records and " + std::to_string(data_capacity) + " data bytes");
+}
+
+ChatFirehose::~ChatFirehose()
+{
+    header->closed.store(1, std::memory_order_release);
+    munmap(mapping, mapping_size);
+    shm_unlink(name.c_str());
+}
+
+void ChatFirehose::publish(std::string_view line, std::size_t session)
+{
+    const std::uint64_t capacity = header->data_capacity;
+    // a single record never takes more than a quarter of the data ring
+    line = line.substr(0, capacity / 4);
+    auto fields = Firehose::scan_line(line);
+
+    auto sequence = header->write_sequence.load(std::memory_order_relaxed);
+    auto&& record = records[sequence & (header->record_count - 1)];
+
+    // lines stay contiguous, the bytes up to the end of the ring are skipped instead of wrapping
+    auto position = header->data_head.load(std::memory_order_relaxed);
+    if ((position & (capacity - 1)) + line.size() > capacity)
+    {
+        position += capacity - (position & (capacity - 1));
+    }
+
+    // seqlock: readers of this record or of the bytes about to be overwritten notice the change
+    record.stamp.store(2 * sequence + 1, std::memory_order_relaxed);
+    header->data_head.store(position + line.size(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::memcpy(data + (position & (capacity - 1)), line.data(), line.size());
+    record.timestamp_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    record.data_position = position;
+    record.line_length = static_cast<std::uint32_t>(line.size());
+    record.type = fields.type;
+    record.session = static_cast<std::uint16_t>(session);
+    record.channel_offset = fields.channel_offset;
+    record.channel_length = fields.channel_length;
+    record.user_offset = fields.user_offset;
+    record.user_length = fields.user_length;
+    record.message_offset = fields.message_offset;
+    record.message_length = fields.message_length;
+
+    record.stamp.store(completed_stamp(sequence), std::memory_order_release);
+    header->write_sequence.store(sequence + 1, std::memory_order_release);
+}
+
+FirehoseReader::FirehoseReader(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Firehose shm_open " + name + " failed: " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || static_cast<std::size_t>(st.st_size) < header_size)
+    {
+        close(fd);
+        throw std::runtime_error("Firehose " + name + " is not initialized");
+    }
+    mapping_size = static_cast<std::size_t>(st.st_size);
+    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        throw std::runtime_error("Firehose mmap " + name + " failed: " + std::strerror(errno));
+    }
+
+    auto bytes = static_cast<const char*>(mapping);
+    header = reinterpret_cast<const Firehose::Header*>(bytes);
+    if (header->magic != Firehose::magic || header->version != Firehose::version
+        || mapping_size != header_size + records_size(header->record_count) + header->data_capacity)
+    {
+        munmap(mapping, mapping_size);
+        throw std::runtime_error("Firehose " + name + " has an unexpected layout");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    records = reinterpret_cast<const Firehose::Record*>(bytes + header_size);
+    data = bytes + header_size + records_size(header->record_count);
+    read_sequence = header->write_sequence.load(std::memory_order_acquire);
+}
+
+FirehoseReader::~FirehoseReader()
+{
+    munmap(mapping, mapping_size);
+}
+
+FirehoseReader::Status FirehoseReader::next(Event& event)
+{
+    auto written = header->write_sequence.load(std::memory_order_acquire);
+    if (read_sequence == written)
+    {
+        return header->closed.load(std::memory_order_acquire) ? Status::Closed : Status::Empty;
+    }
+
+    auto skip_ahead = [this]
+    {
+        ++overrun_count;
+        auto newest = header->write_sequence.load(std::memory_order_acquire);
+        read_sequence = std::max(read_sequence + 1, newest - std::min<std::uint64_t>(newest, header->record_count - 1));
+        return Status::Overrun;
+    };
+
+    if (written - read_sequence > header->record_count)
+    {
+        return skip_ahead();
+    }
+
+    auto&& record = records[read_sequence & (header->record_count - 1)];
+    auto stamp = completed_stamp(read_sequence);
+    if (record.stamp.load(std::memory_order_acquire) != stamp)
+    {
+        return skip_ahead();
+    }
+
+    event.sequence = read_sequence;
+    event.timestamp_ns = record.timestamp_ns;
+    event.type = record.type;
+    event.session = record.session;
+    auto position = record.data_position;
+    auto line_length = std::min<std::uint64_t>(record.line_length, header->data_capacity / 4);
+    auto line = std::string_view(data + (position & (header->data_capacity - 1)), line_length);
+    auto part = [&line](std::uint32_t offset, std::uint32_t length)
+    {
+        return offset + length <= line.size() ? line.substr(offset, length) : std::string_view{};
+    };
+    event.line = line;
+    event.channel = part(record.channel_offset, record.channel_length);
+    event.user = part(record.user_offset, record.user_length);
+    event.message = part(record.message_offset, record.message_length);
+    event.data_position = position;
+
+    if (!still_valid(event))
+    {
+        return skip_ahead();
+    }
+    ++read_sequence;
+    return Status::Ok;
+}
+
+bool FirehoseReader::still_valid(const Event& event) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto&& record = records[event.sequence & (header->record_count - 1)];
+    if (record.stamp.load(std::memory_order_relaxed) != completed_stamp(event.sequence))
+    {
+        return false;
+    }
+    // the line is gone once the writer got a whole ring past its first byte
+    return header->data_head.load(std::memory_order_relaxed) - event.data_position <= header->data_capacity;
+}
+
+std::uint64_t FirehoseReader::overruns() const
+{
+    return overrun_count;
+}
\ No newline at end of file
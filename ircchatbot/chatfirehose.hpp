@@ -0,0 +1,139 @@
+#ifndef CHATFIREHOSE_HPP_
+#define CHATFIREHOSE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// every inbound line published into a POSIX shared memory ring (/dev/shm) for local readers
+// one writer, any number of readers; the writer never waits, slow readers detect that they were overrun
+
+namespace Firehose
+{
+
+constexpr std::uint64_t magic = 0x45534f4845524946; // "FIREHOSE"
+constexpr std::uint32_t version = 1;
+
+struct Header
+{
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t record_count;
+    std::uint64_t data_capacity;
+    // set when the bot shuts down, the next run creates a new object under the same name
+    std::atomic<std::uint32_t> closed;
+    alignas(64) std::atomic<std::uint64_t> write_sequence;
+    std::atomic<std::uint64_t> data_head;
+};
+
+// offsets of channel, user and message are relative to the start of the raw line, lengths 0 when absent
+struct Record
+{
+    // 2 * sequence + 1 while being written, 2 * sequence + 2 once complete
+    std::atomic<std::uint64_t> stamp;
+    std::uint64_t timestamp_ns;
+    std::uint64_t data_position;
+    std::uint32_t line_length;
+    // IrcMessage::Type
+    std::uint16_t type;
+    // index of the bot account that received the line
+    std::uint16_t session;
+    std::uint32_t channel_offset;
+    std::uint32_t channel_length;
+    std::uint32_t user_offset;
+    std::uint32_t user_length;
+    std::uint32_t message_offset;
+    std::uint32_t message_length;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+struct LineFields
+{
+    std::uint16_t type = 0;
+    std::uint32_t channel_offset = 0;
+    std::uint32_t channel_length = 0;
+    std::uint32_t user_offset = 0;
+    std::uint32_t user_length = 0;
+    std::uint32_t message_offset = 0;
+    std::uint32_t message_length = 0;
+};
+
+// locates channel, user and message in a raw line without building an IrcMessage
+LineFields scan_line(std::string_view line);
+
+}
+
+class ChatFirehose
+{
+public:
+    // creates or resets the shared memory object, sizes are rounded up to powers of two
+    ChatFirehose(const std::string& name, std::size_t record_count, std::size_t data_capacity);
+    ~ChatFirehose();
+    ChatFirehose(const ChatFirehose&) = delete;
+    ChatFirehose& operator=(const ChatFirehose&) = delete;
+
+    // single writer
+    void publish(std::string_view line, std::size_t session);
+
+private:
+    std::string name;
+    std::size_t mapping_size = 0;
+    void* mapping = nullptr;
+    Firehose::Header* header = nullptr;
+    Firehose::Record* records = nullptr;
+    char* data = nullptr;
+};
+
+// reader side for local tools, event views point straight into the shared ring
+class FirehoseReader
+{
+public:
+    // starts at the newest event
+    explicit FirehoseReader(const std::string& name);
+    ~FirehoseReader();
+    FirehoseReader(const FirehoseReader&) = delete;
+    FirehoseReader& operator=(const FirehoseReader&) = delete;
+
+    struct Event
+    {
+        std::uint64_t sequence;
+        std::uint64_t timestamp_ns;
+        std::uint16_t type;
+        std::uint16_t session;
+        std::string_view line;
+        std::string_view channel;
+        std::string_view user;
+        std::string_view message;
+        // absolute position of line in the data stream, used by still_valid
+        std::uint64_t data_position;
+    };
+
+    enum class Status
+    {
+        Ok,
+        Empty,
+        // the writer lapped this reader, next() continues from the oldest event still available
+        Overrun,
+        // the writer is gone, open the name again to follow the next run
+        Closed
+    };
+
+    Status next(Event& event);
+    // views of event stay usable only while this is true
+    bool still_valid(const Event& event) const;
+    std::uint64_t overruns() const;
+
+private:
+    std::size_t mapping_size = 0;
+    void* mapping = nullptr;
+    const Firehose::Header* header = nullptr;
+    const Firehose::Record* records = nullptr;
+    const char* data = nullptr;
+    std::uint64_t read_sequence = 0;
+    std::uint64_t overrun_count = 0;
+};
+
+#endif // CHATFIREHOSE_HPP_
\ No newline at end of file
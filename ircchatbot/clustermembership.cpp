@@ -0,0 +1,305 @@
+#include "clustermembership.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include "hashring.hpp"
+#include "logger.hpp"
+
+namespace
+{
+    // wall clock, the file may be shared by hosts that do not share a steady clock
+    double seconds_now()
+    {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string ring_key(const ClusterMembership::ChannelKey& key)
+    {
+        return key.account + '#' + key.channel;
+    }
+}
+
+ClusterMembership::ClusterMembership(boost::asio::io_context& io_context, std::string_view db_file, std::string node_id,
+    ChannelSource channel_source, ChannelHandler on_acquired, ChannelHandler on_released)
+    : io_context(io_context)
+    , node_id(std::move(node_id))
+    , cluster_db(db_file)
+    , channel_source(std::move(channel_source))
+    , on_acquired(std::move(on_acquired))
+    , on_released(std::move(on_released))
+    , tick_timer(io_context)
+{
+    init_db();
+}
+
+ClusterMembership::~ClusterMembership()
+{
+    stop();
+}
+
+void ClusterMembership::init_db()
+{
+    // other processes hold the write lock for short transactions, wait for them instead of failing
+    for (auto&& sql : { "PRAGMA busy_timeout = 5000;", "PRAGMA journal_mode = WAL;" })
+    {
+        cluster_db.execute_statement(sql);
+    }
+
+    auto result = cluster_db.execute_statement("CREATE TABLE IF NOT EXISTS nodes (node TEXT NOT NULL PRIMARY KEY, heartbeat REAL NOT NULL);");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Cluster DB table nodes error: " + result.errmsg;
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+
+    result = cluster_db.execute_statement("CREATE TABLE IF NOT EXISTS leases (account TEXT NOT NULL, channel TEXT NOT NULL, node TEXT NOT NULL, expires REAL NOT NULL, PRIMARY KEY (account, channel));");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Cluster DB table leases error: " + result.errmsg;
+        log_error(LogCategory::General, msg);
+        throw std::runtime_error(msg);
+    }
+}
+
+const std::string& ClusterMembership::get_node_id() const
+{
+    return node_id;
+}
+
+bool ClusterMembership::holds(std::string_view account, std::string_view channel) const
+{
+    auto it = held.find(account);
+    return it != held.end() && it->second.contains(channel);
+}
+
+void ClusterMembership::start()
+{
+    log_info(LogCategory::General, "Cluster node " + node_id);
+    last_successful_tick = std::chrono::steady_clock::now();
+    stopped = false;
+    tick_timer.expires_after(std::chrono::seconds(0));
+    schedule_tick();
+}
+
+void ClusterMembership::stop()
+{
+    if (stopped)
+    {
+        return;
+    }
+    stopped = true;
+    tick_timer.cancel();
+    held.clear();
+    released.clear();
+
+    // queued behind a running tick, the db destructor drains it
+    cluster_db.post([this]
+    {
+        cluster_db.execute_prepared_statement("DELETE FROM leases WHERE node=?;", { node_id });
+        cluster_db.execute_prepared_statement("DELETE FROM nodes WHERE node=?;", { node_id });
+    });
+}
+
+void ClusterMembership::schedule_tick()
+{
+    tick_timer.async_wait([this](const boost::system::error_code& error)
+    {
+        if (error || stopped)
+        {
+            return;
+        }
+
+        cluster_db.post([this, wanted = channel_source(), released = std::move(released)]
+        {
+            auto result = run_tick(wanted, released);
+            boost::asio::post(io_context, [this, result = std::move(result)]() mutable
+            {
+                if (!stopped)
+                {
+                    apply_tick(std::move(result));
+                }
+            });
+        });
+        released.clear();
+    });
+}
+
+ClusterMembership::TickResult ClusterMembership::run_tick(const std::vector<ChannelKey>& wanted, const std::vector<ChannelKey>& released)
+{
+    TickResult tick;
+    auto now = seconds_now();
+    auto ttl = static_cast<double>(lease_ttl.count());
+
+    if (auto result = cluster_db.execute_statement("BEGIN IMMEDIATE;"); result.rc != SQLITE_OK)
+    {
+        log_warning(LogCategory::General, "Cluster DB begin error: " + result.errmsg);
+        return tick;
+    }
+
+    auto failed = [this](const Database::Result& result, std::string_view what)
+    {
+        if (result.rc == SQLITE_OK)
+        {
+            return false;
+        }
+        log_warning(LogCategory::General, "Cluster DB " + std::string(what) + " error: " + result.errmsg);
+        cluster_db.execute_statement("ROLLBACK;");
+        return true;
+    };
+
+    if (failed(cluster_db.execute_prepared_statement("INSERT INTO nodes (node, heartbeat) VALUES (?, ?) ON CONFLICT(node) DO UPDATE SET heartbeat=excluded.heartbeat;", { node_id, now }), "heartbeat"))
+    {
+        return tick;
+    }
+
+    for (auto&& key : released)
+    {
+        if (failed(cluster_db.execute_prepared_statement("DELETE FROM leases WHERE account=? AND channel=? AND node=?;", { key.account, key.channel, node_id }), "release"))
+        {
+            return tick;
+        }
+    }
+
+    auto nodes = cluster_db.execute_prepared_statement("SELECT node FROM nodes WHERE heartbeat>=?;", { now - ttl });
+    if (failed(nodes, "nodes"))
+    {
+        return tick;
+    }
+    std::vector<std::string> live_nodes;
+    for (auto&& line : nodes.data)
+    {
+        if (line[0])
+        {
+            live_nodes.push_back(*line[0]);
+        }
+    }
+    tick.live_nodes = live_nodes.size();
+    HashRing ring(live_nodes, virtual_nodes);
+
+    std::set<std::string> mine;
+    for (auto&& key : wanted)
+    {
+        auto ring_name = ring_key(key);
+        if (ring.empty() || ring.owner(ring_name) != node_id)
+        {
+            continue;
+        }
+        mine.insert(ring_name);
+        // takes a free or expired lease and renews an own one, a live lease of another node stays
+        auto acquired = cluster_db.execute_prepared_statement("INSERT INTO leases (account, channel, node, expires) VALUES (?, ?, ?, ?) "
+            "ON CONFLICT(account, channel) DO UPDATE SET node=excluded.node, expires=excluded.expires WHERE leases.node=excluded.node OR leases.expires<?;",
+            { key.account, key.channel, node_id, now + ttl, now });
+        if (failed(acquired, "acquire"))
+        {
+            return tick;
+        }
+    }
+
+    // leases this node still holds but the ring gave away keep being renewed until the io thread has parted
+    if (failed(cluster_db.execute_prepared_statement("UPDATE leases SET expires=? WHERE node=?;", { now + ttl, node_id }), "renew"))
+    {
+        return tick;
+    }
+
+    auto leases = cluster_db.execute_prepared_statement("SELECT account, channel FROM leases WHERE node=?;", { node_id });
+    if (failed(leases, "leases"))
+    {
+        return tick;
+    }
+
+    if (auto result = cluster_db.execute_statement("COMMIT;"); result.rc != SQLITE_OK)
+    {
+        failed(result, "commit");
+        return tick;
+    }
+
+    for (auto&& line : leases.data)
+    {
+        if (!line[0] || !line[1])
+        {
+            continue;
+        }
+        ChannelKey key{ *line[0], *line[1] };
+        if (mine.contains(ring_key(key)))
+        {
+            tick.owned.push_back(std::move(key));
+        }
+        else
+        {
+            tick.to_release.push_back(std::move(key));
+        }
+    }
+    tick.ok = true;
+    return tick;
+}
+
+void ClusterMembership::release(const ChannelKey& key)
+{
+    if (auto it = held.find(key.account); it != held.end())
+    {
+        if (auto channel = it->second.find(key.channel); channel != it->second.end())
+        {
+            it->second.erase(channel);
+            on_released(key);
+        }
+    }
+    released.push_back(key);
+}
+
+void ClusterMembership::apply_tick(TickResult result)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!result.ok)
+    {
+        // the leases run out soon and other nodes may take them, stop replying before that
+        if (now - last_successful_tick > lease_ttl - heartbeat_interval && !held.empty())
+        {
+            log_warning(LogCategory::General, "Cluster DB unreachable, releasing all channels");
+            for (auto&& [account, channels] : std::map(held))
+            {
+                for (auto&& channel : channels)
+                {
+                    release(ChannelKey{ account, channel });
+                }
+            }
+        }
+        tick_timer.expires_after(heartbeat_interval);
+        schedule_tick();
+        return;
+    }
+    last_successful_tick = now;
+
+    for (auto&& key : result.to_release)
+    {
+        release(key);
+    }
+
+    // channels this node lost without releasing them, e.g. after its leases expired
+    std::set<std::pair<std::string, std::string>> owned;
+    for (auto&& key : result.owned)
+    {
+        owned.emplace(key.account, key.channel);
+    }
+    for (auto&& [account, channels] : std::map(held))
+    {
+        for (auto&& channel : channels)
+        {
+            if (!owned.contains({ account, channel }))
+            {
+                release(ChannelKey{ account, channel });
+            }
+        }
+    }
+
+    for (auto&& key : result.owned)
+    {
+        if (held[key.account].insert(key.channel).second)
+        {
+            on_acquired(key);
+        }
+    }
+
+    tick_timer.expires_after(heartbeat_interval);
+    schedule_tick();
+}
\ No newline at end of file
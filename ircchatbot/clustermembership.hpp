@@ -0,0 +1,88 @@
+#ifndef CLUSTERMEMBERSHIP_HPP_
+#define CLUSTERMEMBERSHIP_HPP_
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "database.hpp"
+
+// several bot processes sharing one SQLite file divide the channels among themselves:
+// nodes heartbeat into the file, every channel goes to its owner on a consistent hash ring
+// and is only joined while that node holds the channel's lease. A node hands a channel over
+// by parting it first and deleting the lease on its next tick, so two nodes never reply in the same channel
+class ClusterMembership
+{
+public:
+    struct ChannelKey
+    {
+        std::string account;
+        std::string channel;
+    };
+    // every channel of every account that should be served by the cluster, read on each tick
+    using ChannelSource = std::function<std::vector<ChannelKey>()>;
+    using ChannelHandler = std::function<void(const ChannelKey& key)>;
+
+    ClusterMembership(boost::asio::io_context& io_context, std::string_view db_file, std::string node_id,
+        ChannelSource channel_source, ChannelHandler on_acquired, ChannelHandler on_released);
+    ~ClusterMembership();
+    ClusterMembership(const ClusterMembership&) = delete;
+    ClusterMembership& operator=(const ClusterMembership&) = delete;
+
+    void start();
+    // leaves the cluster and deletes the own leases, so the other nodes take over on their next tick
+    void stop();
+
+    // io thread only
+    bool holds(std::string_view account, std::string_view channel) const;
+    const std::string& get_node_id() const;
+
+    static constexpr std::chrono::seconds heartbeat_interval{ 2 };
+    // nodes without a heartbeat for this long are dead and their leases free
+    static constexpr std::chrono::seconds lease_ttl{ 10 };
+    static constexpr std::size_t virtual_nodes = 64;
+
+private:
+    boost::asio::io_context& io_context;
+    // before cluster_db, the jobs it drains on destruction still read it
+    std::string node_id;
+    Database cluster_db;
+    void init_db();
+
+    ChannelSource channel_source;
+    ChannelHandler on_acquired;
+    ChannelHandler on_released;
+
+    std::map<std::string, std::set<std::string, std::less<>>, std::less<>> held;
+    // parted on the io thread, their leases are deleted by the next tick
+    std::vector<ChannelKey> released;
+    std::chrono::steady_clock::time_point last_successful_tick;
+
+    boost::asio::steady_timer tick_timer;
+    bool stopped = false;
+    void schedule_tick();
+
+    struct TickResult
+    {
+        bool ok = false;
+        std::size_t live_nodes = 0;
+        // leases held and still owned on the ring
+        std::vector<ChannelKey> owned;
+        // leases held but owned by another node now
+        std::vector<ChannelKey> to_release;
+    };
+    // db thread
+    TickResult run_tick(const std::vector<ChannelKey>& wanted, const std::vector<ChannelKey>& released);
+    void apply_tick(TickResult result);
+    void release(const ChannelKey& key);
+};
+
+#endif // CLUSTERMEMBERSHIP_HPP_
\ No newline at end of file
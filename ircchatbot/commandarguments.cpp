@@ -0,0 +1,66 @@
+#include "commandarguments.hpp"
+
+#include <algorithm>
+
+CommandArguments::CommandArguments(std::string_view line)
+    : line(line)
+{
+}
+
+std::size_t CommandArguments::size() const
+{
+    if (token_count == 0)
+    {
+        token_count = std::count(line.begin(), line.end(), ' ') + 1;
+    }
+    return token_count;
+}
+
+std::size_t CommandArguments::token_start(std::size_t index) const
+{
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < index; ++i)
+    {
+        pos = line.find(' ', pos);
+        if (pos == std::string_view::npos)
+        {
+            return line.size();
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+std::size_t CommandArguments::token_end(std::size_t start) const
+{
+    auto pos = line.find(' ', start);
+    return pos == std::string_view::npos ? line.size() : pos;
+}
+
+std::string_view CommandArguments::operator[](std::size_t index) const
+{
+    auto start = token_start(index);
+    return line.substr(start, token_end(start) - start);
+}
+
+std::string_view CommandArguments::back() const
+{
+    auto pos = line.rfind(' ');
+    return pos == std::string_view::npos ? line : line.substr(pos + 1);
+}
+
+std::string_view CommandArguments::join(std::size_t first, std::size_t last) const
+{
+    if (first >= last)
+    {
+        return {};
+    }
+    auto start = token_start(first);
+    auto end = token_end(token_start(last - 1));
+    return line.substr(start, end - start);
+}
+
+std::string_view CommandArguments::rest(std::size_t first) const
+{
+    return line.substr(token_start(first));
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef COMMANDARGUMENTS_HPP_
+#define COMMANDARGUMENTS_HPP_
+
+#include <cstddef>
+#include <string_view>
+
+// view over a command line split on single spaces, tokens are located on demand without allocating
+// empty tokens between repeated spaces are kept, so join() returns the original text
+class CommandArguments
+{
+public:
+    explicit CommandArguments(std::string_view line);
+
+    // number of tokens including the trigger
+    std::size_t size() const;
+    std::string_view operator[](std::size_t index) const;
+    std::string_view back() const;
+    // tokens [first, last) with the spacing of the original line
+    std::string_view join(std::size_t first, std::size_t last) const;
+    // tokens from first to the end of the line
+    std::string_view rest(std::size_t first) const;
+
+private:
+    std::string_view line;
+    mutable std::size_t token_count = 0;
+
+    std::size_t token_start(std::size_t index) const;
+    std::size_t token_end(std::size_t start) const;
+};
+
+#endif // COMMANDARGUMENTS_HPP_
\ No newline at end of file
@@ -3,39 +3,78 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
-#include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
-#include <iostream>
 #include <vector>
 #include <string_view>
-#include <sstream>
 
-#include "echopage.hpp"
+#include "skeleton.hpp"
+#include "logger.hpp"
 
 constexpr std::string_view commands_db_name = "commands.db";
 
-CommandsHandler::CommandsHandler()
-    : commands_db(commands_db_name)
+// commands and banphrases store their channels the same way
+template <typename Detail>
+void load_channels(const std::string& channels_string, Detail& detail)
+{
+    if (channels_string.empty())
+    {
+        return;
+    }
+    
+    switch (channels_string.front())
+    {
+        case '-':
+            detail.c_include = false;
+            break;
+        case '+':
+        default:
+            detail.c_include = true;
+            break;
+    }
+    
+    boost::algorithm::split(detail.channels, channels_string.substr(1), boost::algorithm::is_any_of(","), boost::algorithm::token_compress_on);
+    // the trailing comma of channels_to_string
+    detail.channels.erase("");
+}
+
+CommandsHandler::CommandsHandler(boost::asio::io_context& io_context)
+    : io_context(io_context)
+    , commands_db(commands_db_name)
 {
     init_db();
 }
 
 void CommandsHandler::init_db()
 {
+    auto loaded = std::make_shared<CommandTables>();
+
     auto result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS commands (trigger TEXT NOT NULL PRIMARY KEY, response TEXT NOT NULL, channels TEXT, users TEXT);");
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Commands DB table commands error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Commands, msg);
         throw std::runtime_error(msg);
     }
 
+    // tables created before commands had a fetch ttl
+    result = commands_db.execute_statement("PRAGMA table_info(commands);");
+    if (std::none_of(result.data.begin(), result.data.end(), [](auto&& line) { return line.size() > 1 && line[1] && *line[1] == "fetch_ttl"; }))
     {
-        result = commands_db.execute_statement("SELECT * FROM commands;");
+        result = commands_db.execute_statement("ALTER TABLE commands ADD COLUMN fetch_ttl INT;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Commands DB table commands add fetch_ttl error: " + result.errmsg;
+            log_error(LogCategory::Commands, msg);
+            throw std::runtime_error(msg);
+        }
+    }
+
+    {
+        result = commands_db.execute_statement("SELECT trigger, response, channels, users, fetch_ttl FROM commands;");
         if (result.rc != SQLITE_OK)
         {
             std::string msg = "Commands DB table commands select all error: " + result.errmsg;
-            std::cerr << msg << std::endl;
+            log_error(LogCategory::Commands, msg);
             throw std::runtime_error(msg);
         }
 
@@ -44,25 +83,38 @@ void CommandsHandler::init_db()
             auto cmd = create_command(line);
             if (cmd)
             {
-                commands.emplace(*line[0], std::move(*cmd));
+                loaded->commands.emplace(*line[0], std::move(*cmd));
             }
         }
     }
 
-    result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS banphrases (phrase TEXT NOT NULL PRIMARY KEY, timeout INT NOT NULL);");
+    result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS banphrases (phrase TEXT NOT NULL PRIMARY KEY, timeout INT NOT NULL, channels TEXT);");
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Commands DB table banphrases error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Commands, msg);
         throw std::runtime_error(msg);
     }
 
+    // tables created before banphrases had channels
+    result = commands_db.execute_statement("PRAGMA table_info(banphrases);");
+    if (std::none_of(result.data.begin(), result.data.end(), [](auto&& line) { return line.size() > 1 && line[1] && *line[1] == "channels"; }))
     {
-        result = commands_db.execute_statement("SELECT * FROM banphrases;");
+        result = commands_db.execute_statement("ALTER TABLE banphrases ADD COLUMN channels TEXT;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Commands DB table banphrases add channels error: " + result.errmsg;
+            log_error(LogCategory::Commands, msg);
+            throw std::runtime_error(msg);
+        }
+    }
+
+    {
+        result = commands_db.execute_statement("SELECT phrase, timeout, channels FROM banphrases;");
         if (result.rc != SQLITE_OK)
         {
             std::string msg = "Commands DB table banphrases select all error: " + result.errmsg;
-            std::cerr << msg << std::endl;
+            log_error(LogCategory::Commands, msg);
             throw std::runtime_error(msg);
         }
 
@@ -73,31 +125,117 @@ void CommandsHandler::init_db()
             {
                 continue;
             }
-            int timeout = std::stoi(*line[1]);
-            banphrases.emplace(r_phrase, timeout);
+            BanphraseDetail banphrase{ std::stoi(*line[1]), {} };
+            if (line[2])
+            {
+                load_channels(*line[2], banphrase);
+            }
+            loaded->banphrases.emplace(r_phrase, std::move(banphrase));
         }
     }
-}
 
-void load_channels(const std::string& channels_string, CommandDetail& cmd)
-{
-    if (channels_string.empty())
+    result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS shaperules (channel TEXT NOT NULL PRIMARY KEY, max_caps INT NOT NULL, max_symbols INT NOT NULL, max_run INT NOT NULL, max_graphemes INT NOT NULL, max_emotes INT NOT NULL, timeout INT NOT NULL);");
+    if (result.rc != SQLITE_OK)
     {
-        return;
+        std::string msg = "Commands DB table shaperules error: " + result.errmsg;
+        log_error(LogCategory::Commands, msg);
+        throw std::runtime_error(msg);
     }
-    
-    switch (channels_string.front())
+
     {
-        case '-':
-            cmd.c_include = false;
-            break;
-        case '+':
-        default:
-            cmd.c_include = true;
-            break;
+        result = commands_db.execute_statement("SELECT channel, max_caps, max_symbols, max_run, max_graphemes, max_emotes, timeout FROM shaperules;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Commands DB table shaperules select all error: " + result.errmsg;
+            log_error(LogCategory::Commands, msg);
+            throw std::runtime_error(msg);
+        }
+
+        for (auto&& line : result.data)
+        {
+            ShapeRule rule;
+            rule.max_caps_percent = std::stoi(*line[1]);
+            rule.max_symbols_percent = std::stoi(*line[2]);
+            rule.max_run = std::stoul(*line[3]);
+            rule.max_graphemes = std::stoul(*line[4]);
+            rule.max_emotes = std::stoul(*line[5]);
+            rule.timeout = std::stoi(*line[6]);
+            loaded->shape_rules.emplace(*line[0], rule);
+        }
     }
-    
-    boost::algorithm::split(cmd.channels, channels_string.substr(1), boost::algorithm::is_any_of(","), boost::algorithm::token_compress_on);
+
+    result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS linkrules (channel TEXT NOT NULL PRIMARY KEY, timeout INT NOT NULL);");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Commands DB table linkrules error: " + result.errmsg;
+        log_error(LogCategory::Commands, msg);
+        throw std::runtime_error(msg);
+    }
+
+    result = commands_db.execute_statement("CREATE TABLE IF NOT EXISTS linkdomains (channel TEXT NOT NULL, domain TEXT NOT NULL, PRIMARY KEY (channel, domain));");
+    if (result.rc != SQLITE_OK)
+    {
+        std::string msg = "Commands DB table linkdomains error: " + result.errmsg;
+        log_error(LogCategory::Commands, msg);
+        throw std::runtime_error(msg);
+    }
+
+    {
+        result = commands_db.execute_statement("SELECT channel, timeout FROM linkrules;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Commands DB table linkrules select all error: " + result.errmsg;
+            log_error(LogCategory::Commands, msg);
+            throw std::runtime_error(msg);
+        }
+
+        for (auto&& line : result.data)
+        {
+            loaded->link_rules[*line[0]].timeout = std::stoi(*line[1]);
+        }
+
+        result = commands_db.execute_statement("SELECT channel, domain FROM linkdomains;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Commands DB table linkdomains select all error: " + result.errmsg;
+            log_error(LogCategory::Commands, msg);
+            throw std::runtime_error(msg);
+        }
+
+        for (auto&& line : result.data)
+        {
+            loaded->link_rules[*line[0]].allowed_domains.insert(*line[1]);
+        }
+    }
+
+    loaded->rebuild_banphrase_automaton();
+    tables = std::move(loaded);
+    published_tables.store(tables, std::memory_order_release);
+}
+
+template <typename Modify>
+void CommandsHandler::update_tables(Modify&& modify)
+{
+    auto next = std::make_shared<CommandTables>(*tables);
+    modify(*next);
+    tables = std::move(next);
+    published_tables.store(tables, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+const std::shared_ptr<const CommandTables>& CommandsHandler::get_tables() const
+{
+    return tables;
+}
+
+std::shared_ptr<const CommandTables> CommandsHandler::load_published_tables() const
+{
+    return published_tables.load(std::memory_order_acquire);
+}
+
+std::uint64_t CommandsHandler::tables_generation() const
+{
+    return generation.load(std::memory_order_acquire);
 }
 
 void load_users(const std::string& users_string, CommandDetail& cmd)
@@ -121,7 +259,7 @@ void load_users(const std::string& users_string, CommandDetail& cmd)
     boost::algorithm::split(cmd.userids, users_string.substr(1), boost::algorithm::is_any_of(","), boost::algorithm::token_compress_on);
 }
 
-constexpr std::size_t COMMAND_DATA_SIZE = 4; // number of db columns
+constexpr std::size_t COMMAND_DATA_SIZE = 5; // number of db columns
 
 std::optional<CommandDetail> CommandsHandler::create_command(std::vector<std::optional<std::string>> command_data)
 {
@@ -133,6 +271,7 @@ std::optional<CommandDetail> CommandsHandler::create_command(std::vector<std::op
     CommandDetail cmd;
     cmd.trigger = *command_data[0];
     cmd.response = *command_data[1];
+    cmd.response_template = std::make_shared<const ResponseTemplate>(cmd.response);
     
     auto&& channels = command_data[2];
     if (channels)
@@ -144,67 +283,126 @@ std::optional<CommandDetail> CommandsHandler::create_command(std::vector<std::op
     {
         load_users(*users, cmd);
     }
+    auto&& fetch_ttl = command_data[4];
+    if (fetch_ttl)
+    {
+        cmd.fetch_ttl = std::stoi(*fetch_ttl);
+    }
     
     return cmd;
 }
 
-bool CommandsHandler::add_banphrase(std::string_view phrase, int timeout)
+void CommandsHandler::write_async(std::string sql, std::vector<Database::ValueType> values, DoneHandler on_done)
+{
+    commands_db.async_execute_prepared_statement(io_context.get_executor(), std::move(sql), std::move(values), [on_done = std::move(on_done)](Database::Result result)
+    {
+        if (on_done)
+        {
+            on_done(result.rc == SQLITE_OK);
+        }
+    });
+}
+
+void CommandsHandler::add_banphrase(std::string_view phrase, int timeout, DoneHandler on_done)
 {
     boost::regex r_phrase(phrase.begin(), phrase.end(), boost::regex_constants::no_except);
     if (r_phrase.status() != 0)
     {
-        return false;
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
 
-    auto result = commands_db.execute_prepared_statement("INSERT INTO banphrases (phrase, timeout) VALUES (?, ?);", { std::string(phrase), timeout });
-
-    banphrases.emplace(r_phrase, timeout);
+    write_async("INSERT INTO banphrases (phrase, timeout) VALUES (?, ?);", { std::string(phrase), timeout }, std::move(on_done));
 
-    return result.rc == SQLITE_OK;
+    update_tables([&](CommandTables& next)
+    {
+        next.banphrases.emplace(r_phrase, BanphraseDetail{ timeout, {} });
+        next.rebuild_banphrase_automaton();
+    });
 }
 
-bool CommandsHandler::remove_banphrase(std::string_view phrase)
+void CommandsHandler::remove_banphrase(std::string_view phrase, DoneHandler on_done)
 {
     boost::regex r_phrase(phrase.begin(), phrase.end(), boost::regex_constants::no_except);
     if (r_phrase.status() != 0)
     {
-        return false;
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
 
-    auto result = commands_db.execute_prepared_statement("DELETE FROM banphrases WHERE phrase=?;", { std::string(phrase) });
-
-    banphrases.erase(r_phrase);
+    write_async("DELETE FROM banphrases WHERE phrase=?;", { std::string(phrase) }, std::move(on_done));
 
-    return result.rc == SQLITE_OK;
+    update_tables([&](CommandTables& next)
+    {
+        next.banphrases.erase(r_phrase);
+        next.rebuild_banphrase_automaton();
+    });
 }
 
-bool CommandsHandler::add_textcommand(std::string_view trigger, std::string_view response)
+void CommandsHandler::add_textcommand(std::string_view trigger, std::string_view response, DoneHandler on_done)
 {
-    auto result = commands_db.execute_prepared_statement("INSERT INTO commands (trigger, response) VALUES (?, ?);", { std::string(trigger), std::string(response) });
+    write_async("INSERT INTO commands (trigger, response) VALUES (?, ?);", { std::string(trigger), std::string(response) }, std::move(on_done));
 
     CommandDetail cmd;
     cmd.trigger = trigger;
     cmd.response = response;
     
-    commands.emplace(trigger, cmd);
-
-    return result.rc == SQLITE_OK;
+    update_tables([&](CommandTables& next)
+    {
+        cmd.response_template = std::make_shared<const ResponseTemplate>(response, next.channels);
+        next.commands.emplace(trigger, cmd);
+    });
 }
 
-bool CommandsHandler::remove_textcommand(std::string_view trigger)
+void CommandsHandler::set_channels(std::set<ChannelName, std::less<>> channels)
 {
+    if (channels == tables->channels)
+    {
+        return;
+    }
+    update_tables([&](CommandTables& next)
+    {
+        next.channels = std::move(channels);
+        for (auto&& [trigger, cmd] : next.commands)
+        {
+            if (cmd.response_template->is_static())
+            {
+                cmd.response_template = std::make_shared<const ResponseTemplate>(cmd.response, next.channels);
+            }
+        }
+    });
+}
 
-    auto result = commands_db.execute_prepared_statement("DELETE FROM commands WHERE trigger=?;", { std::string(trigger) });
+void CommandsHandler::remove_textcommand(std::string_view trigger, DoneHandler on_done)
+{
+    write_async("DELETE FROM commands WHERE trigger=?;", { std::string(trigger) }, std::move(on_done));
 
-    if (auto it = commands.find(trigger); it != commands.end())
+    update_tables([&](CommandTables& next)
     {
-        commands.erase(it);
-    }
+        if (auto it = next.commands.find(trigger); it != next.commands.end())
+        {
+            next.commands.erase(it);
+        }
+    });
+}
+
+std::optional<CommandResponse> CommandsHandler::handle_privmsg(const IrcMessage& ircmessage)
+{
+    return tables->handle_privmsg(ircmessage);
+}
 
-    return result.rc == SQLITE_OK;
+int CommandsHandler::is_banphrased(std::string_view line, std::string_view channel)
+{
+    return tables->is_banphrased(line, channel);
 }
 
-std::optional<std::string> CommandsHandler::handle_privmsg(const IrcMessage& ircmessage)
+std::optional<CommandResponse> CommandTables::handle_privmsg(const IrcMessage& ircmessage) const
 {
     if (ircmessage.type != IrcMessage::Type::PRIVMSG)
     {
@@ -242,57 +440,27 @@ std::optional<std::string> CommandsHandler::handle_privmsg(const IrcMessage& irc
             }
         }
         
-        auto response_string = cmd.response;
-        
-        std::vector<std::string_view> tokens;
-        boost::algorithm::split(tokens, ircmessage.message, boost::algorithm::is_any_of(" "), boost::algorithm::token_compress_on);
-                
-        {
-            boost::regex e("\\${\\d+}");
-            
-            std::vector<int> vec_num_params{0};  // vector of ${number} numbers
-            boost::match_results<std::string::const_iterator> results;
-            if (boost::regex_search(response_string, results, e)) {
-                for (const auto& result : results) {
-                    vec_num_params.push_back(boost::lexical_cast<int>(std::string_view(result.begin() + 2, result.end() - 1)));
-                }
-            }
-            
-            int maximal_number = *std::max_element(vec_num_params.begin(), vec_num_params.end());
-                        
-            if (maximal_number > tokens.size())
-            {
-                return std::nullopt;
-            }
-            else
-            {
-                std::stringstream ss;
-                
-                for (int i = 0; i <= maximal_number; ++i)
-                {
-                    ss.str(std::string());
-                    ss.clear();
-                    ss << "${" << i << "}";
-                    
-                    boost::algorithm::replace_all(response_string, ss.str(), tokens[i]);
-                }
-            }
+        auto&& response_template = *cmd.response_template;
+        CommandResponse response;
+        if (response_template.is_static())
+        {
+            response.text = response_template.get_source();
+            response.frame = response_template.frame(ircmessage.channel);
+            return response;
         }
-        
+
+        if (!response_template.render(ircmessage.message, response.pieces))
         {
-            auto& Echo = Hemirt::Utility::EchoPage::get_instance();
-            
-            boost::regex e("\\$url{([^}]+)}");
-            boost::match_results<std::string::const_iterator> results;
-            
-            while (boost::regex_search(response_string, results, e)) {
-                std::string page = results[1];
-                std::string replace = Echo.echo_page(page);
-                response_string = boost::regex_replace(response_string, e, replace, boost::match_default | boost::format_first_only);
-            }
+            return std::nullopt;
         }
-        
-        return response_string;
+        response.has_fetches = response_template.has_fetches();
+        if (!response.has_fetches)
+        {
+            response.text = std::move(response.pieces.texts.front());
+            response.pieces.texts.clear();
+        }
+        response.fetch_ttl = cmd.fetch_ttl;
+        return response;
     }
 
     return std::nullopt;
@@ -300,7 +468,7 @@ std::optional<std::string> CommandsHandler::handle_privmsg(const IrcMessage& irc
 
 std::string CommandsHandler::show_cmd(std::string_view trigger)
 {
-    if (auto it = commands.find(trigger); it != commands.end())
+    if (auto it = tables->commands.find(trigger); it != tables->commands.end())
     {
         return it->second.response;
     }
@@ -308,31 +476,134 @@ std::string CommandsHandler::show_cmd(std::string_view trigger)
     return "";
 }
 
-int CommandsHandler::is_banphrased(std::string_view line)
+void CommandTables::rebuild_banphrase_automaton()
 {
-    boost::regex_iterator<std::string_view::const_iterator> end;
-    int total_timeout = 0;
+    std::vector<std::pair<boost::regex, int>> patterns;
+    patterns.reserve(banphrases.size());
+    for (auto&& [regex, banphrase] : banphrases)
+    {
+        patterns.emplace_back(regex, banphrase.timeout);
+    }
+    banphrase_automaton = std::make_shared<const BanphraseAutomaton>(patterns, banphrase_automaton.get());
+    rebuild_banphrase_masks();
+}
 
-    for (auto&& [phrase, timeout] : banphrases)
+void CommandTables::rebuild_banphrase_masks()
+{
+    // pattern indexes follow the order of banphrases, as in rebuild_banphrase_automaton
+    default_banphrase_mask = boost::dynamic_bitset<>(banphrases.size());
+    banphrase_masks.clear();
+    std::size_t index = 0;
+    for (auto&& [regex, banphrase] : banphrases)
     {
-        boost::regex_iterator<std::string_view::const_iterator> start(line.begin(), line.end(), phrase);
-        auto count = std::distance(start, end);
-        if (count > 0)
+        // excluding lists and unscoped banphrases apply in every channel they do not name
+        if (banphrase.channels.empty() || !banphrase.c_include)
         {
-            if (timeout == -1)
-            {
-                return -1;
-            }
-            else
-            {
-                total_timeout += timeout * count;
-            }
+            default_banphrase_mask.set(index);
+        }
+        ++index;
+    }
+
+    // a named channel starts from the default and the banphrases naming it are switched on or off
+    index = 0;
+    for (auto&& [regex, banphrase] : banphrases)
+    {
+        for (auto&& channel : banphrase.channels)
+        {
+            auto&& mask = banphrase_masks.try_emplace(channel, default_banphrase_mask).first->second;
+            mask.set(index, banphrase.c_include);
         }
+        ++index;
+    }
+}
+
+int CommandTables::is_banphrased(std::string_view line, std::string_view channel) const
+{
+    if (!banphrase_automaton)
+    {
+        return 0;
+    }
+
+    auto mask = banphrase_masks.find(channel);
+    auto&& scope = mask != banphrase_masks.end() ? mask->second : default_banphrase_mask;
+    if (scope.none())
+    {
+        return 0;
+    }
+
+    // homoglyphs, fullwidth letters and invisible characters are folded away first, ascii lines are used as they are
+    thread_local std::string folded;
+    auto skeleton = Skeleton::fold(line, folded);
+    auto timeout = banphrase_timeout(skeleton, scope);
+    if (timeout == -1 || skeleton.data() == line.data())
+    {
+        return timeout;
+    }
+    // patterns written with non ascii characters still match the original
+    auto original = banphrase_timeout(line, scope);
+    return original == -1 ? -1 : std::max(timeout, original);
+}
+
+int CommandTables::banphrase_timeout(std::string_view line, const boost::dynamic_bitset<>& scope) const
+{
+    // one pass finds the matching patterns, boost only counts the matches of those
+    thread_local std::vector<std::size_t> matches;
+    matches.clear();
+    banphrase_automaton->find_matches(line, matches, &scope);
+
+    int total_timeout = 0;
+    auto&& patterns = banphrase_automaton->get_patterns();
+    for (auto index : matches)
+    {
+        auto&& pattern = patterns[index];
+        if (pattern.timeout == -1)
+        {
+            pattern.stats->hits.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        // a pattern aborted over its budget counts as not matching
+        total_timeout += pattern.timeout * static_cast<int>(banphrase_automaton->run_regex(index, line, true).value_or(0));
     }
 
     return total_timeout;
 }
 
+int CommandTables::check_shape(std::string_view message, std::string_view channel, std::string_view emotes_tag, std::string_view& reason) const
+{
+    auto it = shape_rules.find(channel);
+    if (it == shape_rules.end())
+    {
+        return 0;
+    }
+
+    auto shape = MessageShape::measure(message);
+    shape.add_emotes(message, emotes_tag);
+    reason = it->second.violation(shape);
+    return reason.empty() ? 0 : it->second.timeout;
+}
+
+int CommandTables::check_links(std::string_view message, std::string_view channel) const
+{
+    auto it = link_rules.find(channel);
+    if (it == link_rules.end() || it->second.timeout == 0)
+    {
+        return 0;
+    }
+
+    thread_local std::vector<std::string> hosts;
+    hosts.clear();
+    LinkDetector::find_hosts(message, hosts);
+    auto&& allowed = it->second.allowed_domains;
+    for (auto&& host : hosts)
+    {
+        if (!allowed.contains(host))
+        {
+            return it->second.timeout;
+        }
+    }
+    return 0;
+}
+
 std::string CommandDetail::channels_to_string() const
 {
     std::string ret = c_include ? "+" : "-";
@@ -343,6 +614,16 @@ std::string CommandDetail::channels_to_string() const
     return ret;
 }
 
+std::string BanphraseDetail::channels_to_string() const
+{
+    std::string ret = c_include ? "+" : "-";
+    for (auto&& i : channels)
+    {
+        ret += i + ",";
+    }
+    return ret;
+}
+
 std::string CommandDetail::userids_to_string() const
 {
     std::string ret = u_include ? "+" : "-";
@@ -353,82 +634,310 @@ std::string CommandDetail::userids_to_string() const
     return ret;
 }
 
-bool CommandsHandler::add_channel_to_command(std::string_view trigger, std::string_view channel_sv)
+void CommandsHandler::add_channel_to_command(std::string_view trigger, std::string_view channel_sv, DoneHandler on_done)
 {
-    auto it = commands.find(trigger);
-    if (it == commands.end())
+    if (!tables->commands.contains(trigger))
     {
-        return false;
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
-    auto&& cmd = it->second;
     
     std::string channel = std::string(channel_sv);
     boost::algorithm::to_lower(channel);
-    cmd.channels.insert(channel);
-    
-    auto str = cmd.channels_to_string();
-    auto result = commands_db.execute_prepared_statement("UPDATE commands SET channels = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) });
 
-    return result.rc == SQLITE_OK;
+    std::string str;
+    update_tables([&](CommandTables& next)
+    {
+        auto&& cmd = next.commands.find(trigger)->second;
+        cmd.channels.insert(channel);
+        str = cmd.channels_to_string();
+    });
+
+    write_async("UPDATE commands SET channels = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) }, std::move(on_done));
 }
 
-bool CommandsHandler::add_userid_to_command(std::string_view trigger, std::string_view userid)
+void CommandsHandler::set_command_ttl(std::string_view trigger, int fetch_ttl, DoneHandler on_done)
 {
-    auto it = commands.find(trigger);
-    if (it == commands.end())
+    if (!tables->commands.contains(trigger) || fetch_ttl < 0)
     {
-        return false;
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
-    auto&& cmd = it->second;
-    
-    cmd.userids.insert(std::string(userid));
-    
-    auto str = cmd.userids_to_string();
-    auto result = commands_db.execute_prepared_statement("UPDATE commands SET users = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) });
 
-    return result.rc == SQLITE_OK;
+    update_tables([&](CommandTables& next) { next.commands.find(trigger)->second.fetch_ttl = fetch_ttl; });
+
+    write_async("UPDATE commands SET fetch_ttl = ? WHERE trigger = ?;", { fetch_ttl, std::string(trigger) }, std::move(on_done));
 }
 
-int CommandsHandler::toggle_channels_to_command(std::string_view trigger)
+void CommandsHandler::add_userid_to_command(std::string_view trigger, std::string_view userid, DoneHandler on_done)
 {
-    auto it = commands.find(trigger);
-    if (it == commands.end())
+    if (!tables->commands.contains(trigger))
     {
-        return -1;
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
-    auto&& cmd = it->second;
-    
-    cmd.c_include = !cmd.c_include;
-    auto str = cmd.channels_to_string();
-    auto result = commands_db.execute_prepared_statement("UPDATE commands SET channels = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) });
     
-    if (result.rc != SQLITE_OK)
+    std::string str;
+    update_tables([&](CommandTables& next)
     {
-        cmd.c_include = !cmd.c_include;
-        return -2;
+        auto&& cmd = next.commands.find(trigger)->second;
+        cmd.userids.insert(std::string(userid));
+        str = cmd.userids_to_string();
+    });
+
+    write_async("UPDATE commands SET users = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) }, std::move(on_done));
+}
+
+void CommandsHandler::toggle_channels_to_command(std::string_view trigger, ToggleHandler on_toggled)
+{
+    if (!tables->commands.contains(trigger))
+    {
+        if (on_toggled)
+        {
+            on_toggled(-1);
+        }
+        return;
     }
     
-    return cmd.c_include;
+    std::string str;
+    update_tables([&](CommandTables& next)
+    {
+        auto&& cmd = next.commands.find(trigger)->second;
+        cmd.c_include = !cmd.c_include;
+        str = cmd.channels_to_string();
+    });
+
+    write_async("UPDATE commands SET channels = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) },
+        [this, trigger = std::string(trigger), on_toggled = std::move(on_toggled)](bool ok)
+    {
+        if (!tables->commands.contains(trigger))
+        {
+            if (on_toggled)
+            {
+                on_toggled(-1);
+            }
+            return;
+        }
+
+        if (!ok)
+        {
+            update_tables([&](CommandTables& next)
+            {
+                auto&& cmd = next.commands.find(trigger)->second;
+                cmd.c_include = !cmd.c_include;
+            });
+        }
+        if (on_toggled)
+        {
+            on_toggled(ok ? tables->commands.find(trigger)->second.c_include : -2);
+        }
+    });
 }
 
-int CommandsHandler::toggle_userids_to_command(std::string_view trigger)
+void CommandsHandler::toggle_userids_to_command(std::string_view trigger, ToggleHandler on_toggled)
 {
-    auto it = commands.find(trigger);
-    if (it == commands.end())
+    if (!tables->commands.contains(trigger))
     {
-        return -1;
+        if (on_toggled)
+        {
+            on_toggled(-1);
+        }
+        return;
     }
-    auto&& cmd = it->second;
     
-    cmd.u_include = !cmd.u_include;
-    auto str = cmd.userids_to_string();
-    auto result = commands_db.execute_prepared_statement("UPDATE commands SET users = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) });
-    
-    if (result.rc != SQLITE_OK)
+    std::string str;
+    update_tables([&](CommandTables& next)
     {
+        auto&& cmd = next.commands.find(trigger)->second;
         cmd.u_include = !cmd.u_include;
-        return -2;
+        str = cmd.userids_to_string();
+    });
+
+    write_async("UPDATE commands SET users = ? WHERE trigger = ?;", { std::move(str), std::string(trigger) },
+        [this, trigger = std::string(trigger), on_toggled = std::move(on_toggled)](bool ok)
+    {
+        if (!tables->commands.contains(trigger))
+        {
+            if (on_toggled)
+            {
+                on_toggled(-1);
+            }
+            return;
+        }
+
+        if (!ok)
+        {
+            update_tables([&](CommandTables& next)
+            {
+                auto&& cmd = next.commands.find(trigger)->second;
+                cmd.u_include = !cmd.u_include;
+            });
+        }
+        if (on_toggled)
+        {
+            on_toggled(ok ? tables->commands.find(trigger)->second.u_include : -2);
+        }
+    });
+}
+
+
+void CommandsHandler::add_channel_to_banphrase(std::string_view phrase, std::string_view channel_sv, DoneHandler on_done)
+{
+    boost::regex r_phrase(phrase.begin(), phrase.end(), boost::regex_constants::no_except);
+    if (r_phrase.status() != 0 || !tables->banphrases.contains(r_phrase))
+    {
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
     }
-    
-    return cmd.u_include;
+
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+
+    // the automaton stays, only the channel masks change
+    std::string str;
+    update_tables([&](CommandTables& next)
+    {
+        auto&& banphrase = next.banphrases.find(r_phrase)->second;
+        banphrase.channels.insert(channel);
+        str = banphrase.channels_to_string();
+        next.rebuild_banphrase_masks();
+    });
+
+    write_async("UPDATE banphrases SET channels = ? WHERE phrase = ?;", { std::move(str), std::string(phrase) }, std::move(on_done));
+}
+
+void CommandsHandler::toggle_channels_to_banphrase(std::string_view phrase, ToggleHandler on_toggled)
+{
+    boost::regex r_phrase(phrase.begin(), phrase.end(), boost::regex_constants::no_except);
+    if (r_phrase.status() != 0 || !tables->banphrases.contains(r_phrase))
+    {
+        if (on_toggled)
+        {
+            on_toggled(-1);
+        }
+        return;
+    }
+
+    std::string str;
+    update_tables([&](CommandTables& next)
+    {
+        auto&& banphrase = next.banphrases.find(r_phrase)->second;
+        banphrase.c_include = !banphrase.c_include;
+        str = banphrase.channels_to_string();
+        next.rebuild_banphrase_masks();
+    });
+
+    write_async("UPDATE banphrases SET channels = ? WHERE phrase = ?;", { std::move(str), std::string(phrase) },
+        [this, r_phrase, on_toggled = std::move(on_toggled)](bool ok)
+    {
+        if (!tables->banphrases.contains(r_phrase))
+        {
+            if (on_toggled)
+            {
+                on_toggled(-1);
+            }
+            return;
+        }
+
+        if (!ok)
+        {
+            update_tables([&](CommandTables& next)
+            {
+                auto&& banphrase = next.banphrases.find(r_phrase)->second;
+                banphrase.c_include = !banphrase.c_include;
+                next.rebuild_banphrase_masks();
+            });
+        }
+        if (on_toggled)
+        {
+            on_toggled(ok ? tables->banphrases.find(r_phrase)->second.c_include : -2);
+        }
+    });
+}
+
+void CommandsHandler::set_shape_rule(std::string_view channel_sv, const ShapeRule& rule, DoneHandler on_done)
+{
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+
+    write_async("INSERT OR REPLACE INTO shaperules (channel, max_caps, max_symbols, max_run, max_graphemes, max_emotes, timeout) VALUES (?, ?, ?, ?, ?, ?, ?);",
+        { channel, rule.max_caps_percent, rule.max_symbols_percent, static_cast<int>(rule.max_run), static_cast<int>(rule.max_graphemes), static_cast<int>(rule.max_emotes), rule.timeout },
+        std::move(on_done));
+
+    update_tables([&](CommandTables& next) { next.shape_rules.insert_or_assign(channel, rule); });
+}
+
+void CommandsHandler::remove_shape_rule(std::string_view channel_sv, DoneHandler on_done)
+{
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+
+    write_async("DELETE FROM shaperules WHERE channel=?;", { channel }, std::move(on_done));
+
+    update_tables([&](CommandTables& next) { next.shape_rules.erase(channel); });
+}
+
+void CommandsHandler::set_link_rule(std::string_view channel_sv, int timeout, DoneHandler on_done)
+{
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+
+    if (timeout == 0)
+    {
+        write_async("DELETE FROM linkrules WHERE channel=?;", { channel }, std::move(on_done));
+    }
+    else
+    {
+        write_async("INSERT OR REPLACE INTO linkrules (channel, timeout) VALUES (?, ?);", { channel, timeout }, std::move(on_done));
+    }
+
+    update_tables([&](CommandTables& next) { next.link_rules[channel].timeout = timeout; });
+}
+
+void CommandsHandler::add_allowed_domain(std::string_view channel_sv, std::string_view domain_sv, DoneHandler on_done)
+{
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+    auto domain = DomainTrie::normalize(domain_sv);
+    if (domain.empty())
+    {
+        if (on_done)
+        {
+            on_done(false);
+        }
+        return;
+    }
+
+    write_async("INSERT OR IGNORE INTO linkdomains (channel, domain) VALUES (?, ?);", { channel, domain }, std::move(on_done));
+
+    update_tables([&](CommandTables& next) { next.link_rules[channel].allowed_domains.insert(domain); });
 }
+
+void CommandsHandler::remove_allowed_domain(std::string_view channel_sv, std::string_view domain_sv, DoneHandler on_done)
+{
+    std::string channel = std::string(channel_sv);
+    boost::algorithm::to_lower(channel);
+    auto domain = DomainTrie::normalize(domain_sv);
+
+    write_async("DELETE FROM linkdomains WHERE channel=? AND domain=?;", { channel, domain }, std::move(on_done));
+
+    update_tables([&](CommandTables& next)
+    {
+        if (auto it = next.link_rules.find(channel); it != next.link_rules.end())
+        {
+            it->second.allowed_domains.erase(domain);
+        }
+    });
+}
\ No newline at end of file
@@ -3,14 +3,26 @@
 
 #include "database.hpp"
 
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <boost/algorithm/string/regex.hpp>
+#include <boost/dynamic_bitset.hpp>
 #include <set>
 
 #include "ircmessage.hpp"
+#include "banphraseautomaton.hpp"
+#include "messageshape.hpp"
+#include "linkfilter.hpp"
+#include "responsetemplate.hpp"
 
 using ChannelName = std::string;
 using UserId = std::string;
@@ -20,6 +32,10 @@ struct CommandDetail
 {
     Trigger trigger;
     std::string response;
+    // parsed once from response, shared by every copy of the tables
+    std::shared_ptr<const ResponseTemplate> response_template;
+    // seconds its $url{} pages are answered from the page cache, 0 fetches every time
+    int fetch_ttl = 0;
     std::set<ChannelName, std::less<>> channels;
     bool c_include = true;
     std::string channels_to_string() const;
@@ -28,36 +44,118 @@ struct CommandDetail
     std::string userids_to_string() const;
 };
 
+struct BanphraseDetail
+{
+    int timeout;
+    // like CommandDetail::channels, empty applies everywhere
+    std::set<ChannelName, std::less<>> channels;
+    bool c_include = true;
+    std::string channels_to_string() const;
+};
+
+struct CommandResponse
+{
+    // ${n} filled in, without fetches
+    std::string text;
+    // with fetches, the text around them
+    ResponsePieces pieces;
+    bool has_fetches = false;
+    int fetch_ttl = 0;
+    // the whole PRIVMSG line of a static response in a channel of CommandTables::channels, empty otherwise
+    std::string frame;
+};
+
+// never modified once published, so the io thread and pipeline shards can read it without locking
+struct CommandTables
+{
+    std::map<boost::regex, BanphraseDetail> banphrases;
+    // rebuilt whenever a banphrase is added or removed, sharing the compiled patterns of the previous one
+    std::shared_ptr<const BanphraseAutomaton> banphrase_automaton;
+    void rebuild_banphrase_automaton();
+    // banphrases in scope per channel, one bit per automaton pattern; channels named by no banphrase
+    // use the default mask, so a channel costs a bitset and never another automaton
+    boost::dynamic_bitset<> default_banphrase_mask;
+    std::map<ChannelName, boost::dynamic_bitset<>, std::less<>> banphrase_masks;
+    void rebuild_banphrase_masks();
+    std::map<Trigger, CommandDetail, std::less<>> commands;
+    // caps, symbol, repetition, length and emote limits per channel
+    std::map<ChannelName, ShapeRule, std::less<>> shape_rules;
+    // link timeouts and allowed domains per channel
+    std::map<ChannelName, LinkRule, std::less<>> link_rules;
+    // channels the bot may be in, static responses have their PRIVMSG lines built for them
+    std::set<ChannelName, std::less<>> channels;
+
+    std::optional<CommandResponse> handle_privmsg(const IrcMessage& ircmessage) const;
+    // checks the confusable skeleton of line, and line itself when they differ
+    int is_banphrased(std::string_view line, std::string_view channel) const;
+    // sum of the matching timeouts in scope, -1 for a ban
+    int banphrase_timeout(std::string_view line, const boost::dynamic_bitset<>& scope) const;
+    // timeout of the channel's shape rule when the message breaks it, reason names the threshold
+    int check_shape(std::string_view message, std::string_view channel, std::string_view emotes_tag, std::string_view& reason) const;
+    // timeout of the channel's link rule when the message links a host outside its allowed domains
+    int check_links(std::string_view message, std::string_view channel) const;
+};
+
 class CommandsHandler
 {
 public:
-    CommandsHandler();
+    CommandsHandler(boost::asio::io_context& io_context);
 
-    bool add_banphrase(std::string_view phrase, int timeout);
-    bool remove_banphrase(std::string_view phrase);
+    // in-memory tables change immediately, on_done reports the db write from the io_context
+    void add_banphrase(std::string_view phrase, int timeout, DoneHandler on_done = {});
+    void remove_banphrase(std::string_view phrase, DoneHandler on_done = {});
 
-    bool add_textcommand(std::string_view trigger, std::string_view response);
-    bool remove_textcommand(std::string_view trigger);
+    void add_textcommand(std::string_view trigger, std::string_view response, DoneHandler on_done = {});
+    void remove_textcommand(std::string_view trigger, DoneHandler on_done = {});
+    // rebuilds the PRIVMSG lines of static responses when the channels changed
+    void set_channels(std::set<ChannelName, std::less<>> channels);
 
     /* handle PRIVMSG IrcMessages */
-    std::optional<std::string> handle_privmsg(const IrcMessage& ircmessage);
-    int is_banphrased(std::string_view line);
+    std::optional<CommandResponse> handle_privmsg(const IrcMessage& ircmessage);
+    int is_banphrased(std::string_view line, std::string_view channel);
     std::string show_cmd(std::string_view trigger);
 
+    // current tables, io thread only
+    const std::shared_ptr<const CommandTables>& get_tables() const;
+    // safe from any thread, reload the published tables only when the generation changed
+    std::shared_ptr<const CommandTables> load_published_tables() const;
+    std::uint64_t tables_generation() const;
+
     std::optional<CommandDetail> create_command(std::vector<std::optional<std::string>> command_data);
 
-    bool add_channel_to_command(std::string_view trigger, std::string_view channel);
-    bool add_userid_to_command(std::string_view trigger, std::string_view userid);
+    void add_channel_to_command(std::string_view trigger, std::string_view channel, DoneHandler on_done = {});
+    void add_userid_to_command(std::string_view trigger, std::string_view userid, DoneHandler on_done = {});
+    void set_command_ttl(std::string_view trigger, int fetch_ttl, DoneHandler on_done = {});
 
-    int toggle_userids_to_command(std::string_view trigger);
-    int toggle_channels_to_command(std::string_view trigger);
+    // on_toggled gets the new include state, -1 for unknown command, -2 for db error
+    using ToggleHandler = std::function<void(int)>;
+    void toggle_userids_to_command(std::string_view trigger, ToggleHandler on_toggled = {});
+    void toggle_channels_to_command(std::string_view trigger, ToggleHandler on_toggled = {});
+
+    void add_channel_to_banphrase(std::string_view phrase, std::string_view channel, DoneHandler on_done = {});
+    void toggle_channels_to_banphrase(std::string_view phrase, ToggleHandler on_toggled = {});
+
+    void set_shape_rule(std::string_view channel, const ShapeRule& rule, DoneHandler on_done = {});
+    void remove_shape_rule(std::string_view channel, DoneHandler on_done = {});
+
+    // timeout 0 stops checking links, the allowed domains are kept
+    void set_link_rule(std::string_view channel, int timeout, DoneHandler on_done = {});
+    void add_allowed_domain(std::string_view channel, std::string_view domain, DoneHandler on_done = {});
+    void remove_allowed_domain(std::string_view channel, std::string_view domain, DoneHandler on_done = {});
 
 private:
+    boost::asio::io_context& io_context;
     Database commands_db;
-    std::map<boost::regex, int> banphrases;
-    std::map<Trigger, CommandDetail, std::less<>> commands;
+    std::shared_ptr<const CommandTables> tables;
+    std::atomic<std::shared_ptr<const CommandTables>> published_tables;
+    std::atomic<std::uint64_t> generation{ 0 };
+
+    // copies the tables, applies modify to the copy and publishes it
+    template <typename Modify>
+    void update_tables(Modify&& modify);
 
     void init_db();
+    void write_async(std::string sql, std::vector<Database::ValueType> values, DoneHandler on_done);
 };
 
 #endif // COMMANDS_HANDLER_HPP
@@ -1,6 +1,6 @@
 #include "database.hpp"
 
-#include <iostream>
+#include "logger.hpp"
 
 Database::Database(std::string_view db_file)
     : db_filename(db_file)
@@ -11,6 +11,69 @@ Database::Database(std::string_view db_file)
         throw std::runtime_error("Unable to open sqlite3 connection: " + std::to_string(rc));
     }
     db.reset(tmp);
+
+    worker = std::thread([this] { run_jobs(); });
+}
+
+Database::~Database()
+{
+    {
+        std::lock_guard lk(jobs_mutex);
+        stopping = true;
+    }
+    jobs_cv.notify_one();
+    // queued jobs are drained before the connection is closed
+    worker.join();
+}
+
+void Database::run_jobs()
+{
+    std::unique_lock lk(jobs_mutex);
+    while (true)
+    {
+        jobs_cv.wait(lk, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+        {
+            return;
+        }
+
+        auto job = std::move(jobs.front());
+        jobs.pop_front();
+        lk.unlock();
+        try
+        {
+            job();
+        }
+        catch (std::exception& e)
+        {
+            log_error(LogCategory::Database, db_filename + " job exception: " + e.what());
+        }
+        lk.lock();
+    }
+}
+
+void Database::post(std::function<void()> job)
+{
+    {
+        std::lock_guard lk(jobs_mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobs_cv.notify_one();
+}
+
+void Database::async_execute_prepared_statement(const boost::asio::any_io_executor& executor, std::string sql, std::vector<ValueType> values, ResultHandler on_done)
+{
+    post([this, executor, sql = std::move(sql), values = std::move(values), on_done = std::move(on_done)]() mutable
+    {
+        auto result = execute_prepared_statement(sql, std::move(values));
+        if (on_done)
+        {
+            boost::asio::post(executor, [on_done = std::move(on_done), result = std::move(result)]() mutable
+            {
+                on_done(std::move(result));
+            });
+        }
+    });
 }
 
 static int default_callback(void* result_ptr, int argc, char** argv, char** colnames)
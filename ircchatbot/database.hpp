@@ -3,18 +3,31 @@
 
 #include "sqlite3.h"
 
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <string_view>
 #include <vector>
 #include <utility>
 #include <optional>
 #include <variant>
 
+// reports whether an asynchronous database operation succeeded
+using DoneHandler = std::function<void(bool)>;
+
 class Database
 {
 public:
     Database(std::string_view db_file);
+    ~Database();
+    Database(const Database&) = delete;
+    Database& operator=(const Database&) = delete;
 
     using CallbackFun = int (*)(void*, int, char**, char**);
     struct Result
@@ -29,6 +42,12 @@ public:
     Result execute_prepared_statement(const std::string& sql, std::vector<ValueType> values);
     std::pair<int, std::string> execute_statement(const std::string& sql, CallbackFun callback, void* data);
 
+    // jobs run in order on the connection's own thread, so they never block the caller
+    void post(std::function<void()> job);
+    // runs the statement on the connection's thread and posts on_done with the result to executor
+    using ResultHandler = std::function<void(Result)>;
+    void async_execute_prepared_statement(const boost::asio::any_io_executor& executor, std::string sql, std::vector<ValueType> values, ResultHandler on_done = {});
+
 private:
     struct Sqlite3Deleter
     {
@@ -62,6 +81,13 @@ private:
     std::unique_ptr<sqlite3, Sqlite3Deleter> db;
 
     std::string db_filename;
+
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::thread worker;
+    void run_jobs();
 };
 
 #endif // DATABASE_HPP_
\ No newline at end of file
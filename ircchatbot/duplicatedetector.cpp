@@ -0,0 +1,159 @@
+#include "duplicatedetector.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+    std::uint64_t mix(std::uint64_t x)
+    {
+        // murmur3 finalizer, every input bit reaches every output bit
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        return x ^ (x >> 33);
+    }
+}
+
+DuplicateDetector::DuplicateDetector(const Settings& settings)
+    : settings(settings)
+{
+}
+
+std::uint64_t DuplicateDetector::fingerprint(std::string_view message)
+{
+    // each shingle votes for the set bits of its hash; the 64 vote counters are bit sliced,
+    // slice k holds bit k of every counter, so a vote is a ripple carry add over whole words
+    std::array<std::uint64_t, 16> slices{};
+    std::size_t shingles = 0;
+
+    std::uint32_t shingle = 0;
+    std::size_t characters = 0;
+    for (char ch : message)
+    {
+        auto c = static_cast<unsigned char>(ch);
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = static_cast<unsigned char>(c - 'A' + 'a');
+        }
+        else if (c < 0x80 && !(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9'))
+        {
+            continue;
+        }
+        shingle = ((shingle << 8) | c) & 0xFFFFFF;
+        if (++characters < 3)
+        {
+            continue;
+        }
+
+        auto carry = mix(shingle);
+        for (std::size_t k = 0; carry != 0 && k < slices.size(); ++k)
+        {
+            auto next = slices[k] & carry;
+            slices[k] ^= carry;
+            carry = next;
+        }
+        ++shingles;
+    }
+
+    if (shingles == 0)
+    {
+        return mix(shingle);
+    }
+    // bits voted by more than half of the shingles, compared slice by slice from the top
+    auto half = std::min<std::size_t>(shingles / 2, (std::size_t(1) << slices.size()) - 1);
+    std::uint64_t greater = 0;
+    std::uint64_t equal = ~0ull;
+    for (auto k = slices.size(); k-- > 0;)
+    {
+        auto threshold = (half >> k) & 1 ? ~0ull : 0;
+        greater |= equal & slices[k] & ~threshold;
+        equal &= ~(slices[k] ^ threshold);
+    }
+    return greater;
+}
+
+template <std::size_t N>
+std::size_t DuplicateDetector::Ring<N>::count_near(std::uint64_t fingerprint, Clock::time_point since, int max_distance) const
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < filled; ++i)
+    {
+        count += times[i] >= since && std::popcount(fingerprints[i] ^ fingerprint) <= max_distance;
+    }
+    return count;
+}
+
+template <std::size_t N>
+void DuplicateDetector::Ring<N>::push(std::uint64_t fingerprint, Clock::time_point now)
+{
+    fingerprints[next] = fingerprint;
+    times[next] = now;
+    next = (next + 1) % N;
+    filled = std::min(filled + 1, N);
+}
+
+template <std::size_t N>
+DuplicateDetector::Clock::time_point DuplicateDetector::Ring<N>::last() const
+{
+    return times[(next + N - 1) % N];
+}
+
+bool DuplicateDetector::check(std::string_view channel, std::string_view user_id, std::string_view message, Clock::time_point now)
+{
+    if (message.size() < settings.min_length)
+    {
+        return false;
+    }
+
+    auto print = fingerprint(message);
+    auto since = now - settings.window;
+    bool flagged = false;
+
+    if (settings.user_repeats > 0)
+    {
+        key.assign(channel);
+        key += ' ';
+        key += user_id;
+        auto it = users.find(key);
+        if (it == users.end())
+        {
+            if (users.size() >= max_users)
+            {
+                evict_idle(now);
+            }
+            it = users.try_emplace(key).first;
+        }
+        flagged = it->second.count_near(print, since, settings.max_distance) >= settings.user_repeats;
+        it->second.push(print, now);
+    }
+
+    if (settings.channel_repeats > 0)
+    {
+        auto it = channels.find(channel);
+        if (it == channels.end())
+        {
+            it = channels.try_emplace(std::string(channel)).first;
+        }
+        flagged = flagged || it->second.count_near(print, since, settings.max_distance) >= settings.channel_repeats;
+        it->second.push(print, now);
+    }
+
+    return flagged;
+}
+
+void DuplicateDetector::evict_idle(Clock::time_point now)
+{
+    auto since = now - settings.window;
+    std::erase_if(users, [&](auto&& entry) { return entry.second.last() < since; });
+    if (users.size() >= max_users)
+    {
+        users.clear();
+    }
+}
+
+std::size_t DuplicateDetector::tracked_users() const
+{
+    return users.size();
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef DUPLICATEDETECTOR_HPP_
+#define DUPLICATEDETECTOR_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "stringhash.hpp"
+
+// near duplicate chat messages by 64-bit simhash; not thread safe, the io thread and every pipeline
+// shard keep their own, channels never move between shards
+class DuplicateDetector
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        // only messages this recent are compared
+        std::chrono::seconds window{ 30 };
+        // differing fingerprint bits of a near duplicate
+        int max_distance = 6;
+        // near duplicates of the user's own recent messages that flag a message, 0 turns it off
+        std::size_t user_repeats = 2;
+        // near duplicates of anyone's recent messages in the channel that flag a message, 0 turns it off
+        std::size_t channel_repeats = 0;
+        // shorter messages are neither checked nor remembered
+        std::size_t min_length = 16;
+    };
+
+    explicit DuplicateDetector(const Settings& settings);
+
+    // simhash over lowercased three character shingles, punctuation and spaces skipped
+    static std::uint64_t fingerprint(std::string_view message);
+
+    // remembers the message, true when it is a near duplicate of enough recent ones
+    bool check(std::string_view channel, std::string_view user_id, std::string_view message, Clock::time_point now = Clock::now());
+
+    std::size_t tracked_users() const;
+
+    static constexpr std::size_t user_ring_size = 8;
+    static constexpr std::size_t channel_ring_size = 32;
+    // idle users are evicted past this, all of them when none is idle
+    static constexpr std::size_t max_users = 100000;
+
+private:
+    template <std::size_t N>
+    struct Ring
+    {
+        std::array<std::uint64_t, N> fingerprints{};
+        std::array<Clock::time_point, N> times{};
+        std::size_t filled = 0;
+        std::size_t next = 0;
+
+        std::size_t count_near(std::uint64_t fingerprint, Clock::time_point since, int max_distance) const;
+        void push(std::uint64_t fingerprint, Clock::time_point now);
+        Clock::time_point last() const;
+    };
+
+    Settings settings;
+    // keyed by channel and user id
+    std::unordered_map<std::string, Ring<user_ring_size>, StringHash, std::equal_to<>> users;
+    std::unordered_map<std::string, Ring<channel_ring_size>, StringHash, std::equal_to<>> channels;
+    std::string key;
+    void evict_idle(Clock::time_point now);
+};
+
+#endif // DUPLICATEDETECTOR_HPP_
\ No newline at end of file
@@ -1,56 +1,390 @@
 #include "echopage.hpp"
 
-#include <iostream>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <algorithm>
 #include <stdexcept>
+#include <string_view>
+
+#include "logger.hpp"
 
 namespace Hemirt::Utility
 {
 
+EchoPage::Socket::Socket(boost::asio::io_context& io_context, curl_socket_t fd)
+    : descriptor(io_context, fd)
+{
+}
 
-EchoPage::EchoPage()
+EchoPage::Socket::~Socket()
 {
-    curl = curl_easy_init();
-    if (curl) {
-        chunk = curl_slist_append(chunk, "Accept: text/plain");
-    } else {
-        std::cerr << "EchoPage curl error" << std::endl;
+    // curl owns the fd and closes it itself
+    if (descriptor.is_open())
+    {
+        descriptor.release();
+    }
+}
+
+EchoPage::EchoPage(boost::asio::io_context& io_context, long max_connections)
+    : io_context(io_context)
+    , timer(io_context)
+{
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        log_error(LogCategory::Http, "EchoPage curl error");
         throw std::runtime_error("EchoPage curl error");
     }
+    multi = curl_multi_init();
+    if (!multi)
+    {
+        curl_global_cleanup();
+        log_error(LogCategory::Http, "EchoPage curl multi error");
+        throw std::runtime_error("EchoPage curl multi error");
+    }
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &EchoPage::socket_callback);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &EchoPage::timer_callback);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+    // fetches past the limit wait inside curl for a free connection
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, max_connections);
+    chunk = curl_slist_append(chunk, "Accept: text/plain");
 }
 
 EchoPage::~EchoPage()
 {
+    for (auto&& [easy, transfer] : transfers)
+    {
+        curl_multi_remove_handle(multi, easy);
+    }
+    transfers.clear();
+    sockets.clear();
+    curl_multi_cleanup(multi);
     curl_slist_free_all(chunk);
-    curl_easy_cleanup(curl);
+    curl_global_cleanup();
+}
+
+std::size_t EchoPage::write_callback(char* data, std::size_t size, std::size_t count, void* userp)
+{
+    auto transfer = static_cast<Transfer*>(userp);
+    auto&& body = transfer->page.body;
+    auto&& slice = transfer->slice;
+    std::string_view chunk(data, size * count);
+
+    if (transfer->json)
+    {
+        auto result = transfer->json->feed(chunk);
+        if (result == JsonExtractor::Result::NeedMore)
+        {
+            return size * count;
+        }
+        finish_json(*transfer, result);
+        transfer->stopped = true;
+        return 0;
+    }
+
+    bool stop = false;
+    if (slice.lines == Slice::Lines::First)
+    {
+        if (auto line_break = chunk.find_first_of("\r\n"); line_break != std::string_view::npos)
+        {
+            chunk = chunk.substr(0, line_break);
+            stop = true;
+        }
+    }
+    if (chunk.size() > slice.max_bytes - body.size())
+    {
+        chunk = chunk.substr(0, slice.max_bytes - body.size());
+        transfer->page.complete = false;
+        stop = true;
+    }
+
+    auto appended = body.size();
+    body += chunk;
+    if (slice.lines == Slice::Lines::Join)
+    {
+        std::replace_if(body.begin() + static_cast<std::ptrdiff_t>(appended), body.end(), [](char c) { return c == '\r' || c == '\n'; }, ' ');
+    }
+    if (!stop)
+    {
+        return size * count;
+    }
+    truncate(body, body.size());
+    transfer->stopped = true;
+    return 0;
+}
+
+void EchoPage::finish_json(Transfer& transfer, JsonExtractor::Result result)
+{
+    auto&& page = transfer.page;
+    switch (result)
+    {
+    case JsonExtractor::Result::Found:
+        page.body = transfer.json->take_value();
+        page.complete = page.body.size() < transfer.slice.max_bytes;
+        truncate(page.body, transfer.slice.max_bytes);
+        break;
+    case JsonExtractor::Result::Missing:
+        page.body = "Error: json path not found";
+        break;
+    default:
+        page.body = "Error: invalid json";
+        break;
+    }
+}
+
+void EchoPage::truncate(std::string& text, std::size_t max_bytes)
+{
+    if (text.size() > max_bytes)
+    {
+        text.resize(max_bytes);
+    }
+    // a lead byte whose sequence does not fit is dropped with its continuation bytes
+    for (std::size_t back = 1; back <= 4 && back <= text.size(); ++back)
+    {
+        auto c = static_cast<unsigned char>(text[text.size() - back]);
+        if ((c & 0xC0) == 0x80)
+        {
+            continue;
+        }
+        std::size_t length = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        if (length > back)
+        {
+            text.resize(text.size() - back);
+        }
+        return;
+    }
 }
 
 static size_t
-WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+HeaderCallback(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    auto page = static_cast<EchoPage::Page*>(userp);
+    std::string_view line(buffer, size * nitems);
+    // a new status line, e.g. after 100 Continue, starts the headers over
+    if (line.starts_with("HTTP/"))
+    {
+        page->etag.clear();
+        page->last_modified.clear();
+        return size * nitems;
+    }
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos)
+    {
+        return size * nitems;
+    }
+    auto name = line.substr(0, colon);
+    auto value = line.substr(colon + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+    {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == '\r' || value.back() == '\n' || value.back() == ' '))
+    {
+        value.remove_suffix(1);
+    }
+    if (boost::algorithm::iequals(name, "ETag"))
+    {
+        page->etag = value;
+    }
+    else if (boost::algorithm::iequals(name, "Last-Modified"))
+    {
+        page->last_modified = value;
+    }
+    return size * nitems;
+}
+
+void EchoPage::echo_page(const std::string& page, Handler on_done)
 {
-    ((std::string *)userp)->append((char *)contents, size * nmemb);
-    return size * nmemb;
+    fetch(page, {}, {}, Slice{}, [on_done = std::move(on_done)](Page page) { on_done(std::move(page.body)); });
 }
 
-std::string EchoPage::echo_page(const std::string& page)
+void EchoPage::fetch(const std::string& page, const std::string& etag, const std::string& last_modified, const Slice& slice, PageHandler on_done)
 {
-    std::lock_guard lk(curl_mtx);
-    std::string read_buffer;
-    
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
+    auto transfer = std::make_unique<Transfer>();
+    transfer->slice = slice;
+    transfer->handle.reset(curl_easy_init());
+    CURL* curl = transfer->handle.get();
+    if (!curl)
+    {
+        on_done(Page{ 0, "Error: curl init failed" });
+        return;
+    }
+    transfer->on_done = std::move(on_done);
+
+    if (!slice.json_path.empty())
+    {
+        auto path = JsonExtractor::parse_path(slice.json_path);
+        if (!path)
+        {
+            transfer->on_done(Page{ 0, "Error: invalid json path" });
+            return;
+        }
+        transfer->json.emplace(std::move(*path), slice.max_bytes);
+    }
+
+    curl_slist* headers = chunk;
+    if (transfer->json || !etag.empty() || !last_modified.empty())
+    {
+        headers = curl_slist_append(nullptr, transfer->json ? "Accept: application/json" : "Accept: text/plain");
+        if (!etag.empty())
+        {
+            headers = curl_slist_append(headers, ("If-None-Match: " + etag).c_str());
+        }
+        if (!last_modified.empty())
+        {
+            headers = curl_slist_append(headers, ("If-Modified-Since: " + last_modified).c_str());
+        }
+        transfer->headers.reset(headers);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl, CURLOPT_URL, page.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &read_buffer);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
-    
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_reset(curl);
-    
-    if (res)
-    {
-        return std::string("Error: ") + curl_easy_strerror(res);
-    }
-    
-    return read_buffer;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &EchoPage::write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer.get());
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer->page);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    if (auto rc = curl_multi_add_handle(multi, curl); rc != CURLM_OK)
+    {
+        transfer->on_done(Page{ 0, std::string("Error: ") + curl_multi_strerror(rc) });
+        return;
+    }
+    transfers.emplace(curl, std::move(transfer));
+}
+
+std::size_t EchoPage::in_flight() const
+{
+    return transfers.size();
+}
+
+int EchoPage::socket_callback(CURL*, curl_socket_t fd, int what, void* userp, void*)
+{
+    auto self = static_cast<EchoPage*>(userp);
+    if (what == CURL_POLL_REMOVE)
+    {
+        if (auto it = self->sockets.find(fd); it != self->sockets.end())
+        {
+            // waits still pending see removed and leave the socket alone
+            it->second->removed = true;
+            it->second->descriptor.release();
+            self->sockets.erase(it);
+        }
+        return 0;
+    }
+
+    auto it = self->sockets.find(fd);
+    if (it == self->sockets.end())
+    {
+        it = self->sockets.emplace(fd, std::make_shared<Socket>(self->io_context, fd)).first;
+    }
+    it->second->what = what;
+    self->wait_for(it->second, fd);
+    return 0;
+}
+
+int EchoPage::timer_callback(CURLM*, long timeout_ms, void* userp)
+{
+    auto self = static_cast<EchoPage*>(userp);
+    if (timeout_ms < 0)
+    {
+        self->timer.cancel();
+        return 0;
+    }
+    // never called back into curl from inside its own callback, even for a zero timeout
+    self->timer.expires_after(std::chrono::milliseconds(timeout_ms));
+    self->timer.async_wait([self](const boost::system::error_code& error)
+    {
+        if (!error)
+        {
+            self->socket_action(CURL_SOCKET_TIMEOUT, 0);
+        }
+    });
+    return 0;
+}
+
+void EchoPage::wait_for(const std::shared_ptr<Socket>& socket, curl_socket_t fd)
+{
+    // one wait per direction, rearmed after curl has handled it for as long as curl still wants it
+    if ((socket->what & CURL_POLL_IN) && !socket->reading)
+    {
+        socket->reading = true;
+        socket->descriptor.async_wait(boost::asio::posix::stream_descriptor::wait_read, [this, socket, fd](const boost::system::error_code& error)
+        {
+            socket->reading = false;
+            if (error || socket->removed)
+            {
+                return;
+            }
+            socket_action(fd, CURL_CSELECT_IN);
+            if (!socket->removed)
+            {
+                wait_for(socket, fd);
+            }
+        });
+    }
+    if ((socket->what & CURL_POLL_OUT) && !socket->writing)
+    {
+        socket->writing = true;
+        socket->descriptor.async_wait(boost::asio::posix::stream_descriptor::wait_write, [this, socket, fd](const boost::system::error_code& error)
+        {
+            socket->writing = false;
+            if (error || socket->removed)
+            {
+                return;
+            }
+            socket_action(fd, CURL_CSELECT_OUT);
+            if (!socket->removed)
+            {
+                wait_for(socket, fd);
+            }
+        });
+    }
+}
+
+void EchoPage::socket_action(curl_socket_t fd, int events)
+{
+    curl_multi_socket_action(multi, fd, events, &running);
+    check_done();
+}
+
+void EchoPage::check_done()
+{
+    int queued = 0;
+    while (CURLMsg* message = curl_multi_info_read(multi, &queued))
+    {
+        if (message->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+        CURL* easy = message->easy_handle;
+        auto result = message->data.result;
+        curl_multi_remove_handle(multi, easy);
+
+        auto it = transfers.find(easy);
+        if (it == transfers.end())
+        {
+            continue;
+        }
+        auto transfer = std::move(it->second);
+        transfers.erase(it);
+
+        // a write error is ours when the slice was already in
+        if (result != CURLE_OK && !(result == CURLE_WRITE_ERROR && transfer->stopped))
+        {
+            transfer->on_done(Page{ 0, std::string("Error: ") + curl_easy_strerror(result) });
+        }
+        else
+        {
+            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->page.status);
+            // a document that ended before its extractor was done, a 304 has none
+            if (transfer->json && !transfer->stopped && transfer->page.status != 304)
+            {
+                finish_json(*transfer, transfer->json->finish());
+            }
+            transfer->on_done(std::move(transfer->page));
+        }
+    }
 }
 
 }
\ No newline at end of file
@@ -1,41 +1,121 @@
 #ifndef ECHOPAGE_HPP_
 #define ECHOPAGE_HPP_
 
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+
 #include <curl/curl.h>
-#include <mutex>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 
+#include "jsonextract.hpp"
+
 namespace Hemirt::Utility
 {
-    
+
+// fetches pages without blocking: one curl multi handle whose sockets and timeout are waited on by the io_context,
+// so any number of fetches are in flight at once and connections are kept alive between them
 class EchoPage
 {
 public:
-    static EchoPage& get_instance()
+    // io thread, the body or an "Error: ..." text
+    using Handler = std::function<void(std::string page)>;
+    struct Page
     {
-        static EchoPage instance;
-        return instance;
-    }
-    
-    std::string echo_page(const std::string& page);
-   
-private:
-    EchoPage();
+        // 0 when the transfer failed, body then holds the "Error: ..." text
+        long status = 0;
+        std::string body{};
+        std::string etag{};
+        std::string last_modified{};
+        // false when the body was cut at Slice::max_bytes
+        bool complete = true;
+    };
+    // how much of a body is kept, the transfer is aborted as soon as it is in
+    struct Slice
+    {
+        enum class Lines : std::uint8_t
+        {
+            Keep,
+            // up to the first line break
+            First,
+            // line breaks become spaces
+            Join,
+        };
+        std::size_t max_bytes = std::numeric_limits<std::size_t>::max();
+        Lines lines = Lines::Keep;
+        // when set only this value of a JSON body is kept, see JsonExtractor::parse_path; lines is then ignored
+        std::string json_path;
+    };
+    using PageHandler = std::function<void(Page page)>;
+
+    EchoPage(boost::asio::io_context& io_context, long max_connections);
     ~EchoPage();
     EchoPage(const EchoPage&) = delete;
     EchoPage& operator=(const EchoPage&) = delete;
     EchoPage(EchoPage&&) = delete;
     EchoPage& operator=(EchoPage&&) = delete;
-    
-    std::mutex curl_mtx;
-    struct curl_slist *chunk;
-    CURL *curl;
-};
 
-}
+    // io thread
+    void echo_page(const std::string& page, Handler on_done);
+    // conditional when etag or last_modified is given, an unchanged page then comes back as 304 without a body
+    void fetch(const std::string& page, const std::string& etag, const std::string& last_modified, const Slice& slice, PageHandler on_done);
+    std::size_t in_flight() const;
 
+    // cuts text to at most max_bytes without splitting a utf-8 sequence
+    static void truncate(std::string& text, std::size_t max_bytes);
 
+    static constexpr long timeout_ms = 5000;
 
+private:
+    struct Socket
+    {
+        Socket(boost::asio::io_context& io_context, curl_socket_t fd);
+        ~Socket();
+        boost::asio::posix::stream_descriptor descriptor;
+        // CURL_POLL_* curl wants to hear about
+        int what = 0;
+        bool reading = false;
+        bool writing = false;
+        bool removed = false;
+    };
+    struct Transfer
+    {
+        std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> handle{ nullptr, &curl_easy_cleanup };
+        // Accept and the conditional headers, null for the shared chunk
+        std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> headers{ nullptr, &curl_slist_free_all };
+        Page page;
+        Slice slice;
+        std::optional<JsonExtractor> json;
+        // the write callback aborted the transfer once the slice was in
+        bool stopped = false;
+        PageHandler on_done;
+    };
+    static std::size_t write_callback(char* data, std::size_t size, std::size_t count, void* userp);
+    // the body of a JSON transfer once its extractor is done
+    static void finish_json(Transfer& transfer, JsonExtractor::Result result);
+
+    static int socket_callback(CURL* easy, curl_socket_t fd, int what, void* userp, void* socketp);
+    static int timer_callback(CURLM* multi, long timeout_ms, void* userp);
+    void wait_for(const std::shared_ptr<Socket>& socket, curl_socket_t fd);
+    void socket_action(curl_socket_t fd, int events);
+    // hands finished transfers to their handlers
+    void check_done();
 
+    boost::asio::io_context& io_context;
+    CURLM* multi = nullptr;
+    boost::asio::steady_timer timer;
+    std::map<curl_socket_t, std::shared_ptr<Socket>> sockets;
+    std::map<CURL*, std::unique_ptr<Transfer>> transfers;
+    int running = 0;
+    struct curl_slist *chunk = nullptr;
+};
+
+}
 
 #endif // ECHOPAGE_HPP_
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef HASHRING_HPP_
+#define HASHRING_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "perfecthash.hpp"
+
+// consistent hashing of keys onto nodes; every node owns virtual_nodes points on the ring, so a
+// joining or leaving node only moves about 1/n of the keys. The hash is the same in every build,
+// processes on different hosts agree on the owners
+class HashRing
+{
+public:
+    HashRing(const std::vector<std::string>& nodes, std::size_t virtual_nodes)
+    {
+        points.reserve(nodes.size() * virtual_nodes);
+        for (auto&& node : nodes)
+        {
+            for (std::size_t i = 0; i < virtual_nodes; ++i)
+            {
+                points.emplace_back(point(node + '#' + std::to_string(i)), node);
+            }
+        }
+        std::sort(points.begin(), points.end());
+    }
+
+    bool empty() const
+    {
+        return points.empty();
+    }
+
+    // first point clockwise from the key
+    const std::string& owner(std::string_view key) const
+    {
+        auto it = std::lower_bound(points.begin(), points.end(), point(key), [](auto&& p, std::uint64_t h) { return p.first < h; });
+        if (it == points.end())
+        {
+            it = points.begin();
+        }
+        return it->second;
+    }
+
+private:
+    std::vector<std::pair<std::uint64_t, std::string>> points;
+
+    static std::uint64_t point(std::string_view key)
+    {
+        return (static_cast<std::uint64_t>(PerfectHash::hash(key, 0x5eed1)) << 32) | PerfectHash::hash(key, 0x5eed2);
+    }
+};
+
+#endif // HASHRING_HPP_
\ No newline at end of file
@@ -1,18 +1,18 @@
 #include "ircclient.hpp"
 
-#include <iostream>
 #include <exception>
 #include <istream>
 #include <memory>
 
-#include "ircmessage.hpp"
+#include "logger.hpp"
 
-IrcClient::IrcClient(boost::asio::io_context& io_context, const IrcAuthSequence& auth, IrcMessageHandler ircmessage_handler)
+IrcClient::IrcClient(boost::asio::io_context& io_context, const IrcAuthSequence& auth, const Server& server, IrcLineHandler line_handler)
     : io_context(io_context)
     , socket(io_context)
     , resolver(io_context)
     , auth(auth)
-    , ircmessage_handler(ircmessage_handler)
+    , server(server)
+    , line_handler(line_handler)
 {
     add_auth_messages_to_queue();
     connect();
@@ -27,7 +27,7 @@ void IrcClient::connect(int attempt)
         on_host_resolve(error, results, attempt);
     };
 
-    resolver.async_resolve("irc.chat.twitch.tv", "6667", handler);
+    resolver.async_resolve(server.host, server.port, handler);
 }
 
 void IrcClient::on_host_resolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type results, int attempt)
@@ -97,7 +97,7 @@ void IrcClient::report_error(const std::string& message)
 {
     if (!quit_in_progress)
     {
-        std::cerr << message << std::endl;
+        log_error(LogCategory::Irc, message);
         throw std::runtime_error(message);
     }
 }
@@ -222,7 +222,7 @@ void IrcClient::handle_read(const boost::system::error_code& error, std::size_t
     // remove \r 
     line.pop_back();
 
-    ircmessage_handler(IrcMessage(std::move(line)));
+    line_handler(std::move(line));
 
     start_read();
 }
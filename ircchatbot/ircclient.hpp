@@ -4,17 +4,23 @@
 #include <boost/asio.hpp>
 
 #include <cstddef>
+#include <functional>
 #include <string>
 #include <queue>
 
 #include "ircauthsequence.hpp"
-#include "ircmessage.hpp"
 
 class IrcClient
 {
 public:
-    using IrcMessageHandler = std::function<void(IrcMessage&&)>;
-    IrcClient(boost::asio::io_context& io_context, const IrcAuthSequence& auth, IrcMessageHandler ircmessage_handler);
+    // receives every line without its \r\n, parsing is left to the handler
+    using IrcLineHandler = std::function<void(std::string&&)>;
+    struct Server
+    {
+        std::string host = "irc.chat.twitch.tv";
+        std::string port = "6667";
+    };
+    IrcClient(boost::asio::io_context& io_context, const IrcAuthSequence& auth, const Server& server, IrcLineHandler line_handler);
 
     void send_command(const std::string& command);
     void send_command(std::string&& command);
@@ -26,6 +32,9 @@ public:
 
     void quit();
 
+    // longer commands are cut, \r\n not included
+    static constexpr std::size_t max_irc_command_length = 510;
+
 private:
     void connect(int attempt = 0);
     void on_host_resolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::results_type results, int attempt);
@@ -44,6 +53,7 @@ private:
     void handle_read(const boost::system::error_code& error, std::size_t bytes_transferred);
 
     IrcAuthSequence auth;
+    Server server;
 
     boost::asio::io_context& io_context;
     boost::asio::ip::tcp::socket socket;
@@ -53,9 +63,7 @@ private:
     std::queue<std::string> raw_messages;
     boost::asio::streambuf read_buffer;
 
-    IrcMessageHandler ircmessage_handler;
-
-    static constexpr std::size_t max_irc_command_length = 510;
+    IrcLineHandler line_handler;
 
     bool quit_in_progress = false;
 };
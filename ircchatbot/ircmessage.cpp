@@ -1,11 +1,12 @@
 #include "ircmessage.hpp"
 
 #include <exception>
-#include <iostream>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include "logger.hpp"
+
 IrcMessage::IrcMessage(const std::string& line)
     : original_line(line)
 {
@@ -18,6 +19,31 @@ IrcMessage::IrcMessage(std::string&& line)
     parse(original_line);
 }
 
+std::string_view IrcMessage::peek_privmsg_channel(std::string_view line)
+{
+    // skip tags and prefix, same layout as parse()
+    for (char marker : { '@', ':' })
+    {
+        if (line.starts_with(marker))
+        {
+            auto pos = line.find(' ');
+            if (pos == std::string_view::npos)
+            {
+                return {};
+            }
+            line.remove_prefix(pos + 1);
+        }
+    }
+
+    constexpr std::string_view privmsg = "PRIVMSG #";
+    if (!line.starts_with(privmsg))
+    {
+        return {};
+    }
+    line.remove_prefix(privmsg.size());
+    return line.substr(0, line.find(' '));
+}
+
 void IrcMessage::parse(std::string_view line)
 {
     /*
@@ -114,17 +140,28 @@ void IrcMessage::parse_tags(std::string_view tags_line)
     }
 }
 
+IrcMessage::Type IrcMessage::type_from_command(std::string_view command)
+{
+    if (command == "CLEARCHAT") return Type::CLEARCHAT;
+    else if (command == "CLEARMSG") return Type::CLEARMSG;
+    else if (command == "GLOBALUSERSTATE") return Type::GLOBALUSERSTATE;
+    else if (command == "PRIVMSG") return Type::PRIVMSG;
+    else if (command == "ROOMSTATE") return Type::ROOMSTATE;
+    else if (command == "USERNOTICE") return Type::USERNOTICE;
+    else if (command == "USERSTATE") return Type::USERSTATE;
+    else if (command == "PING") return Type::PING;
+    return Type::UNKNOWN;
+}
+
 void IrcMessage::parse_command()
 {
-    if (command == "CLEARMSG") type = Type::CLEARMSG;
-    else if (command == "GLOBALUSERSTATE") type = Type::GLOBALUSERSTATE;
-    else if (command == "PRIVMSG")
+    type = type_from_command(command);
+    if (type == Type::PRIVMSG)
     {
-        type = Type::PRIVMSG;
         auto pos = prefix.find('!');
         if (params.size() < 2 || params[0].size() < 2 || pos == std::string_view::npos) {
             std::string msg = "Error parsing PRIVMSG: " + original_line;
-            std::cerr << msg << std::endl;
+            log_error(LogCategory::Irc, msg);
             throw std::runtime_error(msg);
         }
         channel = params[0].substr(1);
@@ -134,8 +171,26 @@ void IrcMessage::parse_command()
         display_name = tags["display-name"].value();
         message_id = tags["id"].value();
     }
-    else if (command == "ROOMSTATE") type = Type::ROOMSTATE;
-    else if (command == "USERNOTICE") type = Type::USERNOTICE;
-    else if (command == "USERSTATE") type = Type::USERSTATE;
-    else if (command == "PING") type = Type::PING;
+    else if (type == Type::CLEARMSG || type == Type::CLEARCHAT)
+    {
+        if (params.empty() || params[0].size() < 2)
+        {
+            std::string msg = "Error parsing " + std::string(command) + ": " + original_line;
+            log_error(LogCategory::Irc, msg);
+            throw std::runtime_error(msg);
+        }
+        channel = params[0].substr(1);
+        if (type == Type::CLEARMSG)
+        {
+            // the deleted message, not this one
+            message_id = tags["target-msg-id"].value();
+            user = tags["login"].value();
+        }
+        else if (params.size() > 1)
+        {
+            // without a user the whole chat was cleared
+            user = params[1];
+            user_id = tags["target-user-id"].value();
+        }
+    }
 }
\ No newline at end of file
@@ -15,9 +15,13 @@ public:
     IrcMessage(const std::string& line);
     IrcMessage(std::string&& line);
 
+    // channel of a PRIVMSG line without parsing the rest of it, empty for other commands
+    static std::string_view peek_privmsg_channel(std::string_view line);
+
     enum class Type
     {
         UNKNOWN,
+        CLEARCHAT,
         CLEARMSG,
         GLOBALUSERSTATE,
         PRIVMSG,
@@ -27,6 +31,8 @@ public:
         PING
     };
 
+    static Type type_from_command(std::string_view command);
+
     struct Tag
     {
         Tag()
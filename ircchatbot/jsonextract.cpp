@@ -0,0 +1,614 @@
+#include "jsonextract.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // the next " or \ of a string
+    const char* find_string_special(const char* p, const char* end)
+    {
+#if defined(__SSE2__)
+        auto quotes = _mm_set1_epi8('"');
+        auto backslashes = _mm_set1_epi8('\\');
+        for (; end - p >= 16; p += 16)
+        {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quotes), _mm_cmpeq_epi8(v, backslashes))));
+            if (mask != 0)
+            {
+                return p + std::countr_zero(mask);
+            }
+        }
+#endif
+        while (p < end && *p != '"' && *p != '\\')
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    // the next " { } [ ] outside a string; setting bit 5 folds [ into { and ] into }
+    const char* find_structural(const char* p, const char* end)
+    {
+#if defined(__SSE2__)
+        auto quotes = _mm_set1_epi8('"');
+        auto opens = _mm_set1_epi8('{');
+        auto closes = _mm_set1_epi8('}');
+        auto bit5 = _mm_set1_epi8(0x20);
+        for (; end - p >= 16; p += 16)
+        {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto folded = _mm_or_si128(v, bit5);
+            auto hits = _mm_or_si128(_mm_cmpeq_epi8(v, quotes), _mm_or_si128(_mm_cmpeq_epi8(folded, opens), _mm_cmpeq_epi8(folded, closes)));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                return p + std::countr_zero(mask);
+            }
+        }
+#endif
+        while (p < end && *p != '"' && (*p | 0x20) != '{' && (*p | 0x20) != '}')
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    bool is_whitespace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    // ends a number or literal
+    bool is_delimiter(char c)
+    {
+        return c == ',' || c == '}' || c == ']' || is_whitespace(c);
+    }
+
+    const char* skip_whitespace(const char* p, const char* end)
+    {
+        while (p < end && is_whitespace(*p))
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    int hex_digit(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+        {
+            return (c | 0x20) - 'a' + 10;
+        }
+        return -1;
+    }
+
+    void append_capped(std::string& out, std::string_view text, std::size_t cap)
+    {
+        if (out.size() < cap)
+        {
+            out.append(text.substr(0, cap - out.size()));
+        }
+    }
+}
+
+std::optional<std::vector<JsonExtractor::Step>> JsonExtractor::parse_path(std::string_view path)
+{
+    while (!path.empty() && path.front() == ' ')
+    {
+        path.remove_prefix(1);
+    }
+    while (!path.empty() && path.back() == ' ')
+    {
+        path.remove_suffix(1);
+    }
+
+    std::vector<Step> steps;
+    // a bare first name reads as if it followed $.
+    bool name_expected = true;
+    if (path.starts_with('$'))
+    {
+        path.remove_prefix(1);
+        name_expected = false;
+    }
+    else if (path.starts_with('.') || path.starts_with('['))
+    {
+        name_expected = false;
+    }
+
+    while (!path.empty())
+    {
+        if (name_expected || path.front() == '.')
+        {
+            if (!name_expected)
+            {
+                path.remove_prefix(1);
+            }
+            name_expected = false;
+            auto length = std::min(path.find_first_of(".["), path.size());
+            if (length == 0)
+            {
+                return std::nullopt;
+            }
+            steps.push_back(Step{ std::string(path.substr(0, length)) });
+            path.remove_prefix(length);
+        }
+        else if (path.front() == '[')
+        {
+            path.remove_prefix(1);
+            if (path.starts_with('"') || path.starts_with('\''))
+            {
+                auto close = path.find(path.front(), 1);
+                if (close == std::string_view::npos || close + 1 >= path.size() || path[close + 1] != ']')
+                {
+                    return std::nullopt;
+                }
+                steps.push_back(Step{ std::string(path.substr(1, close - 1)) });
+                path.remove_prefix(close + 2);
+            }
+            else
+            {
+                Step step;
+                step.is_index = true;
+                auto [end, error] = std::from_chars(path.data(), path.data() + path.size(), step.index);
+                if (error != std::errc() || end == path.data() + path.size() || *end != ']')
+                {
+                    return std::nullopt;
+                }
+                steps.push_back(std::move(step));
+                path.remove_prefix(static_cast<std::size_t>(end - path.data()) + 1);
+            }
+        }
+        else
+        {
+            return std::nullopt;
+        }
+    }
+    return steps;
+}
+
+JsonExtractor::JsonExtractor(std::vector<Step> path, std::size_t max_bytes)
+    : path(std::move(path))
+    , max_bytes(max_bytes)
+{
+}
+
+JsonExtractor::Result JsonExtractor::found()
+{
+    result = Result::Found;
+    return result;
+}
+
+void JsonExtractor::append_code_point(std::uint32_t code_point, std::string& out, std::size_t cap)
+{
+    char buffer[4];
+    std::size_t length = 0;
+    if (code_point < 0x80)
+    {
+        buffer[length++] = static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800)
+    {
+        buffer[length++] = static_cast<char>(0xC0 | (code_point >> 6));
+        buffer[length++] = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        buffer[length++] = static_cast<char>(0xE0 | (code_point >> 12));
+        buffer[length++] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        buffer[length++] = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        buffer[length++] = static_cast<char>(0xF0 | (code_point >> 18));
+        buffer[length++] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        buffer[length++] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        buffer[length++] = static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    append_capped(out, std::string_view(buffer, length), cap);
+}
+
+bool JsonExtractor::decode_string(const char*& p, const char* end, std::string& out, std::size_t cap)
+{
+    // a high surrogate not followed by its low half
+    auto flush_surrogate = [&]
+    {
+        if (high_surrogate != 0)
+        {
+            append_code_point(0xFFFD, out, cap);
+            high_surrogate = 0;
+        }
+    };
+
+    while (p < end)
+    {
+        if (unicode_digits > 0)
+        {
+            auto digit = hex_digit(*p++);
+            if (digit < 0)
+            {
+                result = Result::Invalid;
+                return false;
+            }
+            unicode_value = unicode_value * 16 + static_cast<std::uint32_t>(digit);
+            if (--unicode_digits > 0)
+            {
+                continue;
+            }
+            if (unicode_value >= 0xD800 && unicode_value < 0xDC00)
+            {
+                flush_surrogate();
+                high_surrogate = unicode_value;
+            }
+            else if (unicode_value >= 0xDC00 && unicode_value < 0xE000)
+            {
+                if (high_surrogate != 0)
+                {
+                    append_code_point(0x10000 + ((high_surrogate - 0xD800) << 10) + (unicode_value - 0xDC00), out, cap);
+                    high_surrogate = 0;
+                }
+                else
+                {
+                    append_code_point(0xFFFD, out, cap);
+                }
+            }
+            else
+            {
+                flush_surrogate();
+                append_code_point(unicode_value, out, cap);
+            }
+            continue;
+        }
+
+        if (escape)
+        {
+            escape = false;
+            auto c = *p++;
+            if (c == 'u')
+            {
+                unicode_digits = 4;
+                unicode_value = 0;
+                continue;
+            }
+            flush_surrogate();
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            default:
+                result = Result::Invalid;
+                return false;
+            }
+            append_capped(out, std::string_view(&c, 1), cap);
+            continue;
+        }
+
+        auto special = find_string_special(p, end);
+        if (special != p)
+        {
+            flush_surrogate();
+            append_capped(out, std::string_view(p, static_cast<std::size_t>(special - p)), cap);
+            p = special;
+        }
+        if (p == end)
+        {
+            return false;
+        }
+        ++p;
+        if (p[-1] == '"')
+        {
+            flush_surrogate();
+            return true;
+        }
+        escape = true;
+    }
+    return false;
+}
+
+JsonExtractor::Result JsonExtractor::feed(std::string_view chunk)
+{
+    auto p = chunk.data();
+    auto end = p + chunk.size();
+    while (result == Result::NeedMore && p < end)
+    {
+        switch (state)
+        {
+        case State::Value:
+        {
+            p = skip_whitespace(p, end);
+            if (p == end)
+            {
+                break;
+            }
+            auto c = *p;
+            // only an empty array on the path has its end where a value was due
+            if (c == ']')
+            {
+                result = Result::Missing;
+                break;
+            }
+            if (!target)
+            {
+                if (c == '"')
+                {
+                    ++p;
+                    state = State::SkipString;
+                }
+                else if (c == '{' || c == '[')
+                {
+                    ++p;
+                    nesting = 1;
+                    in_string = false;
+                    state = State::SkipContainer;
+                }
+                else
+                {
+                    state = State::SkipScalar;
+                }
+                break;
+            }
+            if (depth == path.size())
+            {
+                if (c == '"')
+                {
+                    ++p;
+                    state = State::CaptureString;
+                }
+                else if (c == '{' || c == '[')
+                {
+                    ++p;
+                    value += c;
+                    nesting = 1;
+                    in_string = false;
+                    state = State::CaptureContainer;
+                }
+                else
+                {
+                    state = State::CaptureScalar;
+                }
+                break;
+            }
+            // the next step needs a container of its kind here
+            auto&& step = path[depth];
+            if (c != (step.is_index ? '[' : '{'))
+            {
+                result = Result::Missing;
+                break;
+            }
+            ++p;
+            ++depth;
+            if (step.is_index)
+            {
+                array_index = 0;
+                target = step.index == 0;
+                state = State::Value;
+            }
+            else
+            {
+                state = State::MemberStart;
+            }
+            break;
+        }
+        case State::MemberStart:
+        {
+            p = skip_whitespace(p, end);
+            if (p == end)
+            {
+                break;
+            }
+            if (*p == '"')
+            {
+                ++p;
+                key.clear();
+                state = State::Key;
+            }
+            else
+            {
+                result = *p == '}' ? Result::Missing : Result::Invalid;
+            }
+            break;
+        }
+        case State::Key:
+            // a name longer than the step's never matches, so no more of it is kept
+            if (decode_string(p, end, key, path[depth - 1].key.size() + 1))
+            {
+                state = State::Colon;
+            }
+            break;
+        case State::Colon:
+        {
+            p = skip_whitespace(p, end);
+            if (p == end)
+            {
+                break;
+            }
+            if (*p++ != ':')
+            {
+                result = Result::Invalid;
+                break;
+            }
+            target = key == path[depth - 1].key;
+            state = State::Value;
+            break;
+        }
+        case State::Next:
+        {
+            p = skip_whitespace(p, end);
+            if (p == end)
+            {
+                break;
+            }
+            auto c = *p++;
+            if (c == ',')
+            {
+                auto&& step = path[depth - 1];
+                if (step.is_index)
+                {
+                    ++array_index;
+                    target = array_index == step.index;
+                    state = State::Value;
+                }
+                else
+                {
+                    state = State::MemberStart;
+                }
+            }
+            else
+            {
+                // the container on the path ended without the step
+                result = c == '}' || c == ']' ? Result::Missing : Result::Invalid;
+            }
+            break;
+        }
+        case State::SkipScalar:
+            while (p < end && !is_delimiter(*p))
+            {
+                ++p;
+            }
+            if (p < end)
+            {
+                state = State::Next;
+            }
+            break;
+        case State::SkipString:
+            if (escape)
+            {
+                escape = false;
+                ++p;
+                break;
+            }
+            p = find_string_special(p, end);
+            if (p == end)
+            {
+                break;
+            }
+            if (*p++ == '\\')
+            {
+                escape = true;
+            }
+            else
+            {
+                state = State::Next;
+            }
+            break;
+        case State::SkipContainer:
+        case State::CaptureContainer:
+        {
+            auto start = p;
+            if (escape)
+            {
+                escape = false;
+                ++p;
+            }
+            else if (in_string)
+            {
+                p = find_string_special(p, end);
+                if (p < end)
+                {
+                    if (*p++ == '\\')
+                    {
+                        escape = true;
+                    }
+                    else
+                    {
+                        in_string = false;
+                    }
+                }
+            }
+            else
+            {
+                p = find_structural(p, end);
+                if (p < end)
+                {
+                    auto c = *p++;
+                    if (c == '"')
+                    {
+                        in_string = true;
+                    }
+                    else if (c == '{' || c == '[')
+                    {
+                        ++nesting;
+                    }
+                    else if (--nesting == 0 && state == State::SkipContainer)
+                    {
+                        state = State::Next;
+                    }
+                }
+            }
+            if (state == State::CaptureContainer)
+            {
+                append_capped(value, std::string_view(start, static_cast<std::size_t>(p - start)), max_bytes);
+                if (nesting == 0 || value.size() >= max_bytes)
+                {
+                    found();
+                }
+            }
+            break;
+        }
+        case State::CaptureString:
+            if (decode_string(p, end, value, max_bytes) || (result == Result::NeedMore && value.size() >= max_bytes))
+            {
+                found();
+            }
+            break;
+        case State::CaptureScalar:
+        {
+            auto start = p;
+            while (p < end && !is_delimiter(*p))
+            {
+                ++p;
+            }
+            append_capped(value, std::string_view(start, static_cast<std::size_t>(p - start)), max_bytes);
+            if (p < end || value.size() >= max_bytes)
+            {
+                found();
+            }
+            break;
+        }
+        }
+    }
+    return result;
+}
+
+JsonExtractor::Result JsonExtractor::finish()
+{
+    if (result == Result::NeedMore)
+    {
+        // a document that is a single number or literal ends with it
+        result = state == State::CaptureScalar && !value.empty() ? Result::Found : Result::Invalid;
+    }
+    return result;
+}
+
+std::string JsonExtractor::take_value()
+{
+    std::replace_if(value.begin(), value.end(), [](char c) { return c == '\r' || c == '\n' || c == '\t'; }, ' ');
+    return std::move(value);
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef JSONEXTRACT_HPP_
+#define JSONEXTRACT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// pulls one value out of a JSON document as it streams in, without building a tree:
+// only the containers on the path are tokenized, everything else is skipped by scanning for
+// quotes and brackets 16 bytes at a time, and nothing after the value is ever looked at
+class JsonExtractor
+{
+public:
+    struct Step
+    {
+        // a member name, or an array index when is_index
+        std::string key;
+        std::size_t index = 0;
+        bool is_index = false;
+    };
+    // $.data[0].name, data[0].name or $["a.b"][2]; $ alone is the whole document
+    static std::optional<std::vector<Step>> parse_path(std::string_view path);
+
+    // values are cut at max_bytes
+    JsonExtractor(std::vector<Step> path, std::size_t max_bytes);
+
+    enum class Result : std::uint8_t
+    {
+        NeedMore,
+        Found,
+        Missing,
+        Invalid,
+    };
+    // resumes where the previous chunk stopped, once the result is not NeedMore it stays
+    Result feed(std::string_view chunk);
+    // the document ended
+    Result finish();
+    // strings unescaped, numbers, literals and containers as their JSON text; line breaks become spaces
+    std::string take_value();
+
+private:
+    enum class State : std::uint8_t
+    {
+        // a value of a container on the path, or the document itself
+        Value,
+        // after { or , of an object on the path
+        MemberStart,
+        Key,
+        Colon,
+        // after a value of a container on the path
+        Next,
+        SkipScalar,
+        SkipString,
+        SkipContainer,
+        CaptureString,
+        CaptureScalar,
+        CaptureContainer,
+    };
+
+    // consumes string bytes into out up to cap, true once the closing quote is consumed
+    bool decode_string(const char*& p, const char* end, std::string& out, std::size_t cap);
+    void append_code_point(std::uint32_t code_point, std::string& out, std::size_t cap);
+    Result found();
+
+    std::vector<Step> path;
+    std::size_t max_bytes;
+    Result result = Result::NeedMore;
+    State state = State::Value;
+
+    // containers of the path entered, the next step to match is path[depth - 1]
+    std::size_t depth = 0;
+    // the value at hand is the next step, or the document itself
+    bool target = true;
+    std::size_t array_index = 0;
+    std::string key;
+
+    // skipped or captured containers
+    std::size_t nesting = 0;
+    bool in_string = false;
+    bool escape = false;
+    // \u escapes
+    int unicode_digits = 0;
+    std::uint32_t unicode_value = 0;
+    std::uint32_t high_surrogate = 0;
+
+    std::string value;
+};
+
+#endif // JSONEXTRACT_HPP_
\ No newline at end of file
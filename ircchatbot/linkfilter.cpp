@@ -0,0 +1,325 @@
+#include "linkfilter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // generic tlds common in chat, sorted for binary search; country codes are in country_tlds
+    constexpr std::array<std::string_view, 96> generic_tlds{
+        "adult", "aero", "agency", "app", "art", "asia", "bet", "bid", "biz", "blog",
+        "blue", "cam", "cash", "casino", "cat", "chat", "click", "cloud", "club", "codes",
+        "com", "company", "coop", "design", "dev", "digital", "edu", "email", "finance", "free",
+        "fun", "game", "games", "gift", "global", "gold", "gov", "host", "icu", "inc",
+        "info", "int", "jobs", "link", "live", "loan", "lol", "ltd", "media", "mil",
+        "mobi", "moe", "money", "museum", "name", "net", "network", "news", "ninja", "one",
+        "onion", "online", "org", "page", "pink", "poker", "porn", "press", "pro", "red",
+        "rocks", "run", "sex", "shop", "site", "social", "space", "store", "stream", "studio",
+        "team", "tech", "tel", "today", "top", "travel", "vip", "website", "wiki", "win",
+        "work", "world", "wtf", "xxx", "xyz", "zone",
+    };
+    static_assert(std::ranges::is_sorted(generic_tlds));
+
+    // one bit per second letter for every first letter
+    constexpr std::array<std::uint32_t, 26> country_tlds = []
+    {
+        constexpr std::string_view codes =
+            "ac ad ae af ag ai al am ao aq ar as at au aw ax az ba bb bd be bf bg bh bi bj bm bn bo br bs bt bw by bz "
+            "ca cc cd cf cg ch ci ck cl cm cn co cr cu cv cw cx cy cz de dj dk dm do dz ec ee eg er es et eu "
+            "fi fj fk fm fo fr ga gd ge gf gg gh gi gl gm gn gp gq gr gs gt gu gw gy hk hm hn hr ht hu "
+            "id ie il im in io iq ir is it je jm jo jp ke kg kh ki km kn kp kr kw ky kz la lb lc li lk lr ls lt lu lv ly "
+            "ma mc md me mg mh mk ml mm mn mo mp mq mr ms mt mu mv mw mx my mz na nc ne nf ng ni nl no np nr nu nz om "
+            "pa pe pf pg ph pk pl pm pn pr ps pt pw py qa re ro rs ru rw sa sb sc sd se sg sh si sk sl sm sn so sr ss st su sv sx sy sz "
+            "tc td tf tg th tj tk tl tm tn to tr tt tv tw tz ua ug uk us uy uz va vc ve vg vi vn vu wf ws ye yt za zm zw";
+        std::array<std::uint32_t, 26> table{};
+        for (std::size_t i = 0; i + 1 < codes.size(); i += 3)
+        {
+            table[codes[i] - 'a'] |= 1u << (codes[i + 1] - 'a');
+        }
+        return table;
+    }();
+
+    bool is_host_char(unsigned char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.';
+    }
+
+    char to_lower(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    // dotted labels of up to 63 characters ending in a tld, or four numbers of an ipv4 address
+    bool looks_like_host(std::string_view host)
+    {
+        std::size_t labels = 0;
+        std::size_t numeric = 0;
+        std::string_view last;
+        std::size_t begin = 0;
+        while (begin <= host.size())
+        {
+            auto dot = host.find('.', begin);
+            auto label = host.substr(begin, dot == std::string_view::npos ? std::string_view::npos : dot - begin);
+            if (label.empty() || label.size() > 63)
+            {
+                return false;
+            }
+            ++labels;
+            if (label.size() <= 3 && label.find_first_not_of("0123456789") == std::string_view::npos && std::stoi(std::string(label)) <= 255)
+            {
+                ++numeric;
+            }
+            last = label;
+            if (dot == std::string_view::npos)
+            {
+                break;
+            }
+            begin = dot + 1;
+        }
+        if (labels < 2)
+        {
+            return false;
+        }
+        if (labels == 4 && numeric == 4)
+        {
+            return true;
+        }
+
+        std::string tld(last);
+        for (auto&& c : tld)
+        {
+            c = to_lower(c);
+        }
+        return LinkDetector::is_tld(tld);
+    }
+}
+
+bool LinkDetector::is_tld(std::string_view label)
+{
+    if (label.size() == 2)
+    {
+        return label[0] >= 'a' && label[0] <= 'z' && label[1] >= 'a' && label[1] <= 'z'
+            && (country_tlds[label[0] - 'a'] >> (label[1] - 'a') & 1) != 0;
+    }
+    return std::ranges::binary_search(generic_tlds, label);
+}
+
+void LinkDetector::find_hosts(std::string_view message, std::vector<std::string>& hosts)
+{
+    auto data = reinterpret_cast<const unsigned char*>(message.data());
+    auto size = message.size();
+    // end of the last host, dots before it were part of that host
+    std::size_t covered = 0;
+
+    auto push = [&](std::size_t begin, std::size_t end, bool known_host)
+    {
+        while (begin < end && (data[begin] == '.' || data[begin] == '-'))
+        {
+            ++begin;
+        }
+        while (end > begin && (data[end - 1] == '.' || data[end - 1] == '-'))
+        {
+            --end;
+        }
+        auto host = message.substr(begin, end - begin);
+        if (host.empty() || (!known_host && !looks_like_host(host)))
+        {
+            return;
+        }
+        auto&& lowered = hosts.emplace_back(host);
+        for (auto&& c : lowered)
+        {
+            c = to_lower(c);
+        }
+    };
+
+    // every . and : is a candidate, a host is extended to both sides from its first dot
+    auto candidate = [&](std::size_t i)
+    {
+        if (i < covered)
+        {
+            return;
+        }
+        if (data[i] == ':')
+        {
+            if (i + 2 < size && data[i + 1] == '/' && data[i + 2] == '/')
+            {
+                auto end = i + 3;
+                while (end < size && is_host_char(data[end]))
+                {
+                    ++end;
+                }
+                push(i + 3, end, true);
+                covered = end;
+            }
+            return;
+        }
+
+        auto begin = i;
+        while (begin > covered && is_host_char(data[begin - 1]))
+        {
+            --begin;
+        }
+        auto end = i + 1;
+        while (end < size && is_host_char(data[end]))
+        {
+            ++end;
+        }
+        push(begin, end, false);
+        covered = end;
+    };
+
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    auto dots = _mm_set1_epi8('.');
+    auto colons = _mm_set1_epi8(':');
+    for (; i + 16 <= size; i += 16)
+    {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, dots), _mm_cmpeq_epi8(v, colons))));
+        for (; mask != 0; mask &= mask - 1)
+        {
+            candidate(i + static_cast<std::size_t>(std::countr_zero(mask)));
+        }
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+        if (data[i] == '.' || data[i] == ':')
+        {
+            candidate(i);
+        }
+    }
+}
+
+std::string DomainTrie::normalize(std::string_view domain)
+{
+    if (domain.starts_with("*."))
+    {
+        domain.remove_prefix(2);
+    }
+    while (domain.ends_with('.'))
+    {
+        domain.remove_suffix(1);
+    }
+    std::string normalized(domain);
+    for (auto&& c : normalized)
+    {
+        c = to_lower(c);
+    }
+    return normalized;
+}
+
+void DomainTrie::insert(std::string_view domain)
+{
+    if (domain.empty())
+    {
+        return;
+    }
+
+    // labels from the tld down
+    std::size_t node = 0;
+    std::size_t end = domain.size();
+    while (true)
+    {
+        auto dot = end == 0 ? std::string_view::npos : domain.rfind('.', end - 1);
+        auto begin = dot == std::string_view::npos ? 0 : dot + 1;
+        auto label = domain.substr(begin, end - begin);
+        auto child = nodes[node].children.find(label);
+        if (child == nodes[node].children.end())
+        {
+            auto index = nodes.size();
+            nodes[node].children.emplace(label, index);
+            nodes.emplace_back();
+            node = index;
+        }
+        else
+        {
+            node = child->second;
+        }
+        if (dot == std::string_view::npos)
+        {
+            break;
+        }
+        end = dot;
+    }
+
+    if (!nodes[node].allowed)
+    {
+        nodes[node].allowed = true;
+        ++allowed_count;
+    }
+}
+
+void DomainTrie::erase(std::string_view domain)
+{
+    std::size_t node = 0;
+    std::size_t end = domain.size();
+    while (!domain.empty())
+    {
+        auto dot = end == 0 ? std::string_view::npos : domain.rfind('.', end - 1);
+        auto begin = dot == std::string_view::npos ? 0 : dot + 1;
+        auto child = nodes[node].children.find(domain.substr(begin, end - begin));
+        if (child == nodes[node].children.end())
+        {
+            return;
+        }
+        node = child->second;
+        if (dot == std::string_view::npos)
+        {
+            break;
+        }
+        end = dot;
+    }
+
+    if (node != 0 && nodes[node].allowed)
+    {
+        nodes[node].allowed = false;
+        --allowed_count;
+    }
+}
+
+bool DomainTrie::contains(std::string_view host) const
+{
+    std::size_t node = 0;
+    std::size_t end = host.size();
+    while (!host.empty())
+    {
+        auto dot = end == 0 ? std::string_view::npos : host.rfind('.', end - 1);
+        auto begin = dot == std::string_view::npos ? 0 : dot + 1;
+        auto child = nodes[node].children.find(host.substr(begin, end - begin));
+        if (child == nodes[node].children.end())
+        {
+            return false;
+        }
+        node = child->second;
+        // stops at the first allowed parent, sub.example.com is allowed by example.com
+        if (nodes[node].allowed)
+        {
+            return true;
+        }
+        if (dot == std::string_view::npos)
+        {
+            break;
+        }
+        end = dot;
+    }
+    return false;
+}
+
+bool DomainTrie::empty() const
+{
+    return allowed_count == 0;
+}
+
+std::size_t DomainTrie::size() const
+{
+    return allowed_count;
+}
\ No newline at end of file
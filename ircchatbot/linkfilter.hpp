@@ -0,0 +1,52 @@
+#ifndef LINKFILTER_HPP_
+#define LINKFILTER_HPP_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// hosts of the links in a chat message, found in one pass
+class LinkDetector
+{
+public:
+    // lowercased hosts in message order: anything after ://, dotted names ending in a known tld and ipv4 addresses
+    static void find_hosts(std::string_view message, std::vector<std::string>& hosts);
+    // tld without the dot, lowercase
+    static bool is_tld(std::string_view label);
+};
+
+// allowed domains stored by reversed labels, a domain also allows every subdomain of it
+class DomainTrie
+{
+public:
+    void insert(std::string_view domain);
+    void erase(std::string_view domain);
+    // lowercase host
+    bool contains(std::string_view host) const;
+    bool empty() const;
+    std::size_t size() const;
+
+    // lowercase, without a leading *. or a trailing dot
+    static std::string normalize(std::string_view domain);
+
+private:
+    struct Node
+    {
+        std::map<std::string, std::size_t, std::less<>> children;
+        bool allowed = false;
+    };
+    // nodes[0] is the root, erased domains only clear their flag
+    std::vector<Node> nodes{ 1 };
+    std::size_t allowed_count = 0;
+};
+
+struct LinkRule
+{
+    // seconds, -1 for a ban, 0 keeps the allowed domains without checking links
+    int timeout = 0;
+    DomainTrie allowed_domains;
+};
+
+#endif // LINKFILTER_HPP_
\ No newline at end of file
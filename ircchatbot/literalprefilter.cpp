@@ -0,0 +1,478 @@
+#include "literalprefilter.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <map>
+#include <queue>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // skips a group or class starting at pos, false when it does not end
+    bool skip_bracketed(std::string_view pattern, std::size_t& pos)
+    {
+        int depth = 0;
+        bool in_class = false;
+        while (pos < pattern.size())
+        {
+            char c = pattern[pos++];
+            if (c == '\\')
+            {
+                ++pos;
+            }
+            else if (in_class)
+            {
+                // [:alpha:], [.x.] and [=x=] are single members that bring a ] of their own
+                if (c == '[' && pos < pattern.size() && std::string_view(":.=").find(pattern[pos]) != std::string_view::npos)
+                {
+                    auto close = pattern.find(std::string{ pattern[pos], ']' }, pos + 1);
+                    if (close == std::string_view::npos)
+                    {
+                        return false;
+                    }
+                    pos = close + 2;
+                }
+                else if (c == ']')
+                {
+                    in_class = false;
+                }
+            }
+            else if (c == '[')
+            {
+                in_class = true;
+                // ] right after [ or [^ is a member
+                if (pos < pattern.size() && pattern[pos] == '^')
+                {
+                    ++pos;
+                }
+                if (pos < pattern.size() && pattern[pos] == ']')
+                {
+                    ++pos;
+                }
+            }
+            else if (c == '(')
+            {
+                ++depth;
+            }
+            else if (c == ')' && --depth == 0)
+            {
+                return true;
+            }
+
+            if (depth == 0 && !in_class)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parse_bound_min(std::string_view pattern, std::size_t& pos, int& min)
+    {
+        // after the {
+        auto start = pos;
+        min = 0;
+        while (pos < pattern.size() && pattern[pos] >= '0' && pattern[pos] <= '9')
+        {
+            min = std::min(min * 10 + (pattern[pos] - '0'), 100000);
+            ++pos;
+        }
+        if (pos == start)
+        {
+            return false;
+        }
+        auto end = pattern.find('}', pos);
+        if (end == std::string_view::npos)
+        {
+            return false;
+        }
+        for (auto i = pos; i < end; ++i)
+        {
+            if (pattern[i] != ',' && (pattern[i] < '0' || pattern[i] > '9'))
+            {
+                return false;
+            }
+        }
+        pos = end + 1;
+        return true;
+    }
+}
+
+std::string LiteralPrefilter::required_literal(std::string_view pattern)
+{
+    // quoting changes what every following character means, not worth modelling
+    if (pattern.find("\\Q") != std::string_view::npos)
+    {
+        return {};
+    }
+
+    std::string best;
+    std::string run;
+    auto end_run = [&]
+    {
+        if (run.size() > best.size())
+        {
+            best = run;
+        }
+        run.clear();
+    };
+
+    std::size_t pos = 0;
+    while (pos < pattern.size())
+    {
+        char c = pattern[pos];
+        // whether the atom just read added a byte to run
+        bool literal = false;
+        switch (c)
+        {
+        case '|':
+            // a top level alternative needs none of the others' literals
+            return {};
+        case ')':
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            return {};
+        case '(':
+            // inline flags like (?i) change the rest of the pattern
+            if (pos + 2 < pattern.size() && pattern[pos + 1] == '?' && (std::isalpha(static_cast<unsigned char>(pattern[pos + 2])) || pattern[pos + 2] == '-' || pattern[pos + 2] == '^'))
+            {
+                return {};
+            }
+            [[fallthrough]];
+        case '[':
+            if (!skip_bracketed(pattern, pos))
+            {
+                return {};
+            }
+            end_run();
+            break;
+        case '.':
+        case '^':
+        case '$':
+            ++pos;
+            end_run();
+            break;
+        case '\\':
+        {
+            if (pos + 1 >= pattern.size())
+            {
+                return {};
+            }
+            char e = pattern[pos + 1];
+            pos += 2;
+            if (std::string_view("<>`'").find(e) != std::string_view::npos)
+            {
+                // word and buffer boundaries in boost's perl syntax, zero width like \b
+                end_run();
+            }
+            else if (!std::isalnum(static_cast<unsigned char>(e)))
+            {
+                run += e;
+                literal = true;
+            }
+            else if (std::string_view("tnrfae").find(e) != std::string_view::npos)
+            {
+                constexpr std::string_view letters = "tnrfae";
+                constexpr std::string_view bytes = "\t\n\r\f\a\x1b";
+                run += bytes[letters.find(e)];
+                literal = true;
+            }
+            else if (e == 'x' && pos + 1 < pattern.size() && std::isxdigit(static_cast<unsigned char>(pattern[pos])) && std::isxdigit(static_cast<unsigned char>(pattern[pos + 1])))
+            {
+                run += static_cast<char>(std::stoi(std::string(pattern.substr(pos, 2)), nullptr, 16));
+                pos += 2;
+                literal = true;
+            }
+            else if (std::string_view("dDwWsSbBAzZG").find(e) != std::string_view::npos)
+            {
+                end_run();
+            }
+            else
+            {
+                // backreferences, octal, \p{..}, \k<..> and the like
+                return {};
+            }
+            break;
+        }
+        default:
+            run += c;
+            ++pos;
+            literal = true;
+            break;
+        }
+
+        if (pos >= pattern.size())
+        {
+            break;
+        }
+        // a quantified atom is optional or repeated, the run cannot continue past it
+        c = pattern[pos];
+        int min = 1;
+        if (c == '*' || c == '?')
+        {
+            ++pos;
+            min = 0;
+        }
+        else if (c == '+')
+        {
+            ++pos;
+        }
+        else if (c == '{')
+        {
+            ++pos;
+            if (!parse_bound_min(pattern, pos, min))
+            {
+                return {};
+            }
+        }
+        else
+        {
+            continue;
+        }
+        if (pos < pattern.size() && (pattern[pos] == '?' || pattern[pos] == '+'))
+        {
+            ++pos;
+        }
+        if (pos < pattern.size() && std::string_view("*+?{").find(pattern[pos]) != std::string_view::npos)
+        {
+            return {};
+        }
+        if (literal && min == 0)
+        {
+            run.pop_back();
+        }
+        end_run();
+    }
+    end_run();
+    return best;
+}
+
+LiteralPrefilter::LiteralPrefilter(const std::vector<std::string>& literals)
+{
+    // trie first, its edges are flattened once the fail links are known
+    std::vector<std::map<std::uint8_t, std::uint32_t>> children(1);
+    std::vector<std::vector<std::uint32_t>> terminals(1);
+    for (std::uint32_t index = 0; index < literals.size(); ++index)
+    {
+        auto&& literal = literals[index];
+        if (literal.empty())
+        {
+            continue;
+        }
+        ++literal_count;
+        std::uint32_t node = 0;
+        for (char c : literal)
+        {
+            auto byte = static_cast<std::uint8_t>(c);
+            auto it = children[node].find(byte);
+            if (it == children[node].end())
+            {
+                it = children[node].emplace(byte, static_cast<std::uint32_t>(children.size())).first;
+                children.emplace_back();
+                terminals.emplace_back();
+            }
+            node = it->second;
+        }
+        terminals[node].push_back(index);
+    }
+
+    nodes.resize(children.size());
+    for (std::uint32_t node = 0; node < children.size(); ++node)
+    {
+        nodes[node].edges_begin = static_cast<std::uint32_t>(edge_bytes.size());
+        for (auto&& [byte, target] : children[node])
+        {
+            edge_bytes.push_back(byte);
+            edge_targets.push_back(target);
+        }
+        nodes[node].edges_end = static_cast<std::uint32_t>(edge_bytes.size());
+        nodes[node].outputs_begin = static_cast<std::uint32_t>(outputs.size());
+        outputs.insert(outputs.end(), terminals[node].begin(), terminals[node].end());
+        nodes[node].outputs_end = static_cast<std::uint32_t>(outputs.size());
+    }
+    for (auto&& [byte, target] : children[0])
+    {
+        root_next[byte] = target;
+    }
+
+    // breadth first, a node's fail target is always shallower and done before it
+    std::queue<std::uint32_t> queue;
+    for (auto&& [byte, target] : children[0])
+    {
+        queue.push(target);
+    }
+    while (!queue.empty())
+    {
+        auto node = queue.front();
+        queue.pop();
+        for (auto&& [byte, target] : children[node])
+        {
+            auto fail = next_state(nodes[node].fail, byte);
+            nodes[target].fail = fail;
+            nodes[target].output_link = nodes[fail].outputs_begin != nodes[fail].outputs_end ? fail : nodes[fail].output_link;
+            queue.push(target);
+        }
+    }
+
+    // SIMD needles: first byte pairs are more selective, single bytes cover one byte literals
+    std::vector<std::pair<std::uint8_t, std::uint8_t>> pairs;
+    std::vector<std::uint8_t> singles;
+    bool all_pairs = true;
+    for (auto&& literal : literals)
+    {
+        if (literal.empty())
+        {
+            continue;
+        }
+        singles.push_back(static_cast<std::uint8_t>(literal[0]));
+        if (literal.size() < 2)
+        {
+            all_pairs = false;
+            continue;
+        }
+        pairs.emplace_back(static_cast<std::uint8_t>(literal[0]), static_cast<std::uint8_t>(literal[1]));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    std::sort(singles.begin(), singles.end());
+    singles.erase(std::unique(singles.begin(), singles.end()), singles.end());
+
+    if (all_pairs && !pairs.empty() && pairs.size() <= max_simd_needles)
+    {
+        simd_mode = SimdMode::Pair;
+        for (auto&& [first, second] : pairs)
+        {
+            first_bytes.push_back(first);
+            second_bytes.push_back(second);
+        }
+    }
+    else if (!singles.empty() && singles.size() <= max_simd_needles)
+    {
+        simd_mode = SimdMode::FirstByte;
+        first_bytes = std::move(singles);
+    }
+}
+
+std::uint32_t LiteralPrefilter::next_state(std::uint32_t state, std::uint8_t byte) const
+{
+    while (state != 0)
+    {
+        auto&& node = nodes[state];
+        auto begin = edge_bytes.begin() + node.edges_begin;
+        auto end = edge_bytes.begin() + node.edges_end;
+        auto it = std::lower_bound(begin, end, byte);
+        if (it != end && *it == byte)
+        {
+            return edge_targets[static_cast<std::size_t>(it - edge_bytes.begin())];
+        }
+        state = node.fail;
+    }
+    return root_next[byte];
+}
+
+std::size_t LiteralPrefilter::first_candidate(std::string_view line) const
+{
+    auto data = reinterpret_cast<const unsigned char*>(line.data());
+    auto size = line.size();
+    auto needles = first_bytes.size();
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    if (simd_mode == SimdMode::Pair)
+    {
+        // the second load is one byte ahead, it must stay inside the line
+        for (; i + 17 <= size; i += 16)
+        {
+            auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+            auto hits = _mm_setzero_si128();
+            for (std::size_t n = 0; n < needles; ++n)
+            {
+                auto pair = _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8(static_cast<char>(first_bytes[n]))),
+                    _mm_cmpeq_epi8(second, _mm_set1_epi8(static_cast<char>(second_bytes[n]))));
+                hits = _mm_or_si128(hits, pair);
+            }
+            if (auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)))
+            {
+                return i + static_cast<std::size_t>(std::countr_zero(mask));
+            }
+        }
+    }
+    else
+    {
+        for (; i + 16 <= size; i += 16)
+        {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            auto hits = _mm_setzero_si128();
+            for (std::size_t n = 0; n < needles; ++n)
+            {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(first_bytes[n]))));
+            }
+            if (auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)))
+            {
+                return i + static_cast<std::size_t>(std::countr_zero(mask));
+            }
+        }
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+        for (std::size_t n = 0; n < needles; ++n)
+        {
+            if (data[i] == first_bytes[n] && (simd_mode != SimdMode::Pair || (i + 1 < size && data[i + 1] == second_bytes[n])))
+            {
+                return i;
+            }
+        }
+    }
+    return std::string_view::npos;
+}
+
+void LiteralPrefilter::find(std::string_view line, std::vector<std::uint32_t>& hits) const
+{
+    if (literal_count == 0)
+    {
+        return;
+    }
+
+    // every occurrence starts at a needle, nothing before the first one can match
+    std::size_t start = 0;
+    if (simd_mode != SimdMode::None)
+    {
+        start = first_candidate(line);
+        if (start == std::string_view::npos)
+        {
+            return;
+        }
+    }
+
+    auto first_hit = hits.size();
+    std::uint32_t state = 0;
+    for (auto i = start; i < line.size(); ++i)
+    {
+        auto byte = static_cast<std::uint8_t>(line[i]);
+        state = state == 0 ? root_next[byte] : next_state(state, byte);
+        if (state == 0)
+        {
+            continue;
+        }
+        auto&& node = nodes[state];
+        auto output = node.outputs_begin != node.outputs_end ? state : node.output_link;
+        while (output != 0)
+        {
+            auto&& out = nodes[output];
+            hits.insert(hits.end(), outputs.begin() + out.outputs_begin, outputs.begin() + out.outputs_end);
+            output = out.output_link;
+        }
+    }
+
+    std::sort(hits.begin() + static_cast<std::ptrdiff_t>(first_hit), hits.end());
+    hits.erase(std::unique(hits.begin() + static_cast<std::ptrdiff_t>(first_hit), hits.end()), hits.end());
+}
\ No newline at end of file
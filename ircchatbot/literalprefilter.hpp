@@ -0,0 +1,63 @@
+#ifndef LITERALPREFILTER_HPP_
+#define LITERALPREFILTER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// finds which of a set of literals occur in a line: an Aho-Corasick automaton over all of them,
+// behind a SIMD scan for their first bytes or first byte pairs when there are few enough of those
+class LiteralPrefilter
+{
+public:
+    // a literal every match of pattern (boost perl syntax) has to contain, empty when there is none
+    static std::string required_literal(std::string_view pattern);
+
+    LiteralPrefilter() = default;
+    // empty literals are skipped
+    explicit LiteralPrefilter(const std::vector<std::string>& literals);
+
+    // indexes of the literals occurring in line, each at most once
+    void find(std::string_view line, std::vector<std::uint32_t>& hits) const;
+
+    static constexpr std::size_t max_simd_needles = 8;
+
+private:
+    enum class SimdMode : std::uint8_t
+    {
+        None,
+        FirstByte,
+        Pair
+    };
+    SimdMode simd_mode = SimdMode::None;
+    std::vector<std::uint8_t> first_bytes;
+    std::vector<std::uint8_t> second_bytes;
+    // offset of the first needle in line, npos without one
+    std::size_t first_candidate(std::string_view line) const;
+
+    // trie nodes with their edges flattened, node 0 is the root
+    struct Node
+    {
+        std::uint32_t edges_begin = 0;
+        std::uint32_t edges_end = 0;
+        std::uint32_t fail = 0;
+        // nearest node on the fail chain with outputs, 0 for none
+        std::uint32_t output_link = 0;
+        std::uint32_t outputs_begin = 0;
+        std::uint32_t outputs_end = 0;
+    };
+    std::vector<Node> nodes;
+    std::vector<std::uint8_t> edge_bytes;
+    std::vector<std::uint32_t> edge_targets;
+    std::vector<std::uint32_t> outputs;
+    // the root's transitions are dense, most bytes of a line are read there
+    std::array<std::uint32_t, 256> root_next{};
+    std::size_t literal_count = 0;
+
+    std::uint32_t next_state(std::uint32_t state, std::uint8_t byte) const;
+};
+
+#endif // LITERALPREFILTER_HPP_
\ No newline at end of file
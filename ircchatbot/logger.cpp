@@ -0,0 +1,251 @@
+#include "logger.hpp"
+
+#include <ctime>
+#include <cstdio>
+
+constexpr std::array<std::string_view, 4> level_names{ "debug", "info", "warning", "error" };
+constexpr std::array<std::string_view, static_cast<std::size_t>(LogCategory::Count)> category_names{ "general", "irc", "database", "users", "commands", "channels", "http" };
+
+Logger::Logger()
+{
+    for (auto&& rate : sampling)
+    {
+        rate.store(1, std::memory_order_relaxed);
+    }
+    writer = std::thread([this] { run_writer(); });
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard lk(writer_mutex);
+        stopping = true;
+    }
+    writer_cv.notify_one();
+    writer.join();
+
+    if (file)
+    {
+        std::fclose(file);
+    }
+}
+
+Logger::ThreadRing& Logger::thread_ring()
+{
+    thread_local std::shared_ptr<ThreadRing> ring;
+    if (!ring)
+    {
+        ring = std::make_shared<ThreadRing>();
+        std::lock_guard lk(rings_mutex);
+        rings.push_back(ring);
+    }
+    return *ring;
+}
+
+void Logger::log(LogLevel level, LogCategory category, std::string_view text)
+{
+    if (level < min_level.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    auto& ring = thread_ring();
+    auto category_index = static_cast<std::size_t>(category);
+    if (level < LogLevel::Warning)
+    {
+        auto rate = sampling[category_index].load(std::memory_order_relaxed);
+        if (rate > 1 && ring.sample_counters[category_index]++ % rate != 0)
+        {
+            return;
+        }
+    }
+
+    if (!ring.records.try_push(Record{ std::chrono::system_clock::now(), level, category, std::string(text) }))
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::set_level(LogLevel level)
+{
+    min_level.store(level, std::memory_order_relaxed);
+}
+
+void Logger::set_sampling(LogCategory category, std::uint32_t one_in_n)
+{
+    sampling[static_cast<std::size_t>(category)].store(one_in_n == 0 ? 1 : one_in_n, std::memory_order_relaxed);
+}
+
+void Logger::set_file(const std::string& path, std::size_t max_size, int max_old_files)
+{
+    std::lock_guard lk(writer_mutex);
+    if (file)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+    file_path = path;
+    max_file_size = max_size;
+    max_files = max_old_files;
+    open_file();
+}
+
+void Logger::flush()
+{
+    std::unique_lock lk(writer_mutex);
+    auto generation = flushed_generation;
+    flush_requested = true;
+    writer_cv.notify_one();
+    flushed_cv.wait(lk, [this, generation] { return flushed_generation != generation || stopping; });
+}
+
+void Logger::run_writer()
+{
+    std::string out;
+    std::string err;
+
+    std::unique_lock lk(writer_mutex);
+    while (true)
+    {
+        writer_cv.wait_for(lk, drain_interval, [this] { return stopping || flush_requested; });
+        bool stop = stopping;
+        bool flushing = flush_requested;
+        flush_requested = false;
+
+        out.clear();
+        err.clear();
+        drain(out, err);
+        write_batch(out, err);
+
+        if (flushing)
+        {
+            ++flushed_generation;
+            flushed_cv.notify_all();
+        }
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+void Logger::drain(std::string& out, std::string& err)
+{
+    std::vector<std::shared_ptr<ThreadRing>> current;
+    {
+        std::lock_guard lk(rings_mutex);
+        current = rings;
+    }
+
+    Record record;
+    for (auto&& ring : current)
+    {
+        while (ring->records.try_pop(record))
+        {
+            format_record(record.level >= LogLevel::Warning && !file ? err : out, record);
+        }
+
+        if (auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed); dropped > 0)
+        {
+            format_record(file ? out : err, Record{ std::chrono::system_clock::now(), LogLevel::Warning, LogCategory::General, "logger dropped " + std::to_string(dropped) + " records" });
+        }
+    }
+
+    // rings of finished threads are only referenced from here once drained
+    std::lock_guard lk(rings_mutex);
+    std::erase_if(rings, [](auto&& ring) { return ring.use_count() == 2 && ring->records.empty(); });
+}
+
+void Logger::write_batch(const std::string& out, const std::string& err)
+{
+    if (!file)
+    {
+        if (!out.empty())
+        {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!err.empty())
+        {
+            std::fwrite(err.data(), 1, err.size(), stderr);
+            std::fflush(stderr);
+        }
+        return;
+    }
+
+    if (out.empty())
+    {
+        return;
+    }
+    if (max_file_size > 0 && file_size > 0 && file_size + out.size() > max_file_size)
+    {
+        rotate_file();
+        if (!file)
+        {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            return;
+        }
+    }
+    std::fwrite(out.data(), 1, out.size(), file);
+    std::fflush(file);
+    file_size += out.size();
+}
+
+void Logger::open_file()
+{
+    if (file_path.empty())
+    {
+        return;
+    }
+
+    file = std::fopen(file_path.c_str(), "a");
+    if (!file)
+    {
+        std::fprintf(stderr, "Logger unable to open %s, logging to stdout\n", file_path.c_str());
+        return;
+    }
+    std::fseek(file, 0, SEEK_END);
+    file_size = static_cast<std::size_t>(std::ftell(file));
+}
+
+void Logger::rotate_file()
+{
+    std::fclose(file);
+    file = nullptr;
+
+    if (max_files > 0)
+    {
+        for (int i = max_files - 1; i >= 1; --i)
+        {
+            std::rename((file_path + "." + std::to_string(i)).c_str(), (file_path + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(file_path.c_str(), (file_path + ".1").c_str());
+    }
+    else
+    {
+        std::remove(file_path.c_str());
+    }
+
+    open_file();
+}
+
+void Logger::format_record(std::string& out, const Record& record)
+{
+    auto time = std::chrono::system_clock::to_time_t(record.time);
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000;
+    std::tm tm;
+    localtime_r(&time, &tm);
+
+    char stamp[32];
+    auto length = std::snprintf(stamp, sizeof(stamp), "%04d-%02d-%02d %02d:%02d:%02d.%03d ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(millis));
+
+    out.append(stamp, length);
+    out += '[';
+    out += level_names[static_cast<std::size_t>(record.level)];
+    out += "] [";
+    out += category_names[static_cast<std::size_t>(record.category)];
+    out += "] ";
+    out += record.text;
+    out += '\n';
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef LOGGER_HPP_
+#define LOGGER_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "spscqueue.hpp"
+
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+enum class LogCategory
+{
+    General,
+    Irc,
+    Database,
+    Users,
+    Commands,
+    Channels,
+    Http,
+    Count
+};
+
+// every thread writes into its own lock-free ring, a background thread drains them in batches
+// full rings drop records instead of blocking the caller
+class Logger
+{
+public:
+    static Logger& get_instance()
+    {
+        static Logger instance;
+        return instance;
+    }
+
+    void log(LogLevel level, LogCategory category, std::string_view text);
+
+    void set_level(LogLevel level);
+    // keep one in every n debug and info records of the category, warnings and errors are always kept
+    void set_sampling(LogCategory category, std::uint32_t one_in_n);
+    // empty path logs to stdout and stderr, otherwise the file is rotated at max_size keeping max_files old ones
+    void set_file(const std::string& path, std::size_t max_size, int max_files);
+
+    // writes everything logged so far
+    void flush();
+
+    static constexpr std::size_t thread_ring_capacity = 8192;
+    static constexpr std::chrono::milliseconds drain_interval{ 20 };
+
+private:
+    Logger();
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(Logger&&) = delete;
+
+    struct Record
+    {
+        std::chrono::system_clock::time_point time;
+        LogLevel level = LogLevel::Info;
+        LogCategory category = LogCategory::General;
+        std::string text;
+    };
+
+    struct ThreadRing
+    {
+        ThreadRing()
+            : records(thread_ring_capacity)
+        {}
+
+        SpscQueue<Record> records;
+        std::array<std::uint32_t, static_cast<std::size_t>(LogCategory::Count)> sample_counters{};
+        std::atomic<std::uint64_t> dropped{ 0 };
+    };
+
+    ThreadRing& thread_ring();
+
+    std::atomic<LogLevel> min_level{ LogLevel::Info };
+    std::array<std::atomic<std::uint32_t>, static_cast<std::size_t>(LogCategory::Count)> sampling{};
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+
+    // writer thread state
+    std::mutex writer_mutex;
+    std::condition_variable writer_cv;
+    bool stopping = false;
+    bool flush_requested = false;
+    std::uint64_t flushed_generation = 0;
+    std::condition_variable flushed_cv;
+    std::thread writer;
+
+    std::string file_path;
+    std::size_t max_file_size = 0;
+    int max_files = 0;
+    std::FILE* file = nullptr;
+    std::size_t file_size = 0;
+
+    void run_writer();
+    void drain(std::string& out, std::string& err);
+    void write_batch(const std::string& out, const std::string& err);
+    void open_file();
+    void rotate_file();
+    static void format_record(std::string& out, const Record& record);
+};
+
+inline void log_debug(LogCategory category, std::string_view text)
+{
+    Logger::get_instance().log(LogLevel::Debug, category, text);
+}
+
+inline void log_info(LogCategory category, std::string_view text)
+{
+    Logger::get_instance().log(LogLevel::Info, category, text);
+}
+
+inline void log_warning(LogCategory category, std::string_view text)
+{
+    Logger::get_instance().log(LogLevel::Warning, category, text);
+}
+
+inline void log_error(LogCategory category, std::string_view text)
+{
+    Logger::get_instance().log(LogLevel::Error, category, text);
+}
+
+#endif // LOGGER_HPP_
\ No newline at end of file
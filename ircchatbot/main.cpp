@@ -1,6 +1,5 @@
-﻿#include <iostream>
-
-#include "chatbot.hpp"
+﻿#include "chatbot.hpp"
+#include "logger.hpp"
 
 #include <optional>
 
@@ -12,17 +11,17 @@ void run_chatbot(std::vector<std::string>& args)
         chatbot.users.add_user(args[3], args[4]);
         chatbot.users.add_admin(args[3], 100);
 
-        std::cout << "Starting bot" << std::endl;
+        log_info(LogCategory::General, "Starting bot");
         chatbot.run();
-        std::cout << "Quitting bot" << std::endl;
+        log_info(LogCategory::General, "Quitting bot");
     }
     else
     {
         Chatbot chatbot;
 
-        std::cout << "Starting bot" << std::endl;
+        log_info(LogCategory::General, "Starting bot");
         chatbot.run();
-        std::cout << "Quitting bot" << std::endl;
+        log_info(LogCategory::General, "Quitting bot");
     }
 }
 
@@ -41,8 +40,8 @@ int main(int argc, char** argv)
         }
         catch (std::exception& e)
         {
-            std::cerr << "Attempt " << start_attempts << " exception: " << e.what() << std::endl;
-            std::cerr << "Retrying" << std::endl;
+            log_error(LogCategory::General, "Attempt " + std::to_string(start_attempts) + " exception: " + e.what());
+            log_error(LogCategory::General, "Retrying");
             ++start_attempts;
         }
     }
@@ -0,0 +1,163 @@
+#include "messagepipeline.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <exception>
+
+#include "logger.hpp"
+
+MessagePipeline::MessagePipeline(boost::asio::io_context& io_context, std::size_t shard_count, ShardHandler handler)
+    : io_context(io_context)
+    , handler(std::move(handler))
+{
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        shards.push_back(std::make_unique<Shard>(io_context));
+    }
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        shards[i]->thread = std::thread([this, i] { run_shard(i); });
+    }
+}
+
+MessagePipeline::~MessagePipeline()
+{
+    stopping.store(true, std::memory_order_release);
+    for (auto&& shard : shards)
+    {
+        shard->signal.fetch_add(1, std::memory_order_release);
+        shard->signal.notify_one();
+    }
+    for (auto&& shard : shards)
+    {
+        shard->thread.join();
+    }
+}
+
+std::size_t MessagePipeline::shard_count() const
+{
+    return shards.size();
+}
+
+std::size_t MessagePipeline::shard_for(std::string_view channel) const
+{
+    return std::hash<std::string_view>{}(channel) % shards.size();
+}
+
+void MessagePipeline::dispatch(std::string_view channel, std::size_t source, std::string&& line)
+{
+    auto index = shard_for(channel);
+    auto&& shard = *shards[index];
+    InboundLine inbound{ source, std::move(line) };
+    // lines already held back go first, or the channel's order would break
+    if (shard.overflow.empty() && shard.lines.try_push(std::move(inbound)))
+    {
+        wake(shard);
+        return;
+    }
+
+    if (shard.overflow.size() >= shard_overflow_capacity)
+    {
+        if (dropped++ % 1000 == 0)
+        {
+            log_warning(LogCategory::General, "Pipeline shard " + std::to_string(index) + " is behind, dropped " + std::to_string(dropped) + " lines so far");
+        }
+        return;
+    }
+    shard.overflow.push_back(std::move(inbound));
+    schedule_retry(index);
+}
+
+std::uint64_t MessagePipeline::dropped_lines() const
+{
+    return dropped;
+}
+
+void MessagePipeline::wake(Shard& shard)
+{
+    shard.signal.fetch_add(1, std::memory_order_release);
+    shard.signal.notify_one();
+}
+
+void MessagePipeline::schedule_retry(std::size_t index)
+{
+    auto&& shard = *shards[index];
+    if (shard.retry_scheduled)
+    {
+        return;
+    }
+    shard.retry_scheduled = true;
+    // shards never wait on the io thread, the queue frees up as soon as the shard catches up
+    shard.retry_timer.expires_after(overflow_retry_delay);
+    shard.retry_timer.async_wait([this, index](const boost::system::error_code& error)
+    {
+        if (error)
+        {
+            return;
+        }
+        auto&& shard = *shards[index];
+        shard.retry_scheduled = false;
+        bool pushed = false;
+        while (!shard.overflow.empty() && shard.lines.try_push(std::move(shard.overflow.front())))
+        {
+            shard.overflow.pop_front();
+            pushed = true;
+        }
+        if (pushed)
+        {
+            wake(shard);
+        }
+        if (!shard.overflow.empty())
+        {
+            schedule_retry(index);
+        }
+    });
+}
+
+void MessagePipeline::post_to_writer(WriterTask task)
+{
+    writer_tasks.push(std::move(task));
+    if (!drain_scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        boost::asio::post(io_context, [this] { drain_writer_tasks(); });
+    }
+}
+
+void MessagePipeline::drain_writer_tasks()
+{
+    // cleared before popping so a task pushed meanwhile schedules another drain
+    drain_scheduled.exchange(false, std::memory_order_acq_rel);
+
+    WriterTask task;
+    while (writer_tasks.try_pop(task))
+    {
+        task();
+    }
+}
+
+void MessagePipeline::run_shard(std::size_t index)
+{
+    auto&& shard = *shards[index];
+    InboundLine inbound;
+    while (true)
+    {
+        auto seen = shard.signal.load(std::memory_order_acquire);
+        while (shard.lines.try_pop(inbound))
+        {
+            try
+            {
+                handler(index, inbound.source, std::move(inbound.line));
+            }
+            catch (std::exception& e)
+            {
+                log_error(LogCategory::General, "Pipeline shard " + std::to_string(index) + " exception: " + e.what());
+            }
+        }
+
+        if (stopping.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        shard.signal.wait(seen, std::memory_order_acquire);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef MESSAGEPIPELINE_HPP_
+#define MESSAGEPIPELINE_HPP_
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mpscqueue.hpp"
+#include "spscqueue.hpp"
+
+// spreads framed lines over worker shards by channel, each channel is always handled by the same shard
+// and in arrival order; shards hand results back to the io_context through one queue that keeps
+// every shard's order; a shard that falls behind holds its further lines on the io thread, and past
+// a limit they are dropped, so the io thread never waits for a shard
+class MessagePipeline
+{
+public:
+    // source tells the handler where the line came from, e.g. which connection
+    using ShardHandler = std::function<void(std::size_t shard, std::size_t source, std::string&& line)>;
+    using WriterTask = std::function<void()>;
+
+    MessagePipeline(boost::asio::io_context& io_context, std::size_t shard_count, ShardHandler handler);
+    ~MessagePipeline();
+    MessagePipeline(const MessagePipeline&) = delete;
+    MessagePipeline& operator=(const MessagePipeline&) = delete;
+
+    std::size_t shard_count() const;
+    std::size_t shard_for(std::string_view channel) const;
+
+    // io thread only
+    void dispatch(std::string_view channel, std::size_t source, std::string&& line);
+    // shard threads, task runs on the io_context
+    void post_to_writer(WriterTask task);
+    // io thread only
+    std::uint64_t dropped_lines() const;
+
+    static constexpr std::size_t shard_queue_capacity = 4096;
+    static constexpr std::size_t shard_overflow_capacity = 4096;
+    static constexpr std::chrono::milliseconds overflow_retry_delay{ 1 };
+
+private:
+    struct InboundLine
+    {
+        std::size_t source = 0;
+        std::string line;
+    };
+
+    struct Shard
+    {
+        Shard(boost::asio::io_context& io_context)
+            : lines(shard_queue_capacity)
+            , retry_timer(io_context)
+        {}
+
+        SpscQueue<InboundLine> lines;
+        std::atomic<std::uint32_t> signal{ 0 };
+        std::thread thread;
+
+        // io thread only, lines that did not fit in the queue yet, oldest first
+        std::deque<InboundLine> overflow;
+        boost::asio::steady_timer retry_timer;
+        bool retry_scheduled = false;
+    };
+
+    boost::asio::io_context& io_context;
+    ShardHandler handler;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<bool> stopping{ false };
+    std::uint64_t dropped = 0;
+
+    MpscQueue<WriterTask> writer_tasks;
+    std::atomic<bool> drain_scheduled{ false };
+
+    void run_shard(std::size_t index);
+    static void wake(Shard& shard);
+    void schedule_retry(std::size_t index);
+    void drain_writer_tasks();
+};
+
+#endif // MESSAGEPIPELINE_HPP_
\ No newline at end of file
@@ -0,0 +1,393 @@
+#include "messageshape.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // code points that do not start a new grapheme, by their lead byte at i
+    std::size_t joined_code_points(const unsigned char* data, std::size_t size, std::size_t i)
+    {
+        auto at = [&](std::size_t offset) -> unsigned
+        {
+            return i + offset < size ? data[i + offset] : 0;
+        };
+        switch (data[i])
+        {
+        case 0xCC:
+            // U+0300..U+033F combining diacritical marks
+            return 1;
+        case 0xCD:
+            // U+0340..U+036F
+            return at(1) < 0xB0 ? 1 : 0;
+        case 0xE2:
+            // U+200D zero width joiner, the joiner and the code point after it
+            return at(1) == 0x80 && at(2) == 0x8D ? 2 : 0;
+        case 0xEF:
+            // U+FE0F emoji presentation selector
+            return at(1) == 0xB8 && at(2) == 0x8F ? 1 : 0;
+        case 0xF0:
+            // U+1F3FB..U+1F3FF skin tone modifiers
+            return at(1) == 0x9F && at(2) == 0x8F && at(3) >= 0xBB && at(3) <= 0xBF ? 1 : 0;
+        default:
+            return 0;
+        }
+    }
+
+    bool is_art(const unsigned char* data, std::size_t size, std::size_t i)
+    {
+        // U+2500..U+28FF, box drawing up to braille
+        return data[i] == 0xE2 && i + 1 < size && data[i + 1] >= 0x94 && data[i + 1] <= 0xA3;
+    }
+
+    // longest runs of set bits in a stream of masks, bit k standing for the pair of bytes k and k + 1
+    struct RunTracker
+    {
+        std::size_t current = 0;
+        std::size_t best = 0;
+
+        void feed(std::uint32_t mask, int bits)
+        {
+            auto full = bits == 32 ? ~0u : (1u << bits) - 1;
+            if (mask == full)
+            {
+                current += static_cast<std::size_t>(bits);
+                return;
+            }
+            current += static_cast<std::size_t>(std::countr_one(mask));
+            best = std::max(best, current);
+            std::size_t inner = 0;
+            for (auto x = mask; x != 0; x &= x << 1)
+            {
+                ++inner;
+            }
+            best = std::max(best, inner);
+            current = static_cast<std::size_t>(std::countl_one(mask << (32 - bits)));
+        }
+
+        void feed_bit(bool bit)
+        {
+            if (bit)
+            {
+                ++current;
+                return;
+            }
+            best = std::max(best, current);
+            current = 0;
+        }
+
+        std::size_t finish()
+        {
+            return std::max(best, current);
+        }
+    };
+
+#if defined(__SSE2__)
+    // bytes in [low, high] unsigned
+    inline __m128i in_range(__m128i v, unsigned char low, unsigned char high)
+    {
+        auto clamped = _mm_min_epu8(_mm_max_epu8(v, _mm_set1_epi8(static_cast<char>(low))), _mm_set1_epi8(static_cast<char>(high)));
+        return _mm_cmpeq_epi8(clamped, v);
+    }
+
+#endif
+#if defined(__AVX2__)
+    inline __m256i in_range(__m256i v, unsigned char low, unsigned char high)
+    {
+        auto clamped = _mm256_min_epu8(_mm256_max_epu8(v, _mm256_set1_epi8(static_cast<char>(low))), _mm256_set1_epi8(static_cast<char>(high)));
+        return _mm256_cmpeq_epi8(clamped, v);
+    }
+
+#endif
+}
+
+MessageShape MessageShape::measure(std::string_view message)
+{
+    MessageShape shape;
+    auto data = reinterpret_cast<const unsigned char*>(message.data());
+    auto size = message.size();
+    shape.bytes = size;
+
+    std::size_t continuation = 0;
+    std::size_t joined = 0;
+    RunTracker runs;
+    std::size_t i = 0;
+
+#if defined(__AVX2__)
+    // the same pass as the SSE2 one below over 32 byte blocks, that one takes the remaining 16 byte block
+    {
+        auto zero = _mm256_setzero_si256();
+        __m256i upper_lanes = zero, letter_lanes = zero, digit_lanes = zero, symbol_lanes = zero, continuation_lanes = zero;
+        std::size_t lane_blocks = 0;
+        auto sum_lanes = [&]
+        {
+            auto sum = [&](__m256i& lanes, std::size_t& total)
+            {
+                auto sums = _mm256_sad_epu8(lanes, zero);
+                auto halves = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+                total += static_cast<std::size_t>(_mm_cvtsi128_si32(halves)) + static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(halves, halves)));
+                lanes = zero;
+            };
+            sum(upper_lanes, shape.uppercase);
+            sum(letter_lanes, shape.letters);
+            sum(digit_lanes, shape.digits);
+            sum(symbol_lanes, shape.symbols);
+            sum(continuation_lanes, continuation);
+            lane_blocks = 0;
+        };
+
+        for (; i + 35 <= size; i += 32)
+        {
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            auto next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+            auto is = [](__m256i bytes, unsigned char c)
+            {
+                return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(static_cast<char>(c)));
+            };
+
+            auto upper = in_range(v, 'A', 'Z');
+            auto letters = _mm256_or_si256(upper, in_range(v, 'a', 'z'));
+            auto digits = in_range(v, '0', '9');
+            auto punctuation = _mm256_andnot_si256(_mm256_or_si256(letters, digits), in_range(v, 0x21, 0x7E));
+            auto e2 = is(v, 0xE2);
+            auto art = _mm256_and_si256(e2, in_range(next, 0x94, 0xA3));
+
+            upper_lanes = _mm256_sub_epi8(upper_lanes, upper);
+            letter_lanes = _mm256_sub_epi8(letter_lanes, letters);
+            digit_lanes = _mm256_sub_epi8(digit_lanes, digits);
+            symbol_lanes = _mm256_sub_epi8(_mm256_sub_epi8(symbol_lanes, punctuation), art);
+            continuation_lanes = _mm256_sub_epi8(continuation_lanes, in_range(v, 0x80, 0xBF));
+            if (++lane_blocks == 255)
+            {
+                sum_lanes();
+            }
+
+            if (auto pairs = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, next))); pairs != 0 || runs.current != 0)
+            {
+                runs.feed(pairs, 32);
+            }
+
+            // a 32 byte block of emoji heavy chat mostly has a lead in it, the rules of joined_code_points
+            // are checked in the vector instead of byte by byte, the joiner joins itself and the code point after it
+            auto cc = is(v, 0xCC), cd = is(v, 0xCD), ef = is(v, 0xEF), f0 = is(v, 0xF0);
+            if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(cc, cd), _mm256_or_si256(_mm256_or_si256(ef, f0), e2))) != 0)
+            {
+                auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+                auto third = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 3));
+                auto joiner = _mm256_and_si256(_mm256_and_si256(e2, is(next, 0x80)), is(second, 0x8D));
+                auto joins = _mm256_or_si256(_mm256_or_si256(cc, _mm256_and_si256(cd, in_range(next, 0x00, 0xAF))),
+                    _mm256_or_si256(_mm256_and_si256(_mm256_and_si256(ef, is(next, 0xB8)), is(second, 0x8F)),
+                        _mm256_and_si256(_mm256_and_si256(_mm256_and_si256(f0, is(next, 0x9F)), is(second, 0x8F)), in_range(third, 0xBB, 0xBF))));
+                joined += static_cast<std::size_t>(std::popcount(static_cast<std::uint32_t>(_mm256_movemask_epi8(joins))))
+                    + 2 * static_cast<std::size_t>(std::popcount(static_cast<std::uint32_t>(_mm256_movemask_epi8(joiner))));
+            }
+        }
+        sum_lanes();
+    }
+#endif
+
+#if defined(__SSE2__)
+    // per byte lane counters, a lane adds one for every set mask byte and is summed up before it can overflow
+    auto zero = _mm_setzero_si128();
+    __m128i upper_lanes = zero, letter_lanes = zero, digit_lanes = zero, symbol_lanes = zero, continuation_lanes = zero;
+    std::size_t lane_blocks = 0;
+    auto sum_lanes = [&]
+    {
+        auto sum = [&](__m128i& lanes, std::size_t& total)
+        {
+            auto sums = _mm_sad_epu8(lanes, zero);
+            total += static_cast<std::size_t>(_mm_cvtsi128_si32(sums)) + static_cast<std::size_t>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+            lanes = zero;
+        };
+        sum(upper_lanes, shape.uppercase);
+        sum(letter_lanes, shape.letters);
+        sum(digit_lanes, shape.digits);
+        sum(symbol_lanes, shape.symbols);
+        sum(continuation_lanes, continuation);
+        lane_blocks = 0;
+    };
+
+    // loads reach three bytes past the block for the multi byte checks
+    for (; i + 19 <= size; i += 16)
+    {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+
+        auto upper = in_range(v, 'A', 'Z');
+        auto letters = _mm_or_si128(upper, in_range(v, 'a', 'z'));
+        auto digits = in_range(v, '0', '9');
+        auto punctuation = _mm_andnot_si128(_mm_or_si128(letters, digits), in_range(v, 0x21, 0x7E));
+        auto e2 = _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(0xE2)));
+        auto art = _mm_and_si128(e2, in_range(next, 0x94, 0xA3));
+
+        // set mask bytes are -1
+        upper_lanes = _mm_sub_epi8(upper_lanes, upper);
+        letter_lanes = _mm_sub_epi8(letter_lanes, letters);
+        digit_lanes = _mm_sub_epi8(digit_lanes, digits);
+        symbol_lanes = _mm_sub_epi8(_mm_sub_epi8(symbol_lanes, punctuation), art);
+        continuation_lanes = _mm_sub_epi8(continuation_lanes, in_range(v, 0x80, 0xBF));
+        if (++lane_blocks == 255)
+        {
+            sum_lanes();
+        }
+
+        if (auto pairs = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, next))); pairs != 0 || runs.current != 0)
+        {
+            runs.feed(pairs, 16);
+        }
+
+        // leads that may join the next code point are rare, those blocks are looked at byte by byte
+        auto leads = _mm_or_si128(_mm_or_si128(in_range(v, 0xCC, 0xCD), e2),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(0xEF))), _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(0xF0)))));
+        for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(leads)); mask != 0; mask &= mask - 1)
+        {
+            joined += joined_code_points(data, size, i + static_cast<std::size_t>(std::countr_zero(mask)));
+        }
+    }
+    sum_lanes();
+#endif
+
+    for (; i < size; ++i)
+    {
+        auto c = data[i];
+        bool upper = c >= 'A' && c <= 'Z';
+        bool letter = upper || (c >= 'a' && c <= 'z');
+        bool digit = c >= '0' && c <= '9';
+        shape.uppercase += upper;
+        shape.letters += letter;
+        shape.digits += digit;
+        shape.symbols += (c >= 0x21 && c <= 0x7E && !letter && !digit) || is_art(data, size, i);
+        continuation += c >= 0x80 && c <= 0xBF;
+        joined += joined_code_points(data, size, i);
+        if (i + 1 < size)
+        {
+            runs.feed_bit(c == data[i + 1]);
+        }
+    }
+
+    auto code_points = size - continuation;
+    shape.graphemes = code_points - std::min(joined, code_points);
+    shape.longest_run = size == 0 ? 0 : runs.finish() + 1;
+    return shape;
+}
+
+void MessageShape::add_emotes(std::string_view message, std::string_view emotes_tag)
+{
+    // emote-id:first-last,first-last/emote-id:first-last, positions in code points
+    if (emotes_tag.empty())
+    {
+        return;
+    }
+
+    std::vector<std::size_t> byte_offsets;
+    auto to_byte = [&](std::size_t code_point) -> std::size_t
+    {
+        if (bytes == graphemes && byte_offsets.empty())
+        {
+            return std::min(code_point, message.size());
+        }
+        if (byte_offsets.empty())
+        {
+            for (std::size_t b = 0; b < message.size(); ++b)
+            {
+                if ((static_cast<unsigned char>(message[b]) & 0xC0) != 0x80)
+                {
+                    byte_offsets.push_back(b);
+                }
+            }
+            byte_offsets.push_back(message.size());
+        }
+        return byte_offsets[std::min(code_point, byte_offsets.size() - 1)];
+    };
+
+    std::size_t pos = 0;
+    while (pos < emotes_tag.size())
+    {
+        auto colon = emotes_tag.find(':', pos);
+        if (colon == std::string_view::npos)
+        {
+            break;
+        }
+        auto end = emotes_tag.find('/', colon);
+        auto ranges = emotes_tag.substr(colon + 1, end == std::string_view::npos ? std::string_view::npos : end - colon - 1);
+        std::size_t range_start = 0;
+        while (range_start <= ranges.size())
+        {
+            auto comma = ranges.find(',', range_start);
+            auto range = ranges.substr(range_start, comma == std::string_view::npos ? std::string_view::npos : comma - range_start);
+            if (auto dash = range.find('-'); dash != std::string_view::npos)
+            {
+                ++emotes;
+                std::size_t first = 0;
+                std::size_t last = 0;
+                for (char c : range.substr(0, dash))
+                {
+                    first = first * 10 + static_cast<std::size_t>(c - '0');
+                }
+                for (char c : range.substr(dash + 1))
+                {
+                    last = last * 10 + static_cast<std::size_t>(c - '0');
+                }
+                auto emote = message.substr(std::min(to_byte(first), message.size()));
+                emote = emote.substr(0, to_byte(last + 1) - std::min(to_byte(first), to_byte(last + 1)));
+                for (char c : emote)
+                {
+                    // overlapping ranges of a malformed tag must not wrap the counts
+                    if (c >= 'A' && c <= 'Z' && uppercase > 0)
+                    {
+                        --uppercase;
+                        --letters;
+                    }
+                    else if (c >= 'a' && c <= 'z' && letters > uppercase)
+                    {
+                        --letters;
+                    }
+                }
+            }
+            if (comma == std::string_view::npos)
+            {
+                break;
+            }
+            range_start = comma + 1;
+        }
+        if (end == std::string_view::npos)
+        {
+            break;
+        }
+        pos = end + 1;
+    }
+}
+
+std::string_view ShapeRule::violation(const MessageShape& shape) const
+{
+    if (max_caps_percent > 0 && shape.letters >= min_letters && shape.uppercase * 100 > static_cast<std::size_t>(max_caps_percent) * shape.letters)
+    {
+        return "caps";
+    }
+    if (max_symbols_percent > 0 && shape.graphemes >= min_letters && shape.symbols * 100 > static_cast<std::size_t>(max_symbols_percent) * shape.graphemes)
+    {
+        return "symbols";
+    }
+    if (max_run > 0 && shape.longest_run > max_run)
+    {
+        return "repetition";
+    }
+    if (max_graphemes > 0 && shape.graphemes > max_graphemes)
+    {
+        return "length";
+    }
+    if (max_emotes > 0 && shape.emotes > max_emotes)
+    {
+        return "emotes";
+    }
+    return {};
+}
\ No newline at end of file
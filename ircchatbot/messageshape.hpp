@@ -0,0 +1,49 @@
+#ifndef MESSAGESHAPE_HPP_
+#define MESSAGESHAPE_HPP_
+
+#include <cstddef>
+#include <string_view>
+
+// character statistics of a chat message, all from one vectorized pass over its bytes
+struct MessageShape
+{
+    std::size_t bytes = 0;
+    // ascii letters
+    std::size_t letters = 0;
+    std::size_t uppercase = 0;
+    std::size_t digits = 0;
+    // ascii punctuation plus box drawing, block, geometric shape and braille characters used for ascii art
+    std::size_t symbols = 0;
+    // user perceived characters: code points without combining marks, variation selectors,
+    // skin tone modifiers and the parts joined by zero width joiners
+    std::size_t graphemes = 0;
+    // longest run of one repeated byte
+    std::size_t longest_run = 0;
+    // from the emotes tag of the message, not the pass
+    std::size_t emotes = 0;
+
+    static MessageShape measure(std::string_view message);
+    // emote names are mostly capitalized words, their letters are taken out of the counts
+    void add_emotes(std::string_view message, std::string_view emotes_tag);
+};
+
+// thresholds of one channel, 0 turns a check off
+struct ShapeRule
+{
+    // percent of letters, only checked with at least min_letters letters
+    int max_caps_percent = 0;
+    // percent of graphemes, only checked with at least min_letters graphemes
+    int max_symbols_percent = 0;
+    std::size_t max_run = 0;
+    std::size_t max_graphemes = 0;
+    std::size_t max_emotes = 0;
+    // seconds, -1 for a ban
+    int timeout = 0;
+
+    static constexpr std::size_t min_letters = 8;
+
+    // name of the first threshold the message exceeds, empty when it passes
+    std::string_view violation(const MessageShape& shape) const;
+};
+
+#endif // MESSAGESHAPE_HPP_
\ No newline at end of file
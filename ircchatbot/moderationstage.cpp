@@ -0,0 +1,159 @@
+#include "moderationstage.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+#include "logger.hpp"
+
+ModerationStage::ModerationStage(boost::asio::io_context& io_context, WorkStealingPool& worker_pool, TablesSource tables_source, ActionHandler on_action,
+    std::size_t max_batch, std::chrono::microseconds max_delay)
+    : io_context(io_context)
+    , worker_pool(worker_pool)
+    , tables_source(std::move(tables_source))
+    , on_action(std::move(on_action))
+    , max_batch(std::max<std::size_t>(max_batch, 1))
+    , max_delay(max_delay)
+    , flush_timer(io_context)
+{
+}
+
+void ModerationStage::submit(std::size_t session, std::string_view channel, std::string_view user, std::string_view message, std::string_view emotes_tag)
+{
+    submitted.fetch_add(1, std::memory_order_relaxed);
+    // batches leave pending long before they are evaluated, the bound covers the pool as well
+    if (unevaluated.fetch_add(1, std::memory_order_relaxed) >= max_pending)
+    {
+        unevaluated.fetch_sub(1, std::memory_order_relaxed);
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::vector<Item> batch;
+    bool schedule = false;
+    {
+        std::lock_guard lock(mutex);
+        pending.push_back(Item{ session, std::string(channel), std::string(user), std::string(message), std::string(emotes_tag), std::chrono::steady_clock::now() });
+        if (pending.size() >= max_batch)
+        {
+            batch.swap(pending);
+        }
+        else if (!flush_scheduled)
+        {
+            flush_scheduled = true;
+            schedule = true;
+        }
+    }
+
+    if (!batch.empty())
+    {
+        dispatch(std::move(batch));
+    }
+    else if (schedule)
+    {
+        // the timer belongs to the io thread, submit may run on a pipeline shard
+        boost::asio::post(io_context, [this] { schedule_flush(); });
+    }
+}
+
+void ModerationStage::schedule_flush()
+{
+    flush_timer.expires_after(max_delay);
+    flush_timer.async_wait([this](const boost::system::error_code& error)
+    {
+        if (!error)
+        {
+            flush();
+        }
+    });
+}
+
+void ModerationStage::flush()
+{
+    std::vector<Item> batch;
+    {
+        std::lock_guard lock(mutex);
+        flush_scheduled = false;
+        batch.swap(pending);
+    }
+    if (!batch.empty())
+    {
+        dispatch(std::move(batch));
+    }
+}
+
+void ModerationStage::dispatch(std::vector<Item>&& batch)
+{
+    batches.fetch_add(1, std::memory_order_relaxed);
+    // one snapshot for the whole batch, a banphrase added meanwhile applies from the next one
+    auto tables = tables_source();
+
+    for (std::size_t begin = 0; begin < batch.size(); begin += chunk_size)
+    {
+        auto end = std::min(begin + chunk_size, batch.size());
+        std::vector<Item> chunk(std::make_move_iterator(batch.begin() + begin), std::make_move_iterator(batch.begin() + end));
+        worker_pool.post([this, tables, chunk = std::move(chunk)]() mutable
+        {
+            // released even when an evaluation throws, or the stage would stop taking messages
+            struct Release
+            {
+                std::atomic<std::size_t>& count;
+                std::size_t items;
+                ~Release() { count.fetch_sub(items, std::memory_order_relaxed); }
+            } release{ unevaluated, chunk.size() };
+
+            std::vector<Verdict> verdicts;
+            for (auto&& item : chunk)
+            {
+                std::string_view reason = "banphrase";
+                auto timeout = tables->is_banphrased(item.message, item.channel);
+                if (timeout == 0)
+                {
+                    timeout = tables->check_shape(item.message, item.channel, item.emotes_tag, reason);
+                }
+                if (timeout == 0)
+                {
+                    reason = "link";
+                    timeout = tables->check_links(item.message, item.channel);
+                }
+                auto latency = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - item.submitted_at).count());
+                total_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+                auto max = max_latency_ns.load(std::memory_order_relaxed);
+                while (latency > max && !max_latency_ns.compare_exchange_weak(max, latency, std::memory_order_relaxed))
+                {
+                }
+                if (timeout != 0)
+                {
+                    verdicts.push_back(Verdict{ item.session, std::move(item.channel), std::move(item.user), timeout, reason });
+                }
+            }
+            evaluated.fetch_add(chunk.size(), std::memory_order_relaxed);
+            return verdicts;
+        }, io_context.get_executor(), [this](std::vector<Verdict> verdicts)
+        {
+            for (auto&& verdict : verdicts)
+            {
+                actions.fetch_add(1, std::memory_order_relaxed);
+                log_info(LogCategory::Commands, "Moderated " + verdict.user + " in #" + verdict.channel + " for " + std::string(verdict.reason) + ", timeout " + std::to_string(verdict.timeout));
+                on_action(verdict);
+            }
+        });
+    }
+}
+
+ModerationStage::Stats ModerationStage::get_stats() const
+{
+    Stats stats;
+    stats.submitted = submitted.load(std::memory_order_relaxed);
+    stats.evaluated = evaluated.load(std::memory_order_relaxed);
+    stats.batches = batches.load(std::memory_order_relaxed);
+    stats.actions = actions.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    if (stats.evaluated > 0)
+    {
+        stats.average_latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(total_latency_ns.load(std::memory_order_relaxed) / stats.evaluated));
+    }
+    stats.max_latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(max_latency_ns.load(std::memory_order_relaxed)));
+    return stats;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef MODERATIONSTAGE_HPP_
+#define MODERATIONSTAGE_HPP_
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commandshandler.hpp"
+#include "workstealingpool.hpp"
+
+// banphrase, shape rule and link checks of inbound chat: messages are collected into batches, a batch is split
+// into chunks evaluated in parallel on the worker pool and the actions are taken on the io thread
+class ModerationStage
+{
+public:
+    struct Verdict
+    {
+        std::size_t session;
+        std::string channel;
+        std::string user;
+        // seconds, -1 for a ban
+        int timeout;
+        // banphrase, link or the broken shape threshold
+        std::string_view reason;
+    };
+    using TablesSource = std::function<std::shared_ptr<const CommandTables>()>;
+    // io thread
+    using ActionHandler = std::function<void(const Verdict& verdict)>;
+
+    ModerationStage(boost::asio::io_context& io_context, WorkStealingPool& worker_pool, TablesSource tables_source, ActionHandler on_action,
+        std::size_t max_batch, std::chrono::microseconds max_delay);
+    ModerationStage(const ModerationStage&) = delete;
+    ModerationStage& operator=(const ModerationStage&) = delete;
+
+    // any thread
+    // emotes_tag is the raw emotes tag of the message, empty without one
+    void submit(std::size_t session, std::string_view channel, std::string_view user, std::string_view message, std::string_view emotes_tag);
+
+    struct Stats
+    {
+        std::uint64_t submitted = 0;
+        std::uint64_t evaluated = 0;
+        std::uint64_t batches = 0;
+        std::uint64_t actions = 0;
+        // submitted while max_pending messages were waiting, never evaluated
+        std::uint64_t dropped = 0;
+        // from submit until the verdict
+        std::chrono::microseconds average_latency{ 0 };
+        std::chrono::microseconds max_latency{ 0 };
+    };
+    Stats get_stats() const;
+
+    // messages per pool task
+    static constexpr std::size_t chunk_size = 16;
+    // messages submitted and not evaluated yet, whether still batching or dispatched to the pool
+    static constexpr std::size_t max_pending = 4096;
+
+private:
+    struct Item
+    {
+        std::size_t session;
+        std::string channel;
+        std::string user;
+        std::string message;
+        std::string emotes_tag;
+        std::chrono::steady_clock::time_point submitted_at;
+    };
+
+    boost::asio::io_context& io_context;
+    WorkStealingPool& worker_pool;
+    TablesSource tables_source;
+    ActionHandler on_action;
+    std::size_t max_batch;
+    std::chrono::microseconds max_delay;
+
+    std::mutex mutex;
+    std::vector<Item> pending;
+    bool flush_scheduled = false;
+    // io thread
+    boost::asio::steady_timer flush_timer;
+    void schedule_flush();
+    void flush();
+    void dispatch(std::vector<Item>&& batch);
+
+    std::atomic<std::uint64_t> submitted{ 0 };
+    std::atomic<std::uint64_t> evaluated{ 0 };
+    std::atomic<std::uint64_t> batches{ 0 };
+    std::atomic<std::uint64_t> actions{ 0 };
+    std::atomic<std::uint64_t> dropped{ 0 };
+    std::atomic<std::size_t> unevaluated{ 0 };
+    std::atomic<std::uint64_t> total_latency_ns{ 0 };
+    std::atomic<std::uint64_t> max_latency_ns{ 0 };
+};
+
+#endif // MODERATIONSTAGE_HPP_
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef MPSCQUEUE_HPP_
+#define MPSCQUEUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+// unbounded lock-free queue for many producer threads and one consumer thread
+// every producer's items are popped in the order that producer pushed them
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : head(new Node)
+        , tail(head.load(std::memory_order_relaxed))
+    {}
+
+    ~MpscQueue()
+    {
+        while (tail)
+        {
+            auto next = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T&& value)
+    {
+        auto node = new Node;
+        node->value = std::move(value);
+        auto prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // consumer side, false when empty or when a producer is midway through a push
+    bool try_pop(T& value)
+    {
+        auto next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            return false;
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{ nullptr };
+        T value{};
+    };
+
+    alignas(64) std::atomic<Node*> head;
+    alignas(64) Node* tail;
+};
+
+#endif // MPSCQUEUE_HPP_
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "pagecache.hpp"
+
+using Hemirt::Utility::EchoPage;
+
+PageCache::PageCache(EchoPage& echo_page, std::size_t max_bytes, std::chrono::seconds stale_for, EchoPage::Slice::Lines lines)
+    : echo_page(echo_page)
+    , max_bytes(max_bytes)
+    , stale_for(stale_for)
+    , lines(lines)
+{
+}
+
+bool PageCache::Entry::covers(std::size_t wanted) const
+{
+    return complete || room >= wanted;
+}
+
+void PageCache::get(const std::string& url, const std::string& json_path, std::chrono::seconds ttl, std::size_t room, EchoPage::Handler on_done)
+{
+    FlightKey key{ PageKey{ url, json_path }, room };
+    if (ttl > std::chrono::seconds::zero())
+    {
+        if (auto it = entries.find(key.first); it != entries.end() && it->second.covers(room))
+        {
+            lru.splice(lru.begin(), lru, it->second.lru);
+            auto body = it->second.body;
+            EchoPage::truncate(body, room);
+            auto age = Clock::now() - it->second.fetched;
+            if (age < ttl)
+            {
+                ++stats.hits;
+                on_done(std::move(body));
+                return;
+            }
+            if (age < ttl + stale_for)
+            {
+                // answered now, the refresh has nobody waiting on it
+                ++stats.stale_hits;
+                if (auto [flight, started] = flights.try_emplace(key); started)
+                {
+                    flight->second.store = true;
+                    start_fetch(key, true);
+                }
+                on_done(std::move(body));
+                return;
+            }
+        }
+    }
+
+    auto [flight, started] = flights.try_emplace(key);
+    flight->second.waiters.push_back(std::move(on_done));
+    flight->second.store = flight->second.store || ttl > std::chrono::seconds::zero();
+    if (!started)
+    {
+        ++stats.shared_fetches;
+        return;
+    }
+    start_fetch(key, true);
+}
+
+PageCache::Stats PageCache::get_stats() const
+{
+    auto current = stats;
+    current.pages = entries.size();
+    current.bytes = bytes;
+    return current;
+}
+
+void PageCache::start_fetch(const FlightKey& key, bool conditional)
+{
+    ++stats.fetches;
+    std::string etag;
+    std::string last_modified;
+    // a 304 is only of use when the cached body covers the room
+    if (auto it = entries.find(key.first); conditional && it != entries.end() && it->second.covers(key.second))
+    {
+        etag = it->second.etag;
+        last_modified = it->second.last_modified;
+    }
+    echo_page.fetch(key.first.first, etag, last_modified, EchoPage::Slice{ key.second, lines, key.first.second }, [this, key](EchoPage::Page page) { finish_fetch(key, std::move(page)); });
+}
+
+void PageCache::finish_fetch(const FlightKey& key, EchoPage::Page page)
+{
+    auto node = flights.extract(key);
+    if (node.empty())
+    {
+        return;
+    }
+    auto flight = std::move(node.mapped());
+
+    std::string body;
+    if (page.status == 304)
+    {
+        ++stats.not_modified;
+        auto it = entries.find(key.first);
+        if (it == entries.end() || !it->second.covers(key.second))
+        {
+            // evicted or replaced while revalidating, the waiters need the whole page
+            if (!flight.waiters.empty())
+            {
+                flights.emplace(key, std::move(flight));
+                start_fetch(key, false);
+            }
+            return;
+        }
+        it->second.fetched = Clock::now();
+        body = it->second.body;
+        EchoPage::truncate(body, key.second);
+    }
+    else
+    {
+        body = page.body;
+        // errors and other statuses are passed on as before but never cached
+        if (page.status == 200 && flight.store)
+        {
+            store(key, std::move(page));
+        }
+    }
+
+    for (auto&& waiter : flight.waiters)
+    {
+        waiter(body);
+    }
+}
+
+void PageCache::store(const FlightKey& key, EchoPage::Page&& page)
+{
+    auto&& page_key = key.first;
+    if (auto it = entries.find(page_key); it != entries.end())
+    {
+        erase(it);
+    }
+
+    Entry entry{ std::move(page.body), std::move(page.etag), std::move(page.last_modified), Clock::now(), key.second, page.complete, {} };
+    auto size = entry_size(page_key, entry);
+    if (size > max_bytes)
+    {
+        return;
+    }
+    lru.push_front(page_key);
+    entry.lru = lru.begin();
+    entries.emplace(page_key, std::move(entry));
+    bytes += size;
+
+    while (bytes > max_bytes)
+    {
+        erase(entries.find(lru.back()));
+    }
+}
+
+void PageCache::erase(std::map<PageKey, Entry>::iterator it)
+{
+    bytes -= entry_size(it->first, it->second);
+    lru.erase(it->second.lru);
+    entries.erase(it);
+}
+
+std::size_t PageCache::entry_size(const PageKey& key, const Entry& entry)
+{
+    // the key is held by both the map and the lru list
+    return 2 * (key.first.size() + key.second.size()) + entry.body.size() + entry.etag.size() + entry.last_modified.size() + sizeof(Entry);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef PAGECACHE_HPP_
+#define PAGECACHE_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "echopage.hpp"
+
+// $url{} pages in front of EchoPage, io thread only:
+// - one fetch per url at a time, every trigger arriving meanwhile waits on it
+// - a page younger than the command's ttl is answered from memory
+// - past the ttl it is still answered at once while a refresh runs, until it is also stale_for older
+// - refreshes send the ETag and Last-Modified of the cached page and keep it on 304
+// - least recently used pages go once the bodies pass max_bytes
+// pages are fetched as slices of at most the room left in the response, a cached slice serves any room it covers;
+// a $json{} value is cached apart from its page, under the url and path
+class PageCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PageCache(Hemirt::Utility::EchoPage& echo_page, std::size_t max_bytes, std::chrono::seconds stale_for, Hemirt::Utility::EchoPage::Slice::Lines lines);
+    PageCache(const PageCache&) = delete;
+    PageCache& operator=(const PageCache&) = delete;
+
+    // a ttl of 0 never caches, concurrent fetches of the url are still shared
+    // json_path is empty for a whole page
+    void get(const std::string& url, const std::string& json_path, std::chrono::seconds ttl, std::size_t room, Hemirt::Utility::EchoPage::Handler on_done);
+
+    struct Stats
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t stale_hits = 0;
+        std::uint64_t shared_fetches = 0;
+        std::uint64_t fetches = 0;
+        std::uint64_t not_modified = 0;
+        std::size_t pages = 0;
+        std::size_t bytes = 0;
+    };
+    Stats get_stats() const;
+
+private:
+    // url and json path
+    using PageKey = std::pair<std::string, std::string>;
+    struct Entry
+    {
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+        Clock::time_point fetched;
+        // the slice the body was fetched with, a complete body covers every room
+        std::size_t room;
+        bool complete;
+        std::list<PageKey>::iterator lru;
+        bool covers(std::size_t wanted) const;
+    };
+    struct Flight
+    {
+        std::vector<Hemirt::Utility::EchoPage::Handler> waiters;
+        // any waiter with a ttl keeps the page
+        bool store = false;
+    };
+
+    // a fetch is shared by triggers wanting the same url and room
+    using FlightKey = std::pair<PageKey, std::size_t>;
+    void start_fetch(const FlightKey& key, bool conditional);
+    void finish_fetch(const FlightKey& key, Hemirt::Utility::EchoPage::Page page);
+    void store(const FlightKey& key, Hemirt::Utility::EchoPage::Page&& page);
+    void erase(std::map<PageKey, Entry>::iterator it);
+    static std::size_t entry_size(const PageKey& key, const Entry& entry);
+
+    Hemirt::Utility::EchoPage& echo_page;
+    std::size_t max_bytes;
+    std::chrono::seconds stale_for;
+    Hemirt::Utility::EchoPage::Slice::Lines lines;
+
+    std::map<PageKey, Entry> entries;
+    // most recently used first
+    std::list<PageKey> lru;
+    std::size_t bytes = 0;
+    std::map<FlightKey, Flight> flights;
+    Stats stats;
+};
+
+#endif // PAGECACHE_HPP_
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef PERFECTHASH_HPP_
+#define PERFECTHASH_HPP_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace PerfectHash
+{
+
+constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed)
+{
+    // FNV-1a with the seed folded into the offset basis
+    std::uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (char c : key)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr std::size_t slot_count(std::size_t keys)
+{
+    return std::bit_ceil(keys * 2);
+}
+
+// collision-free slot table over a fixed key set, slots hold indexes into the caller's array
+template <std::size_t Slots>
+struct Table
+{
+    static constexpr std::uint8_t empty = 0xFF;
+
+    std::uint32_t seed = 0;
+    std::array<std::uint8_t, Slots> slots{};
+
+    // entry whose key equals key, or nullptr; one hash and one compare
+    template <typename T, std::size_t N>
+    constexpr const T* find(const std::array<T, N>& entries, std::string_view T::*key_member, std::string_view key) const
+    {
+        auto index = slots[hash(key, seed) & (Slots - 1)];
+        if (index == empty || entries[index].*key_member != key)
+        {
+            return nullptr;
+        }
+        return &entries[index];
+    }
+};
+
+// searches for a seed that maps every key to its own slot, evaluated at compile time
+template <typename T, std::size_t N>
+consteval Table<slot_count(N)> build(const std::array<T, N>& entries, std::string_view T::*key_member)
+{
+    static_assert(N < Table<slot_count(N)>::empty, "too many keys for 8-bit slot indexes");
+    constexpr std::size_t slots = slot_count(N);
+
+    for (std::uint32_t seed = 0; seed < 100000; ++seed)
+    {
+        Table<slots> table;
+        table.seed = seed;
+        table.slots.fill(Table<slots>::empty);
+
+        bool collision = false;
+        for (std::size_t i = 0; i < N && !collision; ++i)
+        {
+            auto& slot = table.slots[hash(entries[i].*key_member, seed) & (slots - 1)];
+            if (slot != Table<slots>::empty)
+            {
+                collision = true;
+            }
+            slot = static_cast<std::uint8_t>(i);
+        }
+
+        if (!collision)
+        {
+            return table;
+        }
+    }
+
+    throw std::logic_error("no perfect hash seed found");
+}
+
+}
+
+#endif // PERFECTHASH_HPP_
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "recentmessages.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+#include "logger.hpp"
+
+RecentMessages::RecentMessages(boost::asio::io_context& io_context, WorkStealingPool& worker_pool, ActionHandler on_action, std::chrono::milliseconds action_interval)
+    : io_context(io_context)
+    , worker_pool(worker_pool)
+    , on_action(std::move(on_action))
+    , action_interval(action_interval)
+    , action_timer(io_context)
+{
+}
+
+RecentMessages::Stripe& RecentMessages::stripe_for(std::string_view channel)
+{
+    return stripes[std::hash<std::string_view>{}(channel) % stripe_count];
+}
+
+void RecentMessages::add(std::size_t session, const IrcMessage& ircmessage)
+{
+    // a message without an id could never be deleted
+    if (ircmessage.message_id.empty())
+    {
+        return;
+    }
+
+    auto&& stripe = stripe_for(ircmessage.channel);
+    std::lock_guard lock(stripe.mutex);
+    auto it = stripe.channels.find(ircmessage.channel);
+    if (it == stripe.channels.end())
+    {
+        it = stripe.channels.try_emplace(std::string(ircmessage.channel)).first;
+    }
+    auto&& entries = it->second;
+    if (entries.size() >= max_per_channel)
+    {
+        entries.pop_front();
+    }
+    entries.push_back(Entry{ session, std::string(ircmessage.channel), std::string(ircmessage.message_id), std::string(ircmessage.user),
+        std::string(ircmessage.user_id), std::string(ircmessage.message) });
+}
+
+void RecentMessages::remove_message(std::string_view channel, std::string_view message_id)
+{
+    auto&& stripe = stripe_for(channel);
+    std::lock_guard lock(stripe.mutex);
+    if (auto it = stripe.channels.find(channel); it != stripe.channels.end())
+    {
+        std::erase_if(it->second, [&](const Entry& entry) { return entry.message_id == message_id; });
+    }
+}
+
+void RecentMessages::remove_user(std::string_view channel, std::string_view user_id)
+{
+    auto&& stripe = stripe_for(channel);
+    std::lock_guard lock(stripe.mutex);
+    if (auto it = stripe.channels.find(channel); it != stripe.channels.end())
+    {
+        std::erase_if(it->second, [&](const Entry& entry) { return entry.user_id == user_id; });
+    }
+}
+
+void RecentMessages::clear_channel(std::string_view channel)
+{
+    auto&& stripe = stripe_for(channel);
+    std::lock_guard lock(stripe.mutex);
+    if (auto it = stripe.channels.find(channel); it != stripe.channels.end())
+    {
+        stripe.channels.erase(it);
+    }
+}
+
+std::vector<RecentMessages::Entry> RecentMessages::snapshot() const
+{
+    std::vector<Entry> entries;
+    for (auto&& stripe : stripes)
+    {
+        std::lock_guard lock(stripe.mutex);
+        for (auto&& [channel, channel_entries] : stripe.channels)
+        {
+            entries.insert(entries.end(), channel_entries.begin(), channel_entries.end());
+        }
+    }
+    return entries;
+}
+
+std::size_t RecentMessages::size() const
+{
+    std::size_t size = 0;
+    for (auto&& stripe : stripes)
+    {
+        std::lock_guard lock(stripe.mutex);
+        for (auto&& [channel, entries] : stripe.channels)
+        {
+            size += entries.size();
+        }
+    }
+    return size;
+}
+
+std::size_t RecentMessages::queued_actions() const
+{
+    return actions.size();
+}
+
+void RecentMessages::rescan(std::shared_ptr<const CommandTables> tables)
+{
+    worker_pool.post([this, tables = std::move(tables), entries = snapshot()]() mutable
+    {
+        std::vector<Match> matches;
+        for (auto&& entry : entries)
+        {
+            if (auto timeout = tables->is_banphrased(entry.message, entry.channel); timeout != 0)
+            {
+                matches.push_back(Match{ std::move(entry), timeout });
+            }
+        }
+        return matches;
+    }, io_context.get_executor(), [this](std::vector<Match> matches)
+    {
+        log_info(LogCategory::Commands, "Rescan of recent messages found " + std::to_string(matches.size()) + " matches");
+        queue_actions(std::move(matches));
+    });
+}
+
+void RecentMessages::queue_actions(std::vector<Match>&& matches)
+{
+    for (auto&& match : matches)
+    {
+        // acted on once, a second rescan or the CLEARMSG that follows has nothing left to find
+        remove_message(match.entry.channel, match.entry.message_id);
+        if (actions.size() >= max_queued_actions)
+        {
+            continue;
+        }
+        actions.push_back(std::move(match));
+    }
+    if (!action_scheduled && !actions.empty())
+    {
+        action_scheduled = true;
+        schedule_action();
+    }
+}
+
+void RecentMessages::schedule_action()
+{
+    auto match = std::move(actions.front());
+    actions.pop_front();
+    on_action(match);
+
+    if (actions.empty())
+    {
+        action_scheduled = false;
+        return;
+    }
+    action_timer.expires_after(action_interval);
+    action_timer.async_wait([this](const boost::system::error_code& error)
+    {
+        if (error)
+        {
+            action_scheduled = false;
+            return;
+        }
+        schedule_action();
+    });
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef RECENTMESSAGES_HPP_
+#define RECENTMESSAGES_HPP_
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "commandshandler.hpp"
+#include "ircmessage.hpp"
+#include "workstealingpool.hpp"
+
+// the last messages of every channel, so a banphrase added during a raid also reaches what was already said;
+// a rescan runs on the worker pool and its matches are acted on one at a time from the io thread
+class RecentMessages
+{
+public:
+    struct Entry
+    {
+        std::size_t session;
+        std::string channel;
+        std::string message_id;
+        std::string user;
+        std::string user_id;
+        std::string message;
+    };
+    struct Match
+    {
+        Entry entry;
+        // seconds, -1 for a ban
+        int timeout;
+    };
+    // io thread
+    using ActionHandler = std::function<void(const Match& match)>;
+
+    RecentMessages(boost::asio::io_context& io_context, WorkStealingPool& worker_pool, ActionHandler on_action, std::chrono::milliseconds action_interval);
+    RecentMessages(const RecentMessages&) = delete;
+    RecentMessages& operator=(const RecentMessages&) = delete;
+
+    // any thread
+    void add(std::size_t session, const IrcMessage& ircmessage);
+    // CLEARMSG
+    void remove_message(std::string_view channel, std::string_view message_id);
+    // CLEARCHAT of a user
+    void remove_user(std::string_view channel, std::string_view user_id);
+    // CLEARCHAT of the whole channel
+    void clear_channel(std::string_view channel);
+
+    // io thread, checks every indexed message against tables
+    void rescan(std::shared_ptr<const CommandTables> tables);
+
+    std::size_t size() const;
+    std::size_t queued_actions() const;
+
+    static constexpr std::size_t max_per_channel = 200;
+    // pending actions past this are dropped, a rescan never floods the send queues
+    static constexpr std::size_t max_queued_actions = 2000;
+
+private:
+    // channels are spread over stripes so shards writing different channels rarely wait on each other
+    struct Stripe
+    {
+        mutable std::mutex mutex;
+        std::map<std::string, std::deque<Entry>, std::less<>> channels;
+    };
+    static constexpr std::size_t stripe_count = 16;
+    std::array<Stripe, stripe_count> stripes;
+    Stripe& stripe_for(std::string_view channel);
+    // copies every entry for a rescan
+    std::vector<Entry> snapshot() const;
+
+    boost::asio::io_context& io_context;
+    WorkStealingPool& worker_pool;
+    ActionHandler on_action;
+    std::chrono::milliseconds action_interval;
+
+    // io thread
+    std::deque<Match> actions;
+    boost::asio::steady_timer action_timer;
+    bool action_scheduled = false;
+    void queue_actions(std::vector<Match>&& matches);
+    void schedule_action();
+};
+
+#endif // RECENTMESSAGES_HPP_
\ No newline at end of file
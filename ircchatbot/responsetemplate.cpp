@@ -0,0 +1,212 @@
+#include "responsetemplate.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+ResponseTemplate::ResponseTemplate(std::string_view response, const std::set<std::string, std::less<>>& channels)
+    : source(response)
+{
+    auto add_literal = [&](std::size_t begin, std::size_t end)
+    {
+        if (end <= begin)
+        {
+            return;
+        }
+        // adjacent literals are merged
+        if (!segments.empty() && segments.back().kind == Kind::Literal && segments.back().begin + segments.back().length == begin)
+        {
+            segments.back().length += static_cast<std::uint32_t>(end - begin);
+        }
+        else
+        {
+            segments.push_back(Segment{ Kind::Literal, static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end - begin) });
+        }
+        literal_size += end - begin;
+    };
+
+    // the index after ${digits} at pos, 0 when there is none there
+    auto argument_end = [&](std::size_t pos, std::uint32_t& argument) -> std::size_t
+    {
+        if (source.compare(pos, 2, "${") != 0)
+        {
+            return 0;
+        }
+        auto digits_end = source.data() + source.size();
+        auto [end, error] = std::from_chars(source.data() + pos + 2, digits_end, argument);
+        if (error != std::errc() || end == digits_end || *end != '}')
+        {
+            return 0;
+        }
+        return static_cast<std::size_t>(end - source.data()) + 1;
+    };
+
+    std::size_t literal_begin = 0;
+    // inside $url{ or $json{, the next } that does not end a ${n} closes it
+    bool in_fetch = false;
+    // the last comma of the $json{ at hand, npos for none
+    std::size_t path_comma = std::string::npos;
+    std::size_t i = 0;
+    while (i < source.size())
+    {
+        std::string_view rest(source.data() + i, source.size() - i);
+        if (std::uint32_t argument = 0; auto end = argument_end(i, argument))
+        {
+            add_literal(literal_begin, i);
+            segments.push_back(Segment{ Kind::Argument, 0, 0, argument });
+            max_argument = std::max(max_argument, static_cast<int>(argument));
+            i = end;
+            literal_begin = i;
+            continue;
+        }
+        else if (!in_fetch && (rest.starts_with("$url{") || rest.starts_with("$json{")))
+        {
+            auto json = rest.starts_with("$json{");
+            auto open = i + (json ? 6 : 5);
+            auto close = std::string::npos;
+            path_comma = std::string::npos;
+            for (auto j = open; j < source.size(); ++j)
+            {
+                std::uint32_t skipped = 0;
+                if (auto end = argument_end(j, skipped))
+                {
+                    j = end - 1;
+                }
+                else if (source[j] == '}')
+                {
+                    close = j;
+                    break;
+                }
+                else if (json && source[j] == ',')
+                {
+                    // a url may hold commas of its own, a path never does
+                    path_comma = j;
+                }
+            }
+            // an unclosed or empty placeholder is literal text, as it never matched before
+            if (close != std::string::npos && close > open)
+            {
+                add_literal(literal_begin, i);
+                segments.push_back(Segment{ json ? Kind::JsonBegin : Kind::UrlBegin });
+                fetches = true;
+                in_fetch = true;
+                i = open;
+                literal_begin = i;
+                continue;
+            }
+        }
+        else if (in_fetch && i == path_comma)
+        {
+            add_literal(literal_begin, i);
+            segments.push_back(Segment{ Kind::JsonPath });
+            ++i;
+            literal_begin = i;
+            continue;
+        }
+        else if (in_fetch && rest.front() == '}')
+        {
+            add_literal(literal_begin, i);
+            segments.push_back(Segment{ Kind::FetchEnd });
+            in_fetch = false;
+            ++i;
+            literal_begin = i;
+            continue;
+        }
+        ++i;
+    }
+    add_literal(literal_begin, source.size());
+
+    if (!is_static())
+    {
+        return;
+    }
+    for (auto&& channel : channels)
+    {
+        std::string line;
+        line.reserve(channel.size() + source.size() + 11);
+        line += "PRIVMSG #";
+        line += channel;
+        line += " :";
+        line += source;
+        frames.emplace_hint(frames.end(), channel, std::move(line));
+    }
+}
+
+bool ResponseTemplate::render(std::string_view message, ResponsePieces& out) const
+{
+    // only as many words as the highest argument are split off
+    std::vector<std::string_view> words;
+    if (max_argument >= 0)
+    {
+        words.reserve(static_cast<std::size_t>(max_argument) + 1);
+        std::size_t pos = 0;
+        while (words.size() <= static_cast<std::size_t>(max_argument))
+        {
+            pos = message.find_first_not_of(' ', pos);
+            if (pos == std::string_view::npos)
+            {
+                return false;
+            }
+            auto end = message.find(' ', pos);
+            words.push_back(message.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos));
+            pos = end;
+        }
+    }
+
+    out.texts.assign(1, std::string());
+    out.fetches.clear();
+    // the last text, or the url or path of the last fetch
+    auto target = &out.texts.back();
+    target->reserve(literal_size + (words.empty() ? 0 : message.size()));
+    for (auto&& segment : segments)
+    {
+        switch (segment.kind)
+        {
+        case Kind::Literal:
+            target->append(source, segment.begin, segment.length);
+            break;
+        case Kind::Argument:
+            target->append(words[segment.argument]);
+            break;
+        case Kind::UrlBegin:
+            target = &out.fetches.emplace_back().url;
+            break;
+        case Kind::JsonBegin:
+            // no path is the whole document
+            out.fetches.emplace_back().json_path = "$";
+            target = &out.fetches.back().url;
+            break;
+        case Kind::JsonPath:
+            out.fetches.back().json_path.clear();
+            target = &out.fetches.back().json_path;
+            break;
+        case Kind::FetchEnd:
+            target = &out.texts.emplace_back();
+            break;
+        }
+    }
+    return true;
+}
+
+const std::string& ResponseTemplate::get_source() const
+{
+    return source;
+}
+
+bool ResponseTemplate::has_fetches() const
+{
+    return fetches;
+}
+
+bool ResponseTemplate::is_static() const
+{
+    return max_argument < 0 && !fetches;
+}
+
+std::string ResponseTemplate::frame(std::string_view channel) const
+{
+    if (auto it = frames.find(channel); it != frames.end())
+    {
+        return it->second;
+    }
+    return {};
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef RESPONSETEMPLATE_HPP_
+#define RESPONSETEMPLATE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FetchPlaceholder
+{
+    // empty is never fetched
+    std::string url;
+    // empty for $url{}, the JSON path of $json{}
+    std::string json_path;
+};
+
+// a rendered response around its fetches, every fetch goes between the texts of the same index and the next
+struct ResponsePieces
+{
+    std::vector<std::string> texts;
+    std::vector<FetchPlaceholder> fetches;
+};
+
+// a text command response parsed once into literal segments and typed placeholders:
+// ${n} is the nth word of the triggering message, ${0} the trigger, $url{...} a page
+// fetched after rendering whose url may itself contain ${n}, and $json{url, path} one value of a JSON page
+class ResponseTemplate
+{
+public:
+    // a static response has its PRIVMSG line built for each of channels
+    explicit ResponseTemplate(std::string_view response, const std::set<std::string, std::less<>>& channels = {});
+    ResponseTemplate(const ResponseTemplate&) = delete;
+    ResponseTemplate& operator=(const ResponseTemplate&) = delete;
+
+    enum class Kind : std::uint8_t
+    {
+        Literal,
+        Argument,
+        UrlBegin,
+        JsonBegin,
+        // the comma of $json{url, path}, what follows is the path
+        JsonPath,
+        FetchEnd,
+    };
+    struct Segment
+    {
+        Kind kind;
+        // Literal, into source
+        std::uint32_t begin = 0;
+        std::uint32_t length = 0;
+        // Argument
+        std::uint32_t argument = 0;
+    };
+
+    // fills out with the response, false when the message has fewer words than an argument needs;
+    // words only ever land in a text, url or path and are never read as placeholders themselves
+    bool render(std::string_view message, ResponsePieces& out) const;
+
+    const std::string& get_source() const;
+    bool has_fetches() const;
+    // no arguments and no fetches, the response is the source
+    bool is_static() const;
+
+    // PRIVMSG line of a static response, empty for a channel it was not built for
+    std::string frame(std::string_view channel) const;
+
+private:
+    std::string source;
+    std::vector<Segment> segments;
+    // -1 without arguments
+    int max_argument = -1;
+    bool fetches = false;
+    // bytes of the literal segments, reserved up front by render
+    std::size_t literal_size = 0;
+
+    // by channel, never modified after construction so shards read it without locking
+    std::map<std::string, std::string, std::less<>> frames;
+};
+
+#endif // RESPONSETEMPLATE_HPP_
\ No newline at end of file
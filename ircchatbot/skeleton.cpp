@@ -0,0 +1,348 @@
+#include "skeleton.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    struct Folding
+    {
+        char32_t code_point;
+        std::string_view text;
+    };
+
+    // U+0080..U+07FF: latin-1, latin extended, ipa, greek and cyrillic, from their compatibility
+    // decompositions without marks plus the look-alikes that have none
+    constexpr std::array<Folding, 439> two_byte_foldings{ {
+        { 0x00A1, "i" }, { 0x00A2, "c" }, { 0x00A5, "Y" }, { 0x00AA, "a" }, { 0x00B2, "2" }, { 0x00B3, "3" }, { 0x00B5, "u" }, { 0x00B9, "1" },
+        { 0x00BA, "o" }, { 0x00C0, "A" }, { 0x00C1, "A" }, { 0x00C2, "A" }, { 0x00C3, "A" }, { 0x00C4, "A" }, { 0x00C5, "A" }, { 0x00C6, "AE" },
+        { 0x00C7, "C" }, { 0x00C8, "E" }, { 0x00C9, "E" }, { 0x00CA, "E" }, { 0x00CB, "E" }, { 0x00CC, "I" }, { 0x00CD, "I" }, { 0x00CE, "I" },
+        { 0x00CF, "I" }, { 0x00D0, "D" }, { 0x00D1, "N" }, { 0x00D2, "O" }, { 0x00D3, "O" }, { 0x00D4, "O" }, { 0x00D5, "O" }, { 0x00D6, "O" },
+        { 0x00D7, "x" }, { 0x00D8, "O" }, { 0x00D9, "U" }, { 0x00DA, "U" }, { 0x00DB, "U" }, { 0x00DC, "U" }, { 0x00DD, "Y" }, { 0x00DE, "P" },
+        { 0x00DF, "ss" }, { 0x00E0, "a" }, { 0x00E1, "a" }, { 0x00E2, "a" }, { 0x00E3, "a" }, { 0x00E4, "a" }, { 0x00E5, "a" }, { 0x00E6, "ae" },
+        { 0x00E7, "c" }, { 0x00E8, "e" }, { 0x00E9, "e" }, { 0x00EA, "e" }, { 0x00EB, "e" }, { 0x00EC, "i" }, { 0x00ED, "i" }, { 0x00EE, "i" },
+        { 0x00EF, "i" }, { 0x00F0, "d" }, { 0x00F1, "n" }, { 0x00F2, "o" }, { 0x00F3, "o" }, { 0x00F4, "o" }, { 0x00F5, "o" }, { 0x00F6, "o" },
+        { 0x00F8, "o" }, { 0x00F9, "u" }, { 0x00FA, "u" }, { 0x00FB, "u" }, { 0x00FC, "u" }, { 0x00FD, "y" }, { 0x00FE, "p" }, { 0x00FF, "y" },
+        { 0x0100, "A" }, { 0x0101, "a" }, { 0x0102, "A" }, { 0x0103, "a" }, { 0x0104, "A" }, { 0x0105, "a" }, { 0x0106, "C" }, { 0x0107, "c" },
+        { 0x0108, "C" }, { 0x0109, "c" }, { 0x010A, "C" }, { 0x010B, "c" }, { 0x010C, "C" }, { 0x010D, "c" }, { 0x010E, "D" }, { 0x010F, "d" },
+        { 0x0110, "D" }, { 0x0111, "d" }, { 0x0112, "E" }, { 0x0113, "e" }, { 0x0114, "E" }, { 0x0115, "e" }, { 0x0116, "E" }, { 0x0117, "e" },
+        { 0x0118, "E" }, { 0x0119, "e" }, { 0x011A, "E" }, { 0x011B, "e" }, { 0x011C, "G" }, { 0x011D, "g" }, { 0x011E, "G" }, { 0x011F, "g" },
+        { 0x0120, "G" }, { 0x0121, "g" }, { 0x0122, "G" }, { 0x0123, "g" }, { 0x0124, "H" }, { 0x0125, "h" }, { 0x0126, "H" }, { 0x0127, "h" },
+        { 0x0128, "I" }, { 0x0129, "i" }, { 0x012A, "I" }, { 0x012B, "i" }, { 0x012C, "I" }, { 0x012D, "i" }, { 0x012E, "I" }, { 0x012F, "i" },
+        { 0x0130, "I" }, { 0x0131, "i" }, { 0x0132, "IJ" }, { 0x0133, "ij" }, { 0x0134, "J" }, { 0x0135, "j" }, { 0x0136, "K" }, { 0x0137, "k" },
+        { 0x0138, "k" }, { 0x0139, "L" }, { 0x013A, "l" }, { 0x013B, "L" }, { 0x013C, "l" }, { 0x013D, "L" }, { 0x013E, "l" }, { 0x013F, "L" },
+        { 0x0140, "l" }, { 0x0141, "L" }, { 0x0142, "l" }, { 0x0143, "N" }, { 0x0144, "n" }, { 0x0145, "N" }, { 0x0146, "n" }, { 0x0147, "N" },
+        { 0x0148, "n" }, { 0x014A, "N" }, { 0x014B, "n" }, { 0x014C, "O" }, { 0x014D, "o" }, { 0x014E, "O" }, { 0x014F, "o" }, { 0x0150, "O" },
+        { 0x0151, "o" }, { 0x0152, "OE" }, { 0x0153, "oe" }, { 0x0154, "R" }, { 0x0155, "r" }, { 0x0156, "R" }, { 0x0157, "r" }, { 0x0158, "R" },
+        { 0x0159, "r" }, { 0x015A, "S" }, { 0x015B, "s" }, { 0x015C, "S" }, { 0x015D, "s" }, { 0x015E, "S" }, { 0x015F, "s" }, { 0x0160, "S" },
+        { 0x0161, "s" }, { 0x0162, "T" }, { 0x0163, "t" }, { 0x0164, "T" }, { 0x0165, "t" }, { 0x0166, "T" }, { 0x0167, "t" }, { 0x0168, "U" },
+        { 0x0169, "u" }, { 0x016A, "U" }, { 0x016B, "u" }, { 0x016C, "U" }, { 0x016D, "u" }, { 0x016E, "U" }, { 0x016F, "u" }, { 0x0170, "U" },
+        { 0x0171, "u" }, { 0x0172, "U" }, { 0x0173, "u" }, { 0x0174, "W" }, { 0x0175, "w" }, { 0x0176, "Y" }, { 0x0177, "y" }, { 0x0178, "Y" },
+        { 0x0179, "Z" }, { 0x017A, "z" }, { 0x017B, "Z" }, { 0x017C, "z" }, { 0x017D, "Z" }, { 0x017E, "z" }, { 0x017F, "s" }, { 0x0180, "b" },
+        { 0x01A0, "O" }, { 0x01A1, "o" }, { 0x01AF, "U" }, { 0x01B0, "u" }, { 0x01C4, "DZ" }, { 0x01C5, "Dz" }, { 0x01C6, "dz" }, { 0x01C7, "LJ" },
+        { 0x01C8, "Lj" }, { 0x01C9, "lj" }, { 0x01CA, "NJ" }, { 0x01CB, "Nj" }, { 0x01CC, "nj" }, { 0x01CD, "A" }, { 0x01CE, "a" }, { 0x01CF, "I" },
+        { 0x01D0, "i" }, { 0x01D1, "O" }, { 0x01D2, "o" }, { 0x01D3, "U" }, { 0x01D4, "u" }, { 0x01D5, "U" }, { 0x01D6, "u" }, { 0x01D7, "U" },
+        { 0x01D8, "u" }, { 0x01D9, "U" }, { 0x01DA, "u" }, { 0x01DB, "U" }, { 0x01DC, "u" }, { 0x01DE, "A" }, { 0x01DF, "a" }, { 0x01E0, "A" },
+        { 0x01E1, "a" }, { 0x01E2, "AE" }, { 0x01E3, "ae" }, { 0x01E6, "G" }, { 0x01E7, "g" }, { 0x01E8, "K" }, { 0x01E9, "k" }, { 0x01EA, "O" },
+        { 0x01EB, "o" }, { 0x01EC, "O" }, { 0x01ED, "o" }, { 0x01F0, "j" }, { 0x01F1, "DZ" }, { 0x01F2, "Dz" }, { 0x01F3, "dz" }, { 0x01F4, "G" },
+        { 0x01F5, "g" }, { 0x01F8, "N" }, { 0x01F9, "n" }, { 0x01FA, "A" }, { 0x01FB, "a" }, { 0x01FC, "AE" }, { 0x01FD, "ae" }, { 0x01FE, "O" },
+        { 0x01FF, "o" }, { 0x0200, "A" }, { 0x0201, "a" }, { 0x0202, "A" }, { 0x0203, "a" }, { 0x0204, "E" }, { 0x0205, "e" }, { 0x0206, "E" },
+        { 0x0207, "e" }, { 0x0208, "I" }, { 0x0209, "i" }, { 0x020A, "I" }, { 0x020B, "i" }, { 0x020C, "O" }, { 0x020D, "o" }, { 0x020E, "O" },
+        { 0x020F, "o" }, { 0x0210, "R" }, { 0x0211, "r" }, { 0x0212, "R" }, { 0x0213, "r" }, { 0x0214, "U" }, { 0x0215, "u" }, { 0x0216, "U" },
+        { 0x0217, "u" }, { 0x0218, "S" }, { 0x0219, "s" }, { 0x021A, "T" }, { 0x021B, "t" }, { 0x021E, "H" }, { 0x021F, "h" }, { 0x0226, "A" },
+        { 0x0227, "a" }, { 0x0228, "E" }, { 0x0229, "e" }, { 0x022A, "O" }, { 0x022B, "o" }, { 0x022C, "O" }, { 0x022D, "o" }, { 0x022E, "O" },
+        { 0x022F, "o" }, { 0x0230, "O" }, { 0x0231, "o" }, { 0x0232, "Y" }, { 0x0233, "y" }, { 0x0251, "a" }, { 0x0261, "g" }, { 0x0269, "i" },
+        { 0x026A, "i" }, { 0x0274, "n" }, { 0x0280, "r" }, { 0x028F, "y" }, { 0x029C, "h" }, { 0x029F, "l" }, { 0x02B0, "h" }, { 0x02B2, "j" },
+        { 0x02B3, "r" }, { 0x02B7, "w" }, { 0x02B8, "y" }, { 0x02E1, "l" }, { 0x02E2, "s" }, { 0x02E3, "x" }, { 0x037F, "J" }, { 0x0386, "A" },
+        { 0x0388, "E" }, { 0x0389, "H" }, { 0x038A, "I" }, { 0x038C, "O" }, { 0x038E, "Y" }, { 0x0390, "i" }, { 0x0391, "A" }, { 0x0392, "B" },
+        { 0x0395, "E" }, { 0x0396, "Z" }, { 0x0397, "H" }, { 0x0399, "I" }, { 0x039A, "K" }, { 0x039C, "M" }, { 0x039D, "N" }, { 0x039F, "O" },
+        { 0x03A1, "P" }, { 0x03A4, "T" }, { 0x03A5, "Y" }, { 0x03A7, "X" }, { 0x03AA, "I" }, { 0x03AB, "Y" }, { 0x03AC, "a" }, { 0x03AD, "e" },
+        { 0x03AF, "i" }, { 0x03B0, "u" }, { 0x03B1, "a" }, { 0x03B3, "y" }, { 0x03B5, "e" }, { 0x03B9, "i" }, { 0x03BA, "k" }, { 0x03BD, "v" },
+        { 0x03BF, "o" }, { 0x03C1, "p" }, { 0x03C2, "s" }, { 0x03C4, "t" }, { 0x03C5, "u" }, { 0x03C7, "x" }, { 0x03C9, "w" }, { 0x03CA, "i" },
+        { 0x03CB, "u" }, { 0x03CC, "o" }, { 0x03CD, "u" }, { 0x03CE, "w" }, { 0x03D2, "Y" }, { 0x03D3, "Y" }, { 0x03D4, "Y" }, { 0x03F0, "k" },
+        { 0x03F1, "p" }, { 0x03F2, "c" }, { 0x03F3, "j" }, { 0x03F5, "e" }, { 0x03F9, "C" }, { 0x0400, "E" }, { 0x0401, "E" }, { 0x0405, "S" },
+        { 0x0406, "I" }, { 0x0407, "I" }, { 0x0408, "J" }, { 0x040C, "K" }, { 0x040E, "Y" }, { 0x0410, "A" }, { 0x0412, "B" }, { 0x0415, "E" },
+        { 0x041A, "K" }, { 0x041C, "M" }, { 0x041D, "H" }, { 0x041E, "O" }, { 0x0420, "P" }, { 0x0421, "C" }, { 0x0422, "T" }, { 0x0423, "Y" },
+        { 0x0425, "X" }, { 0x0430, "a" }, { 0x0433, "r" }, { 0x0435, "e" }, { 0x043A, "k" }, { 0x043C, "m" }, { 0x043E, "o" }, { 0x043F, "n" },
+        { 0x0440, "p" }, { 0x0441, "c" }, { 0x0443, "y" }, { 0x0445, "x" }, { 0x044C, "b" }, { 0x0450, "e" }, { 0x0451, "e" }, { 0x0453, "r" },
+        { 0x0455, "s" }, { 0x0456, "i" }, { 0x0457, "i" }, { 0x0458, "j" }, { 0x045C, "k" }, { 0x045E, "y" }, { 0x04AE, "Y" }, { 0x04AF, "y" },
+        { 0x04BB, "h" }, { 0x04C0, "I" }, { 0x04CF, "l" }, { 0x04D0, "A" }, { 0x04D1, "a" }, { 0x04D2, "A" }, { 0x04D3, "a" }, { 0x04D6, "E" },
+        { 0x04D7, "e" }, { 0x04E6, "O" }, { 0x04E7, "o" }, { 0x04EE, "Y" }, { 0x04EF, "y" }, { 0x04F0, "Y" }, { 0x04F1, "y" }, { 0x04F2, "Y" },
+        { 0x04F3, "y" }, { 0x0500, "d" }, { 0x0501, "d" }, { 0x051A, "Q" }, { 0x051B, "q" }, { 0x051C, "W" }, { 0x051D, "w" },
+    } };
+
+    // sorted: phonetic extensions, latin extended additional, super and subscripts, letterlike symbols, number forms
+    constexpr std::array<Folding, 390> wide_foldings{ {
+        { 0x1D00, "A" }, { 0x1D2C, "A" }, { 0x1D2D, "AE" }, { 0x1D2E, "B" }, { 0x1D30, "D" }, { 0x1D31, "E" }, { 0x1D33, "G" }, { 0x1D34, "H" },
+        { 0x1D35, "I" }, { 0x1D36, "J" }, { 0x1D37, "K" }, { 0x1D38, "L" }, { 0x1D39, "M" }, { 0x1D3A, "N" }, { 0x1D3C, "O" }, { 0x1D3E, "P" },
+        { 0x1D3F, "R" }, { 0x1D40, "T" }, { 0x1D41, "U" }, { 0x1D42, "W" }, { 0x1D43, "a" }, { 0x1D45, "a" }, { 0x1D47, "b" }, { 0x1D48, "d" },
+        { 0x1D49, "e" }, { 0x1D4D, "g" }, { 0x1D4F, "k" }, { 0x1D50, "m" }, { 0x1D51, "n" }, { 0x1D52, "o" }, { 0x1D56, "p" }, { 0x1D57, "t" },
+        { 0x1D58, "u" }, { 0x1D5B, "v" }, { 0x1D5E, "y" }, { 0x1D61, "x" }, { 0x1D62, "i" }, { 0x1D63, "r" }, { 0x1D64, "u" }, { 0x1D65, "v" },
+        { 0x1D67, "y" }, { 0x1D68, "p" }, { 0x1D6A, "x" }, { 0x1D9C, "c" }, { 0x1D9E, "d" }, { 0x1DA0, "f" }, { 0x1DA2, "g" }, { 0x1DA5, "i" },
+        { 0x1DA6, "i" }, { 0x1DAB, "l" }, { 0x1DB0, "n" }, { 0x1DBB, "z" }, { 0x1E00, "A" }, { 0x1E01, "a" }, { 0x1E02, "B" }, { 0x1E03, "b" },
+        { 0x1E04, "B" }, { 0x1E05, "b" }, { 0x1E06, "B" }, { 0x1E07, "b" }, { 0x1E08, "C" }, { 0x1E09, "c" }, { 0x1E0A, "D" }, { 0x1E0B, "d" },
+        { 0x1E0C, "D" }, { 0x1E0D, "d" }, { 0x1E0E, "D" }, { 0x1E0F, "d" }, { 0x1E10, "D" }, { 0x1E11, "d" }, { 0x1E12, "D" }, { 0x1E13, "d" },
+        { 0x1E14, "E" }, { 0x1E15, "e" }, { 0x1E16, "E" }, { 0x1E17, "e" }, { 0x1E18, "E" }, { 0x1E19, "e" }, { 0x1E1A, "E" }, { 0x1E1B, "e" },
+        { 0x1E1C, "E" }, { 0x1E1D, "e" }, { 0x1E1E, "F" }, { 0x1E1F, "f" }, { 0x1E20, "G" }, { 0x1E21, "g" }, { 0x1E22, "H" }, { 0x1E23, "h" },
+        { 0x1E24, "H" }, { 0x1E25, "h" }, { 0x1E26, "H" }, { 0x1E27, "h" }, { 0x1E28, "H" }, { 0x1E29, "h" }, { 0x1E2A, "H" }, { 0x1E2B, "h" },
+        { 0x1E2C, "I" }, { 0x1E2D, "i" }, { 0x1E2E, "I" }, { 0x1E2F, "i" }, { 0x1E30, "K" }, { 0x1E31, "k" }, { 0x1E32, "K" }, { 0x1E33, "k" },
+        { 0x1E34, "K" }, { 0x1E35, "k" }, { 0x1E36, "L" }, { 0x1E37, "l" }, { 0x1E38, "L" }, { 0x1E39, "l" }, { 0x1E3A, "L" }, { 0x1E3B, "l" },
+        { 0x1E3C, "L" }, { 0x1E3D, "l" }, { 0x1E3E, "M" }, { 0x1E3F, "m" }, { 0x1E40, "M" }, { 0x1E41, "m" }, { 0x1E42, "M" }, { 0x1E43, "m" },
+        { 0x1E44, "N" }, { 0x1E45, "n" }, { 0x1E46, "N" }, { 0x1E47, "n" }, { 0x1E48, "N" }, { 0x1E49, "n" }, { 0x1E4A, "N" }, { 0x1E4B, "n" },
+        { 0x1E4C, "O" }, { 0x1E4D, "o" }, { 0x1E4E, "O" }, { 0x1E4F, "o" }, { 0x1E50, "O" }, { 0x1E51, "o" }, { 0x1E52, "O" }, { 0x1E53, "o" },
+        { 0x1E54, "P" }, { 0x1E55, "p" }, { 0x1E56, "P" }, { 0x1E57, "p" }, { 0x1E58, "R" }, { 0x1E59, "r" }, { 0x1E5A, "R" }, { 0x1E5B, "r" },
+        { 0x1E5C, "R" }, { 0x1E5D, "r" }, { 0x1E5E, "R" }, { 0x1E5F, "r" }, { 0x1E60, "S" }, { 0x1E61, "s" }, { 0x1E62, "S" }, { 0x1E63, "s" },
+        { 0x1E64, "S" }, { 0x1E65, "s" }, { 0x1E66, "S" }, { 0x1E67, "s" }, { 0x1E68, "S" }, { 0x1E69, "s" }, { 0x1E6A, "T" }, { 0x1E6B, "t" },
+        { 0x1E6C, "T" }, { 0x1E6D, "t" }, { 0x1E6E, "T" }, { 0x1E6F, "t" }, { 0x1E70, "T" }, { 0x1E71, "t" }, { 0x1E72, "U" }, { 0x1E73, "u" },
+        { 0x1E74, "U" }, { 0x1E75, "u" }, { 0x1E76, "U" }, { 0x1E77, "u" }, { 0x1E78, "U" }, { 0x1E79, "u" }, { 0x1E7A, "U" }, { 0x1E7B, "u" },
+        { 0x1E7C, "V" }, { 0x1E7D, "v" }, { 0x1E7E, "V" }, { 0x1E7F, "v" }, { 0x1E80, "W" }, { 0x1E81, "w" }, { 0x1E82, "W" }, { 0x1E83, "w" },
+        { 0x1E84, "W" }, { 0x1E85, "w" }, { 0x1E86, "W" }, { 0x1E87, "w" }, { 0x1E88, "W" }, { 0x1E89, "w" }, { 0x1E8A, "X" }, { 0x1E8B, "x" },
+        { 0x1E8C, "X" }, { 0x1E8D, "x" }, { 0x1E8E, "Y" }, { 0x1E8F, "y" }, { 0x1E90, "Z" }, { 0x1E91, "z" }, { 0x1E92, "Z" }, { 0x1E93, "z" },
+        { 0x1E94, "Z" }, { 0x1E95, "z" }, { 0x1E96, "h" }, { 0x1E97, "t" }, { 0x1E98, "w" }, { 0x1E99, "y" }, { 0x1E9B, "s" }, { 0x1EA0, "A" },
+        { 0x1EA1, "a" }, { 0x1EA2, "A" }, { 0x1EA3, "a" }, { 0x1EA4, "A" }, { 0x1EA5, "a" }, { 0x1EA6, "A" }, { 0x1EA7, "a" }, { 0x1EA8, "A" },
+        { 0x1EA9, "a" }, { 0x1EAA, "A" }, { 0x1EAB, "a" }, { 0x1EAC, "A" }, { 0x1EAD, "a" }, { 0x1EAE, "A" }, { 0x1EAF, "a" }, { 0x1EB0, "A" },
+        { 0x1EB1, "a" }, { 0x1EB2, "A" }, { 0x1EB3, "a" }, { 0x1EB4, "A" }, { 0x1EB5, "a" }, { 0x1EB6, "A" }, { 0x1EB7, "a" }, { 0x1EB8, "E" },
+        { 0x1EB9, "e" }, { 0x1EBA, "E" }, { 0x1EBB, "e" }, { 0x1EBC, "E" }, { 0x1EBD, "e" }, { 0x1EBE, "E" }, { 0x1EBF, "e" }, { 0x1EC0, "E" },
+        { 0x1EC1, "e" }, { 0x1EC2, "E" }, { 0x1EC3, "e" }, { 0x1EC4, "E" }, { 0x1EC5, "e" }, { 0x1EC6, "E" }, { 0x1EC7, "e" }, { 0x1EC8, "I" },
+        { 0x1EC9, "i" }, { 0x1ECA, "I" }, { 0x1ECB, "i" }, { 0x1ECC, "O" }, { 0x1ECD, "o" }, { 0x1ECE, "O" }, { 0x1ECF, "o" }, { 0x1ED0, "O" },
+        { 0x1ED1, "o" }, { 0x1ED2, "O" }, { 0x1ED3, "o" }, { 0x1ED4, "O" }, { 0x1ED5, "o" }, { 0x1ED6, "O" }, { 0x1ED7, "o" }, { 0x1ED8, "O" },
+        { 0x1ED9, "o" }, { 0x1EDA, "O" }, { 0x1EDB, "o" }, { 0x1EDC, "O" }, { 0x1EDD, "o" }, { 0x1EDE, "O" }, { 0x1EDF, "o" }, { 0x1EE0, "O" },
+        { 0x1EE1, "o" }, { 0x1EE2, "O" }, { 0x1EE3, "o" }, { 0x1EE4, "U" }, { 0x1EE5, "u" }, { 0x1EE6, "U" }, { 0x1EE7, "u" }, { 0x1EE8, "U" },
+        { 0x1EE9, "u" }, { 0x1EEA, "U" }, { 0x1EEB, "u" }, { 0x1EEC, "U" }, { 0x1EED, "u" }, { 0x1EEE, "U" }, { 0x1EEF, "u" }, { 0x1EF0, "U" },
+        { 0x1EF1, "u" }, { 0x1EF2, "Y" }, { 0x1EF3, "y" }, { 0x1EF4, "Y" }, { 0x1EF5, "y" }, { 0x1EF6, "Y" }, { 0x1EF7, "y" }, { 0x1EF8, "Y" },
+        { 0x1EF9, "y" }, { 0x2070, "0" }, { 0x2071, "i" }, { 0x2074, "4" }, { 0x2075, "5" }, { 0x2076, "6" }, { 0x2077, "7" }, { 0x2078, "8" },
+        { 0x2079, "9" }, { 0x207F, "n" }, { 0x2080, "0" }, { 0x2081, "1" }, { 0x2082, "2" }, { 0x2083, "3" }, { 0x2084, "4" }, { 0x2085, "5" },
+        { 0x2086, "6" }, { 0x2087, "7" }, { 0x2088, "8" }, { 0x2089, "9" }, { 0x2090, "a" }, { 0x2091, "e" }, { 0x2092, "o" }, { 0x2093, "x" },
+        { 0x2095, "h" }, { 0x2096, "k" }, { 0x2097, "l" }, { 0x2098, "m" }, { 0x2099, "n" }, { 0x209A, "p" }, { 0x209B, "s" }, { 0x209C, "t" },
+        { 0x2102, "C" }, { 0x210A, "g" }, { 0x210B, "H" }, { 0x210C, "H" }, { 0x210D, "H" }, { 0x210E, "h" }, { 0x210F, "h" }, { 0x2110, "I" },
+        { 0x2111, "I" }, { 0x2112, "L" }, { 0x2113, "l" }, { 0x2115, "N" }, { 0x2116, "No" }, { 0x2119, "P" }, { 0x211A, "Q" }, { 0x211B, "R" },
+        { 0x211C, "R" }, { 0x211D, "R" }, { 0x2120, "SM" }, { 0x2122, "TM" }, { 0x2124, "Z" }, { 0x2128, "Z" }, { 0x212A, "K" }, { 0x212B, "A" },
+        { 0x212C, "B" }, { 0x212D, "C" }, { 0x212F, "e" }, { 0x2130, "E" }, { 0x2131, "F" }, { 0x2133, "M" }, { 0x2134, "o" }, { 0x2139, "i" },
+        { 0x213D, "y" }, { 0x2145, "D" }, { 0x2146, "d" }, { 0x2147, "e" }, { 0x2148, "i" }, { 0x2149, "j" }, { 0x2160, "I" }, { 0x2161, "II" },
+        { 0x2163, "IV" }, { 0x2164, "V" }, { 0x2165, "VI" }, { 0x2168, "IX" }, { 0x2169, "X" }, { 0x216A, "XI" }, { 0x216C, "L" }, { 0x216D, "C" },
+        { 0x216E, "D" }, { 0x216F, "M" }, { 0x2170, "i" }, { 0x2171, "ii" }, { 0x2173, "iv" }, { 0x2174, "v" }, { 0x2175, "vi" }, { 0x2178, "ix" },
+        { 0x2179, "x" }, { 0x217A, "xi" }, { 0x217C, "l" }, { 0x217D, "c" }, { 0x217E, "d" }, { 0x217F, "m" },
+    } };
+    static_assert(std::ranges::is_sorted(wide_foldings, {}, &Folding::code_point));
+
+    struct Span
+    {
+        char32_t first;
+        char32_t last;
+    };
+
+    // zero width, bidi controls, variation selectors, invisible fillers, tags and combining marks
+    constexpr std::array<Span, 20> dropped{ {
+        { 0x00AD, 0x00AD }, { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x061C, 0x061C }, { 0x115F, 0x1160 },
+        { 0x17B4, 0x17B5 }, { 0x180B, 0x180F }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F },
+        { 0x202A, 0x202E }, { 0x2060, 0x206F }, { 0x20D0, 0x20FF }, { 0x3164, 0x3164 }, { 0xFE00, 0xFE0F },
+        { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0xFFA0, 0xFFA0 }, { 0xE0000, 0xE007F }, { 0xE0100, 0xE01EF },
+    } };
+
+    constexpr std::array<Span, 6> spaces{ {
+        { 0x00A0, 0x00A0 }, { 0x1680, 0x1680 }, { 0x2000, 0x200A }, { 0x202F, 0x202F }, { 0x205F, 0x205F }, { 0x3000, 0x3000 },
+    } };
+
+    // blocks that repeat an alphabet, folded by the offset into the block
+    struct Alphabet
+    {
+        char32_t first;
+        char32_t last;
+        std::string_view letters;
+    };
+    constexpr std::string_view upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    constexpr std::string_view lower = "abcdefghijklmnopqrstuvwxyz";
+    constexpr std::string_view both = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    constexpr std::string_view digits = "0123456789";
+    constexpr std::string_view printable = "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+    constexpr std::array<Alphabet, 14> alphabets{ {
+        { 0x2460, 0x2468, "123456789" },
+        { 0x2474, 0x247C, "123456789" },
+        { 0x2488, 0x2490, "123456789" },
+        { 0x249C, 0x24B5, lower },
+        { 0x24B6, 0x24CF, upper },
+        { 0x24D0, 0x24E9, lower },
+        { 0xFF01, 0xFF5E, printable },
+        { 0x1D400, 0x1D6A3, both },
+        { 0x1D7CE, 0x1D7FF, digits },
+        { 0x1F130, 0x1F149, upper },
+        { 0x1F150, 0x1F169, upper },
+        { 0x1F170, 0x1F189, upper },
+        { 0x1F1E6, 0x1F1FF, upper },
+        { 0x1FBF0, 0x1FBF9, digits },
+    } };
+
+    // the two byte range folded by index, a folded entry of length 0 drops the code point
+    struct Entry
+    {
+        bool folded;
+        std::uint8_t length;
+        char text[2];
+    };
+    constexpr auto two_byte_table = []
+    {
+        std::array<Entry, 0x800 - 0x80> table{};
+        for (auto&& folding : two_byte_foldings)
+        {
+            auto&& entry = table[folding.code_point - 0x80];
+            entry.folded = true;
+            entry.length = static_cast<std::uint8_t>(folding.text.size());
+            std::copy(folding.text.begin(), folding.text.end(), entry.text);
+        }
+        for (auto&& span : spaces)
+        {
+            for (auto code_point = span.first; code_point <= span.last && code_point < 0x800; ++code_point)
+            {
+                table[code_point - 0x80] = Entry{ true, 1, { ' ' } };
+            }
+        }
+        for (auto&& span : dropped)
+        {
+            for (auto code_point = span.first; code_point <= span.last && code_point < 0x800; ++code_point)
+            {
+                table[code_point - 0x80] = Entry{ true, 0, {} };
+            }
+        }
+        return table;
+    }();
+
+    bool in_spans(const auto& spans, char32_t code_point)
+    {
+        return std::any_of(spans.begin(), spans.end(), [&](const Span& span) { return code_point >= span.first && code_point <= span.last; });
+    }
+
+    // writes the folding of a code point of three or four bytes, nullptr when it is kept as it is
+    char* fold_wide(char32_t code_point, char* out)
+    {
+        if (in_spans(dropped, code_point))
+        {
+            return out;
+        }
+        if (in_spans(spaces, code_point))
+        {
+            *out = ' ';
+            return out + 1;
+        }
+        for (auto&& alphabet : alphabets)
+        {
+            if (code_point >= alphabet.first && code_point <= alphabet.last)
+            {
+                *out = alphabet.letters[(code_point - alphabet.first) % alphabet.letters.size()];
+                return out + 1;
+            }
+        }
+        auto it = std::ranges::lower_bound(wide_foldings, code_point, {}, &Folding::code_point);
+        if (it != wide_foldings.end() && it->code_point == code_point)
+        {
+            return std::copy(it->text.begin(), it->text.end(), out);
+        }
+        return nullptr;
+    }
+
+    bool is_continuation(unsigned char c)
+    {
+        return (c & 0xC0) == 0x80;
+    }
+}
+
+std::size_t Skeleton::ascii_prefix(std::string_view message)
+{
+    auto data = reinterpret_cast<const unsigned char*>(message.data());
+    auto size = message.size();
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16)
+    {
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))));
+        if (mask != 0)
+        {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+#endif
+    for (; i < size; ++i)
+    {
+        if (data[i] >= 0x80)
+        {
+            return i;
+        }
+    }
+    return size;
+}
+
+std::string_view Skeleton::fold(std::string_view message, std::string& buffer)
+{
+    auto i = ascii_prefix(message);
+    if (i == message.size())
+    {
+        return message;
+    }
+
+    // no folding is longer than its utf-8 bytes, the skeleton fits in the size of the message
+    auto data = reinterpret_cast<const unsigned char*>(message.data());
+    auto size = message.size();
+    buffer.resize(size);
+    auto out = std::copy(message.begin(), message.begin() + i, buffer.data());
+    while (i < size)
+    {
+        auto c = data[i];
+        if (c < 0x80)
+        {
+            // ascii runs are copied whole
+            auto run = ascii_prefix(message.substr(i));
+            out = std::copy(message.begin() + i, message.begin() + i + run, out);
+            i += run;
+            continue;
+        }
+
+        std::size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        bool valid = length > 1 && c < 0xF5 && i + length <= size;
+        for (std::size_t k = 1; valid && k < length; ++k)
+        {
+            valid = is_continuation(data[i + k]);
+        }
+        if (!valid)
+        {
+            // stray bytes are kept, the regex sees them as before
+            *out++ = static_cast<char>(c);
+            ++i;
+            continue;
+        }
+
+        char32_t code_point = length == 2 ? c & 0x1F : length == 3 ? c & 0x0F : c & 0x07;
+        for (std::size_t k = 1; k < length; ++k)
+        {
+            code_point = (code_point << 6) | (data[i + k] & 0x3F);
+        }
+
+        if (length == 2 && code_point >= 0x80)
+        {
+            auto&& entry = two_byte_table[code_point - 0x80];
+            if (entry.folded)
+            {
+                out = std::copy(entry.text, entry.text + entry.length, out);
+                i += length;
+                continue;
+            }
+        }
+        else if (length > 2)
+        {
+            if (auto end = fold_wide(code_point, out))
+            {
+                out = end;
+                i += length;
+                continue;
+            }
+        }
+        out = std::copy(message.begin() + i, message.begin() + i + length, out);
+        i += length;
+    }
+    buffer.resize(static_cast<std::size_t>(out - buffer.data()));
+    return buffer;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef SKELETON_HPP_
+#define SKELETON_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// confusable folding of chat messages before banphrase matching: accented, fullwidth, styled and enclosed
+// letters, greek and cyrillic look-alikes become their ascii letters, zero width characters and combining
+// marks are dropped and unicode spaces become spaces; ascii is never changed, so the case of a letter is kept
+class Skeleton
+{
+public:
+    // message itself when it is all ascii, otherwise its skeleton written to buffer
+    static std::string_view fold(std::string_view message, std::string& buffer);
+    // index of the first byte outside ascii, the size when there is none
+    static std::size_t ascii_prefix(std::string_view message);
+};
+
+#endif // SKELETON_HPP_
\ No newline at end of file
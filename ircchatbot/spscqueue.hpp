@@ -0,0 +1,79 @@
+#ifndef SPSCQUEUE_HPP_
+#define SPSCQUEUE_HPP_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// bounded lock-free queue for exactly one producer thread and one consumer thread
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : mask(std::bit_ceil(capacity) - 1)
+        , slots(std::make_unique<T[]>(mask + 1))
+    {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side, false when full
+    bool try_push(T&& value)
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask)
+        {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask)
+            {
+                return false;
+            }
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when empty
+    bool try_pop(T& value)
+    {
+        auto h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache)
+        {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+            {
+                return false;
+            }
+        }
+        value = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate when called from a third thread
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    const std::size_t mask;
+    std::unique_ptr<T[]> slots;
+
+    // producer and consumer indexes on separate cache lines, each side caches the other's index
+    alignas(64) std::atomic<std::size_t> tail{ 0 };
+    std::size_t head_cache = 0;
+    alignas(64) std::atomic<std::size_t> head{ 0 };
+    std::size_t tail_cache = 0;
+};
+
+#endif // SPSCQUEUE_HPP_
\ No newline at end of file
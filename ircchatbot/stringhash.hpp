@@ -0,0 +1,29 @@
+#ifndef STRINGHASH_HPP_
+#define STRINGHASH_HPP_
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+// transparent hash so unordered containers keyed by std::string can be searched with std::string_view
+struct StringHash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view str) const
+    {
+        return std::hash<std::string_view>{}(str);
+    }
+
+    std::size_t operator()(const std::string& str) const
+    {
+        return std::hash<std::string_view>{}(str);
+    }
+
+    std::size_t operator()(const char* str) const
+    {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+#endif // STRINGHASH_HPP_
\ No newline at end of file
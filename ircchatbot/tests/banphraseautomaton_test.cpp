@@ -0,0 +1,184 @@
+#include "../banphraseautomaton.hpp"
+#include "../literalprefilter.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+
+namespace
+{
+
+std::vector<std::pair<boost::regex, int>> make_banphrases(const std::vector<std::string>& phrases)
+{
+    std::vector<std::pair<boost::regex, int>> banphrases;
+    for (auto&& phrase : phrases)
+    {
+        banphrases.emplace_back(boost::regex(phrase, boost::regex_constants::no_except), 1);
+    }
+    return banphrases;
+}
+
+std::string to_string(const std::vector<std::size_t>& indexes)
+{
+    std::string text = "{";
+    for (auto&& index : indexes)
+    {
+        text += " " + std::to_string(index);
+    }
+    return text + " }";
+}
+
+// what the automaton reports has to be what boost::regex_search finds for every pattern on its own
+bool same_as_boost(const std::vector<std::pair<boost::regex, int>>& banphrases, const BanphraseAutomaton& automaton, const std::string& line)
+{
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i < banphrases.size(); ++i)
+    {
+        if (boost::regex_search(line, banphrases[i].first))
+        {
+            expected.push_back(i);
+        }
+    }
+
+    std::vector<std::size_t> matches;
+    automaton.find_matches(line, matches);
+    std::ranges::sort(matches);
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    CHECK(matches == expected, "line \"" << line << "\" matched " << to_string(matches) << ", boost " << to_string(expected));
+    return matches == expected;
+}
+
+// \< \> \` and \' are assertions in boost's perl syntax, not the characters
+const std::vector<std::string> assertion_phrases{
+    "\\<foo\\>",
+    "\\<bad",
+    "bad\\>",
+    "\\`spam",
+    "spam\\'",
+    "\\>",
+    "\\<",
+    "a\\>|b\\<c",
+    "[\\<]x",
+    "<foo>",
+    "fo\\.o",
+};
+
+// boost reads a quantifier after a quantifier as possessive or rejects it, never as a nested repeat
+const std::vector<std::string> stacked_quantifier_phrases{
+    " c??+<",
+    "2>*?+$",
+    "x+y",
+    "[ab]{2,3}?c",
+};
+
+// [:alpha:], [.x.] and [=x=] bring a ] of their own, the class only ends at the one after them
+const std::vector<std::string> posix_member_phrases{
+    "[[:alpha:]]x",
+    "a[[.-.]]b",
+    "[[=e=]]z",
+    "[^[:space:]]]a",
+    "[[:digit:]x]y",
+    "b[[:punct:]]",
+};
+
+void required_literals()
+{
+    const std::pair<std::string_view, std::string_view> literals[] = {
+        { "foobar", "foobar" },
+        { "foo.bar!", "bar!" },
+        { "ab|cd", "" },
+        { "abc\\d+", "abc" },
+        { "\\<foo\\>", "foo" },
+        { "spam\\'", "spam" },
+        { "ab[xy]cde", "cde" },
+        { "[]x]yz", "yz" },
+        { "[^]x]yz", "yz" },
+        { "[\\]x]yz", "yz" },
+        { "foo[[:alpha:]]x", "foo" },
+        { "[[:alpha:]]x", "x" },
+        { "a[[.-.]]bcd", "bcd" },
+        { "[[.].]]xy", "xy" },
+        { "[[=e=]]xyz", "xyz" },
+        { "[^[:space:]]]ab", "]ab" },
+        { "[[:alpha:]", "" },
+    };
+    for (auto&& [pattern, literal] : literals)
+    {
+        auto required = LiteralPrefilter::required_literal(pattern);
+        CHECK(required == literal, pattern << " requires \"" << required << "\", expected \"" << literal << "\"");
+    }
+}
+
+void assertion_escapes_are_not_compiled()
+{
+    for (auto&& phrase : { "\\<foo\\>", "\\<bad", "\\`spam", "spam\\'", "\\>" })
+    {
+        CHECK(BanphraseAutomaton::compile(phrase) == nullptr, phrase);
+    }
+    CHECK(BanphraseAutomaton::compile("fo\\.o") != nullptr, "fo\\.o");
+    CHECK(BanphraseAutomaton::compile("<foo>") != nullptr, "<foo>");
+}
+
+void assertion_escapes_match_like_boost()
+{
+    auto banphrases = make_banphrases(assertion_phrases);
+    BanphraseAutomaton automaton(banphrases);
+    for (auto&& line : { "a foo b", "<foo>", "foo", "bad", "xbad", "bad!", "spam", "a spam", "spam'", "`spam", "spam ", "", " ", "a", "bc", "b c", "<x", "fo.o", "foxo" })
+    {
+        same_as_boost(banphrases, automaton, line);
+    }
+}
+
+void stacked_quantifiers_match_like_boost()
+{
+    for (auto&& phrase : { " c??+<", "2>*?+$" })
+    {
+        CHECK(BanphraseAutomaton::compile(phrase) == nullptr, phrase);
+    }
+    auto banphrases = make_banphrases(stacked_quantifier_phrases);
+    BanphraseAutomaton automaton(banphrases);
+    for (auto&& line : { "<a c<ab", "c>2>", "x<< 2 c.2>", "abbc", "ac", "xxy", "abac", "bbc" })
+    {
+        same_as_boost(banphrases, automaton, line);
+    }
+}
+
+void random_lines_match_like_boost(const std::vector<std::string>& phrases, const std::string& alphabet)
+{
+    auto banphrases = make_banphrases(phrases);
+    BanphraseAutomaton automaton(banphrases);
+
+    std::mt19937 random(36);
+    std::uniform_int_distribution<std::size_t> length(0, 12);
+    std::uniform_int_distribution<std::size_t> letter(0, alphabet.size() - 1);
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string line(length(random), ' ');
+        for (auto&& c : line)
+        {
+            c = alphabet[letter(random)];
+        }
+        // the first mismatch is enough
+        if (!same_as_boost(banphrases, automaton, line))
+        {
+            return;
+        }
+    }
+}
+
+}
+
+int main()
+{
+    required_literals();
+    assertion_escapes_are_not_compiled();
+    assertion_escapes_match_like_boost();
+    stacked_quantifiers_match_like_boost();
+    random_lines_match_like_boost(assertion_phrases, "fobadspmcx<>`'. ");
+    random_lines_match_like_boost(posix_member_phrases, "abexyz1-]!. ");
+    return check_failures() == 0 ? 0 : 1;
+}
\ No newline at end of file
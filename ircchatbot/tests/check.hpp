@@ -0,0 +1,23 @@
+#ifndef CHECK_HPP_
+#define CHECK_HPP_
+
+#include <iostream>
+
+// failed checks are printed and counted, the test returns check_failures() from main
+inline int& check_failures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition, context) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            ++check_failures(); \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #condition << " failed, " << context << "\n"; \
+        } \
+    } while (false)
+
+#endif // CHECK_HPP_
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "../clustermembership.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "check.hpp"
+
+// nodes sharing one SQLite file in one process, each on an io_context of its own that the test polls;
+// a node that is no longer polled has crashed. Every channel has to be held by at most one node at any
+// time while nodes join, leave, lose their release deletes and die, and end up held by exactly one
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const std::string account = "bot";
+
+std::vector<ClusterMembership::ChannelKey> channels()
+{
+    std::vector<ClusterMembership::ChannelKey> keys;
+    for (int i = 0; i < 24; ++i)
+    {
+        keys.push_back({ account, "channel" + std::to_string(i) });
+    }
+    return keys;
+}
+
+struct Node;
+// every node of the test, crashed ones included
+std::vector<Node*> nodes;
+
+struct Node
+{
+    std::string id;
+    boost::asio::io_context io_context;
+    std::unique_ptr<ClusterMembership> membership;
+    // a crashed node is not polled and does not reply anywhere
+    bool polled = true;
+
+    Node(std::string id, const std::string& db_file)
+        : id(std::move(id))
+    {
+        // holds() is what the bot asks before it replies in a channel
+        membership = std::make_unique<ClusterMembership>(io_context, db_file, this->id, channels,
+            [this](const ClusterMembership::ChannelKey& key)
+            {
+                for (auto&& node : nodes)
+                {
+                    CHECK(node == this || !node->polled || !node->membership->holds(key.account, key.channel),
+                        this->id << " acquired " << key.channel << " held by " << node->id);
+                }
+            },
+            [this](const ClusterMembership::ChannelKey& key)
+            {
+                CHECK(!membership->holds(key.account, key.channel), this->id << " still holds released " << key.channel);
+            });
+        nodes.push_back(this);
+    }
+
+    std::size_t held() const
+    {
+        std::size_t count = 0;
+        for (auto&& key : channels())
+        {
+            count += membership->holds(key.account, key.channel);
+        }
+        return count;
+    }
+};
+
+// every channel held by exactly one live node
+bool all_held()
+{
+    for (auto&& key : channels())
+    {
+        std::size_t holding = 0;
+        for (auto&& node : nodes)
+        {
+            holding += node->polled && node->membership->holds(key.account, key.channel);
+        }
+        if (holding != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// polls the nodes until done() or the timeout, false on the timeout
+template <typename Done>
+bool run_until(Done&& done, std::chrono::seconds timeout)
+{
+    auto deadline = Clock::now() + timeout;
+    while (!done())
+    {
+        if (Clock::now() > deadline)
+        {
+            return false;
+        }
+        for (auto&& node : nodes)
+        {
+            if (node->polled)
+            {
+                node->io_context.poll();
+                node->io_context.restart();
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// a tick is scheduled every heartbeat, a handoff takes the releasing node's next two ticks and one of the taker
+constexpr auto handoff_time = ClusterMembership::heartbeat_interval * 4;
+
+void remove_db(const std::string& db_file)
+{
+    for (auto&& suffix : { "", "-wal", "-shm" })
+    {
+        std::filesystem::remove(db_file + suffix);
+    }
+}
+
+void handoff(const std::string& db_file)
+{
+    // the test's own connection to the file, for what the nodes cannot be made to do
+    Database db(db_file);
+    Node a("node-a", db_file);
+    Node b("node-b", db_file);
+    Node c("node-c", db_file);
+
+    a.membership->start();
+    CHECK(run_until(all_held, handoff_time), "node-a alone holds " << a.held() << " channels");
+
+    // node-a loses the deletes of the leases it hands over; they stay its own in the file while
+    // it does not hold them any more and have to be released again once the deletes work
+    db.execute_statement("CREATE TRIGGER lose_release BEFORE DELETE ON leases BEGIN SELECT RAISE(ABORT, 'release lost'); END;");
+    b.membership->start();
+    CHECK(run_until([&] { return a.held() < channels().size(); }, handoff_time), "node-a released nothing for node-b");
+    // the tick after the release tries the deletes and fails
+    run_until([] { return false; }, ClusterMembership::heartbeat_interval + std::chrono::seconds(1));
+    CHECK(b.held() == 0, "node-b took " << b.held() << " channels whose leases were never deleted");
+    db.execute_statement("DROP TRIGGER lose_release;");
+    CHECK(run_until([&] { return all_held() && b.held() > 0; }, handoff_time),
+        "after the lost release node-a holds " << a.held() << ", node-b " << b.held());
+
+    // leaving deletes the own leases at once
+    b.membership->stop();
+    CHECK(run_until([&] { return a.held() == channels().size(); }, handoff_time), "node-a took over " << a.held() << " channels after node-b left");
+
+    c.membership->start();
+    CHECK(run_until([&] { return all_held() && c.held() > 0; }, handoff_time), "node-c joined with " << c.held() << " channels");
+
+    // node-c dies: it is not polled any more and its heartbeat and leases run out
+    c.polled = false;
+    auto expired = std::chrono::duration<double>(ClusterMembership::lease_ttl).count() * 2;
+    db.execute_prepared_statement("UPDATE nodes SET heartbeat=heartbeat-? WHERE node=?;", { expired, std::string("node-c") });
+    db.execute_prepared_statement("UPDATE leases SET expires=expires-? WHERE node=?;", { expired, std::string("node-c") });
+    CHECK(run_until([&] { return a.held() == channels().size(); }, handoff_time), "node-a took over " << a.held() << " channels after node-c died");
+
+    auto leases = db.execute_statement("SELECT node, count(*) FROM leases GROUP BY node;");
+    CHECK(leases.rc == SQLITE_OK && leases.data.size() == 1 && leases.data[0][0] == "node-a" && leases.data[0][1] == std::to_string(channels().size()),
+        "leases are not all node-a's");
+}
+
+}
+
+int main()
+{
+    auto db_file = (std::filesystem::temp_directory_path() / ("clustermembership_test_" + std::to_string(getpid()) + ".db")).string();
+    remove_db(db_file);
+    handoff(db_file);
+    remove_db(db_file);
+    return check_failures() == 0 ? 0 : 1;
+}
\ No newline at end of file
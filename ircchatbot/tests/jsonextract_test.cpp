@@ -0,0 +1,198 @@
+#include "../jsonextract.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+
+// JsonExtractor over the documents in fixtures/, each fed whole and in chunks of 1, 2, 3, 7 and 1000 bytes;
+// the fixture directory is the first argument
+
+namespace
+{
+
+using Result = JsonExtractor::Result;
+
+std::string fixture_directory;
+
+std::string load(const std::string& name)
+{
+    std::ifstream file(fixture_directory + "/" + name, std::ios::binary);
+    CHECK(file, "cannot open fixture " << name);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+const char* to_string(Result result)
+{
+    switch (result)
+    {
+    case Result::NeedMore:
+        return "NeedMore";
+    case Result::Found:
+        return "Found";
+    case Result::Missing:
+        return "Missing";
+    case Result::Invalid:
+        return "Invalid";
+    }
+    return "?";
+}
+
+// feeds the document like EchoPage does, chunk by chunk until the result is known, then finish
+std::pair<Result, std::string> extract(std::string_view document, std::string_view path, std::size_t chunk, std::size_t max_bytes)
+{
+    auto steps = JsonExtractor::parse_path(path);
+    if (!steps)
+    {
+        return { Result::Invalid, "no path" };
+    }
+    JsonExtractor extractor(std::move(*steps), max_bytes);
+    auto result = Result::NeedMore;
+    for (std::size_t offset = 0; offset < document.size() && result == Result::NeedMore; offset += chunk)
+    {
+        result = extractor.feed(document.substr(offset, chunk));
+    }
+    if (result == Result::NeedMore)
+    {
+        result = extractor.finish();
+    }
+    return { result, extractor.take_value() };
+}
+
+struct Case
+{
+    std::string document;
+    std::string path;
+    Result result;
+    // only compared when the value is found
+    std::string value;
+    std::size_t max_bytes = 500;
+};
+
+void check_cases(const std::vector<Case>& cases)
+{
+    for (auto&& test : cases)
+    {
+        for (std::size_t chunk : { std::size_t(1), std::size_t(2), std::size_t(3), std::size_t(7), std::size_t(1000), test.document.size() + 1 })
+        {
+            auto [result, value] = extract(test.document, test.path, chunk, test.max_bytes);
+            bool same = result == test.result && (result != Result::Found || value == test.value);
+            CHECK(same, test.path << " in chunks of " << chunk << ": " << to_string(result) << " \"" << value << "\", expected "
+                << to_string(test.result) << " \"" << test.value << "\"");
+        }
+    }
+}
+
+void found_in_channel()
+{
+    auto channel = load("channel.json");
+    check_cases({
+        { channel, "$.data[0].login", Result::Found, "twitchdev" },
+        { channel, "data[1].display_name", Result::Found, "dallas" },
+        { channel, "$.data[0].view_count", Result::Found, "5980557" },
+        { channel, "$.data[1].view_count", Result::Found, "-12.5e3" },
+        { channel, "$.data[0].stream", Result::Found, "null" },
+        { channel, "$.data[0].mature", Result::Found, "false" },
+        { channel, "$.data[0].tags[2]", Result::Found, "[not] {json}" },
+        { channel, "$.data[0].tags", Result::Found, R"(["English", "Developers", "[not] {json}"])" },
+        { channel, "$.data[0].extensions.panel.1.version", Result::Found, "1.1.8" },
+        { channel, "$.data[0].extensions.overlay", Result::Found, "{}" },
+        { channel, "$.data[1].followers.recent[2][1][1][0]", Result::Found, "3" },
+        { channel, "$.pagination.cursor", Result::Found, "eyJiIjpudWxsLCJhIjp7Ik9mZnNldCI6MX19" },
+        { channel, R"($["meta.info"].source)", Result::Found, "dotted key" },
+        { channel, "$['meta.info']['source']", Result::Found, "dotted key" },
+        { channel, "$.total", Result::Found, "2" },
+        // cut at max_bytes
+        { channel, "$.data[0].description", Result::Found, "Supporting", 10 },
+    });
+}
+
+void missing_in_channel()
+{
+    auto channel = load("channel.json");
+    check_cases({
+        { channel, "$.nothing", Result::Missing, "" },
+        { channel, "$.data[2]", Result::Missing, "" },
+        { channel, "$.data[1].tags[0]", Result::Missing, "" },
+        { channel, "$.data.login", Result::Missing, "" },
+        { channel, "$.pagination[0]", Result::Missing, "" },
+        { channel, "$.data[0].login.first", Result::Missing, "" },
+        { channel, "$.meta.info", Result::Missing, "" },
+    });
+}
+
+void invalid_documents()
+{
+    auto truncated = load("truncated.json");
+    check_cases({
+        // nothing after the value is looked at
+        { truncated, "$.data[0].login", Result::Found, "twitchdev" },
+        { truncated, "$.data[0].extensions.panel.1.version", Result::Invalid, "" },
+        { truncated, "$.total", Result::Invalid, "" },
+        { load("bad_escape.json"), "$.fine", Result::Found, "yes" },
+        { load("bad_escape.json"), "$.broken", Result::Invalid, "" },
+        { load("bad_unicode.json"), "$.broken", Result::Invalid, "" },
+        { "42", "$", Result::Found, "42" },
+        { "\"str\"", "$", Result::Found, "str" },
+        { "[1,2", "$[3]", Result::Invalid, "" },
+        { "{}", "$.a", Result::Missing, "" },
+        { "", "$", Result::Invalid, "" },
+        { "{\"a\" 1}", "$.a", Result::Invalid, "" },
+    });
+}
+
+void unicode_escapes()
+{
+    auto unicode = load("unicode.json");
+    check_cases({
+        { unicode, "$.plain", Result::Found, "caf\xC3\xA9 \xE2\x82\xAC A" },
+        // surrogate pairs
+        { unicode, "$.emoji", Result::Found, "\xF0\x9F\x98\x80 and \xF0\x9F\x8E\x89" },
+        // tab and line feed become spaces
+        { unicode, "$.escapes", Result::Found, "tab here \"quoted\" back\\slash / line break" },
+        // halves without their other half are U+FFFD
+        { unicode, "$.lone_high", Result::Found, "a\xEF\xBF\xBD" "b" },
+        { unicode, "$.lone_low", Result::Found, "a\xEF\xBF\xBD" "b" },
+        { unicode, "$.high_before_quote", Result::Found, "x\xEF\xBF\xBD" },
+        { unicode, "$.raw", Result::Found, "h\xC3\xA9llo w\xC3\xB6rld \xF0\x9F\x98\x80" },
+        { unicode, "$.key", Result::Found, "escaped key" },
+        { unicode, "$.last", Result::Found, "after a skipped escape" },
+    });
+}
+
+void paths()
+{
+    for (auto&& path : { "$..x", "$[x]", "$.a[", "$['a'", "$['a'x]", "$[1", "$[-1]", "$.", "a..b", "$x" })
+    {
+        CHECK(!JsonExtractor::parse_path(path), "path " << path << " was accepted");
+    }
+
+    auto whole = JsonExtractor::parse_path(" $ ");
+    CHECK(whole && whole->empty(), "$ is not the whole document");
+    auto steps = JsonExtractor::parse_path(R"($["a.b"][2].c)");
+    CHECK(steps && steps->size() == 3 && (*steps)[0].key == "a.b" && (*steps)[1].is_index && (*steps)[1].index == 2 && (*steps)[2].key == "c",
+        "$[\"a.b\"][2].c");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: jsonextract_test <fixture directory>\n";
+        return 1;
+    }
+    fixture_directory = argv[1];
+    found_in_channel();
+    missing_in_channel();
+    invalid_documents();
+    unicode_escapes();
+    paths();
+    return check_failures() == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "../messageshape.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "check.hpp"
+
+// built once with the default flags and once with -mavx2, both builds have to agree with a plain
+// byte by byte count of the rules in messageshape.hpp
+
+namespace
+{
+
+unsigned byte_at(const std::string& text, std::size_t i)
+{
+    return i < text.size() ? static_cast<unsigned char>(text[i]) : 0;
+}
+
+MessageShape reference_shape(const std::string& text)
+{
+    MessageShape shape;
+    shape.bytes = text.size();
+    std::size_t code_points = 0;
+    std::size_t joined = 0;
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        auto c = byte_at(text, i);
+        bool upper = c >= 'A' && c <= 'Z';
+        bool letter = upper || (c >= 'a' && c <= 'z');
+        bool digit = c >= '0' && c <= '9';
+        bool art = c == 0xE2 && i + 1 < text.size() && byte_at(text, i + 1) >= 0x94 && byte_at(text, i + 1) <= 0xA3;
+        shape.uppercase += upper;
+        shape.letters += letter;
+        shape.digits += digit;
+        shape.symbols += (c >= 0x21 && c <= 0x7E && !letter && !digit) || art;
+        code_points += c < 0x80 || c > 0xBF;
+
+        auto b1 = byte_at(text, i + 1), b2 = byte_at(text, i + 2), b3 = byte_at(text, i + 3);
+        joined += c == 0xCC;
+        joined += c == 0xCD && b1 < 0xB0;
+        joined += c == 0xE2 && b1 == 0x80 && b2 == 0x8D ? 2 : 0;
+        joined += c == 0xEF && b1 == 0xB8 && b2 == 0x8F;
+        joined += c == 0xF0 && b1 == 0x9F && b2 == 0x8F && b3 >= 0xBB && b3 <= 0xBF;
+
+        run = i > 0 && text[i] == text[i - 1] ? run + 1 : 1;
+        shape.longest_run = std::max(shape.longest_run, run);
+    }
+    shape.graphemes = code_points - std::min(joined, code_points);
+    return shape;
+}
+
+bool same_as_reference(const std::string& text)
+{
+    auto shape = MessageShape::measure(text);
+    auto expected = reference_shape(text);
+    bool same = shape.bytes == expected.bytes && shape.letters == expected.letters && shape.uppercase == expected.uppercase
+        && shape.digits == expected.digits && shape.symbols == expected.symbols && shape.graphemes == expected.graphemes
+        && shape.longest_run == expected.longest_run;
+    CHECK(same, text.size() << " bytes, letters " << shape.letters << "/" << expected.letters << ", uppercase " << shape.uppercase
+        << "/" << expected.uppercase << ", digits " << shape.digits << "/" << expected.digits << ", symbols " << shape.symbols
+        << "/" << expected.symbols << ", graphemes " << shape.graphemes << "/" << expected.graphemes << ", longest run "
+        << shape.longest_run << "/" << expected.longest_run);
+    return same;
+}
+
+// pieces that end up on both sides of 16 and 32 byte block edges
+const std::string pieces[] = {
+    "a", "Z", "7", "!", " ", "aa", "KAPPA", "\xCC\x81", "\xCD\xAF", "\xCD\xB0", "\xE2\x80\x8D", "\xE2\x94\x80",
+    "\xE2\xA3\xBF", "\xE2\xA4\x80", "\xEF\xB8\x8F", "\xF0\x9F\x98\x80", "\xF0\x9F\x8F\xBB", "\xF0\x9F\x8F\xBA", "\xC3\xA9",
+};
+
+void random_lines_match_reference()
+{
+    std::mt19937 random(41);
+    std::uniform_int_distribution<std::size_t> piece(0, std::size(pieces) - 1);
+    std::uniform_int_distribution<std::size_t> count(0, 120);
+    for (int i = 0; i < 20000; ++i)
+    {
+        std::string line;
+        for (auto n = count(random); n > 0; --n)
+        {
+            line += pieces[piece(random)];
+        }
+        // the first mismatch is enough
+        if (!same_as_reference(line))
+        {
+            return;
+        }
+    }
+}
+
+// the per byte lane counters are summed every 255 blocks, longer lines must not wrap them
+void long_lines_match_reference()
+{
+    same_as_reference(std::string(20000, 'A'));
+    same_as_reference(std::string(20000, '\x80'));
+    std::string braille;
+    for (int i = 0; i < 7000; ++i)
+    {
+        braille += "\xE2\xA3\xBF";
+    }
+    same_as_reference(braille);
+    std::string mixed;
+    for (int i = 0; i < 3000; ++i)
+    {
+        mixed += "Hi! \xF0\x9F\x91\x8B\xF0\x9F\x8F\xBB 42";
+    }
+    same_as_reference(mixed);
+}
+
+}
+
+int main()
+{
+#if defined(__AVX2__)
+    // the -mavx2 build cannot run here, ctest reports it as skipped
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        return 77;
+    }
+#endif
+    for (std::size_t length = 0; length <= 100; ++length)
+    {
+        same_as_reference(std::string(length, 'x'));
+    }
+    random_lines_match_reference();
+    long_lines_match_reference();
+    return check_failures() == 0 ? 0 : 1;
+}
\ No newline at end of file
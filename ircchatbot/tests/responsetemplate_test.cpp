@@ -0,0 +1,114 @@
+#include "../responsetemplate.hpp"
+
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+
+namespace
+{
+
+std::string describe(const ResponsePieces& pieces)
+{
+    std::string text = "texts {";
+    for (auto&& piece : pieces.texts)
+    {
+        text += " \"" + piece + "\"";
+    }
+    text += " } fetches {";
+    for (auto&& fetch : pieces.fetches)
+    {
+        text += " \"" + fetch.url + "\" \"" + fetch.json_path + "\"";
+    }
+    return text + " }";
+}
+
+void check_render(std::string_view response, std::string_view message, const ResponsePieces& expected)
+{
+    ResponseTemplate response_template(response);
+    ResponsePieces pieces;
+    bool rendered = response_template.render(message, pieces);
+    bool same = rendered && pieces.texts == expected.texts && pieces.fetches.size() == expected.fetches.size();
+    for (std::size_t i = 0; same && i < pieces.fetches.size(); ++i)
+    {
+        same = pieces.fetches[i].url == expected.fetches[i].url && pieces.fetches[i].json_path == expected.fetches[i].json_path;
+    }
+    CHECK(same, response << " with \"" << message << "\" gave " << (rendered ? describe(pieces) : "nothing") << ", expected " << describe(expected));
+    CHECK(response_template.has_fetches() == !expected.fetches.empty(), response << " has_fetches");
+}
+
+void check_not_rendered(std::string_view response, std::string_view message)
+{
+    ResponseTemplate response_template(response);
+    ResponsePieces pieces;
+    CHECK(!response_template.render(message, pieces), response << " rendered with \"" << message << "\"");
+}
+
+void static_responses()
+{
+    ResponseTemplate response_template("hello world", { "chan", "other" });
+    CHECK(response_template.is_static(), "hello world is not static");
+    CHECK(response_template.frame("chan") == "PRIVMSG #chan :hello world", response_template.frame("chan"));
+    CHECK(response_template.frame("missing").empty(), response_template.frame("missing"));
+    check_render("hello world", "!hi", { { "hello world" }, {} });
+
+    // not placeholders, kept as they are
+    for (auto&& response : { "${x} ${ ${1", "$url{} and $json{}", "$url{https://a", "$$1 {1}" })
+    {
+        CHECK(ResponseTemplate(response).is_static(), response << " is not static");
+        check_render(response, "!hi", { { response }, {} });
+    }
+}
+
+void arguments()
+{
+    check_render("hi ${1}, you said ${2} ${1}", "!hi bob foo", { { "hi bob, you said foo bob" }, {} });
+    check_render("${0} to ${1}", "!hi   bob  ", { { "!hi to bob" }, {} });
+    // words after the highest argument are not needed
+    check_render("${1}", "!hi bob and more words", { { "bob" }, {} });
+    // a word that looks like a placeholder stays a word
+    check_render("said ${1} ${2}", "!hi ${2} $url{https://x}", { { "said ${2} $url{https://x}" }, {} });
+}
+
+void missing_words()
+{
+    check_not_rendered("${1}", "!hi");
+    check_not_rendered("${1}", "!hi   ");
+    check_not_rendered("${3}", "!hi a b");
+    // the highest argument counts, wherever it stands
+    check_not_rendered("${1} ${5} ${2}", "!hi a b c");
+    check_not_rendered("$url{https://api/${2}}", "!hi a");
+}
+
+void fetches()
+{
+    check_render("title: $url{https://api/title}", "!title", { { "title: ", "" }, { { "https://api/title", "" } } });
+    check_render("$url{https://api/${1}/info} and ${2}", "!cmd abc def", { { "", " and def" }, { { "https://api/abc/info", "" } } });
+    check_render("$url{https://a} $url{https://b/${1}}!", "!cmd x", { { "", " ", "!" }, { { "https://a", "" }, { "https://b/x", "" } } });
+    // the path follows the last comma of the template, a url may hold commas of its own
+    check_render("$json{https://api/x?a=1,b=2, $.data[${1}].name}!", "!cmd 3", { { "", "!" }, { { "https://api/x?a=1,b=2", " $.data[3].name" } } });
+    check_render("$json{https://api/${1}}", "!cmd doc", { { "", "" }, { { "https://api/doc", "$" } } });
+}
+
+// words land in the url, path or text they were placed in and are never parsed again
+void injected_words()
+{
+    check_render("$url{https://api/${1}} ${2}", "!cmd a $url{http://10.0.0.1/admin}",
+        { { "", " $url{http://10.0.0.1/admin}" }, { { "https://api/a", "" } } });
+    check_render("$url{https://api/${1}} ${2}", "!cmd a} $json{http://10.0.0.1,$}",
+        { { "", " $json{http://10.0.0.1,$}" }, { { "https://api/a}", "" } } });
+    check_render("$json{https://api/${1}, $.${2}}", "!cmd a,b x}y", { { "", "" }, { { "https://api/a,b", " $.x}y" } } });
+    check_render("${1}", "!cmd $url{http://10.0.0.1/admin}", { { "$url{http://10.0.0.1/admin}" }, {} });
+}
+
+}
+
+int main()
+{
+    static_responses();
+    arguments();
+    missing_words();
+    fetches();
+    injected_words();
+    return check_failures() == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -1,22 +1,35 @@
 #include "users.hpp"
 
-#include <iostream>
+#include <algorithm>
+
+#include "logger.hpp"
 
 constexpr std::string_view users_db_name = "users.db";
 
-Users::Users()
-    : users_db(users_db_name)
+Users::Users(boost::asio::io_context& io_context)
+    : io_context(io_context)
+    , users_db(users_db_name)
 {
     init_db();
 }
 
+Users::~Users()
+{
+    // bounded so a huge backlog cannot stall shutdown, users_db drains the queued batch before closing
+    flush_pending_users(shutdown_flush_limit);
+    if (!pending_users.empty())
+    {
+        log_warning(LogCategory::Users, "dropped " + std::to_string(pending_users.size()) + " pending users on shutdown");
+    }
+}
+
 void Users::init_db()
 {
     auto result = users_db.execute_statement("PRAGMA foreign_keys = ON;");
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Users DB table error - unable to enable foreign_keys: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Users, msg);
         throw std::runtime_error(msg);
     }
 
@@ -24,7 +37,7 @@ void Users::init_db()
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Users DB table users error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Users, msg);
         throw std::runtime_error(msg);
     }
 
@@ -32,71 +45,256 @@ void Users::init_db()
     if (result.rc != SQLITE_OK)
     {
         std::string msg = "Users DB table admins error: " + result.errmsg;
-        std::cerr << msg << std::endl;
+        log_error(LogCategory::Users, msg);
         throw std::runtime_error(msg);
     }
+
+    {
+        result = users_db.execute_statement("SELECT twitchid, permissions FROM admins;");
+        if (result.rc != SQLITE_OK)
+        {
+            std::string msg = "Users DB table admins select all error: " + result.errmsg;
+            log_error(LogCategory::Users, msg);
+            throw std::runtime_error(msg);
+        }
+
+        auto loaded = std::make_shared<AdminTable>();
+        for (auto&& line : result.data)
+        {
+            if (line[0] && line[1])
+            {
+                loaded->emplace(*line[0], std::stoi(*line[1]));
+            }
+        }
+        publish_admins(std::move(loaded));
+    }
 }
 
 bool Users::add_user(std::string_view twitchid, std::string_view username)
 {
-    auto result = users_db.execute_prepared_statement("INSERT INTO users (twitchid, username) VALUES (?, ?);", { std::string(twitchid), std::string(username) });
-    return result.rc == SQLITE_OK;
+    if (known_users.contains(twitchid) || queued_users.contains(twitchid))
+    {
+        return true;
+    }
+
+    remember_user(twitchid, username, std::nullopt);
+    return true;
 }
 
 bool Users::add_user(std::string_view twitchid, std::string_view username, std::string_view displayname)
 {
-    auto result = users_db.execute_prepared_statement("INSERT INTO users (twitchid, username, displayname) VALUES (?, ?, ?) ON CONFLICT DO UPDATE SET displayname=?3;", { std::string(twitchid), std::string(username), std::string(displayname) });
-    return result.rc == SQLITE_OK;
+    if (auto it = queued_users.find(twitchid); it != queued_users.end())
+    {
+        if (it->second.displayname == displayname)
+        {
+            return true;
+        }
+    }
+    else if (auto it = known_users.find(twitchid); it != known_users.end() && it->second.displayname == displayname)
+    {
+        return true;
+    }
+
+    remember_user(twitchid, username, displayname);
+    return true;
 }
 
-bool Users::add_admin(std::string_view twitchid, int permissions)
+void Users::remember_user(std::string_view twitchid, std::string_view username, std::optional<std::string_view> displayname)
 {
-    auto result = users_db.execute_prepared_statement("INSERT INTO admins (twitchid, permissions) VALUES (?, ?);", { std::string(twitchid), permissions });
-    return result.rc == SQLITE_OK;
+    auto [queued, inserted] = queued_users.try_emplace(std::string(twitchid));
+    if (inserted)
+    {
+        if (auto it = known_users.find(twitchid); it != known_users.end())
+        {
+            queued->second.displayname = it->second.displayname;
+        }
+    }
+    queued->second.username = username;
+    if (displayname)
+    {
+        queued->second.displayname = std::string(*displayname);
+    }
+
+    pending_users.push_back(User{ std::string(twitchid), std::string(username), queued->second.displayname });
+    if (pending_users.size() >= pending_users_flush_threshold)
+    {
+        flush_pending_users();
+    }
 }
 
-bool Users::remove_admin(std::string_view twitchid)
+void Users::finish_batch(std::vector<User> batch, bool written)
 {
-    auto result = users_db.execute_prepared_statement("DELETE FROM admins WHERE twitchid=?;", { std::string(twitchid) });
-    return result.rc == SQLITE_OK;
+    if (!written)
+    {
+        // retried with the next flush, the users stay queued meanwhile
+        log_warning(LogCategory::Users, "requeued " + std::to_string(batch.size()) + " users after a failed write");
+        pending_users.insert(pending_users.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        return;
+    }
+
+    for (auto&& user : batch)
+    {
+        auto it = queued_users.find(user.twitchid);
+        // a newer change of the user is still on its way
+        if (it == queued_users.end() || it->second.username != user.username || it->second.displayname != user.displayname)
+        {
+            continue;
+        }
+        if (known_users.size() >= max_known_users)
+        {
+            // only a dedup cache, dropping it costs at most one redundant write per user
+            known_users.clear();
+        }
+        known_users.insert_or_assign(it->first, std::move(it->second));
+        queued_users.erase(it);
+    }
 }
 
-std::optional<Users::User> Users::get_user_by_twitchid(std::string_view twitchid)
+std::size_t Users::flush_pending_users(std::size_t max_users)
 {
-    auto result = users_db.execute_prepared_statement("SELECT twitchid, username, displayname FROM users WHERE twitchid=?;", { std::string(twitchid) });
-    if (result.rc != SQLITE_OK || result.data.size() != 1 || result.data[0].size() != 3)
+    if (pending_users.empty())
     {
-        return std::nullopt;
+        return 0;
     }
-    return User{ *result.data[0][0], *result.data[0][1], result.data[0][2] };
+
+    std::size_t count = std::min(max_users, pending_users.size());
+    std::vector<User> batch(std::make_move_iterator(pending_users.begin()), std::make_move_iterator(pending_users.begin() + count));
+    pending_users.erase(pending_users.begin(), pending_users.begin() + count);
+
+    users_db.post([this, batch = std::move(batch)]() mutable
+    {
+        auto done = [&](bool written)
+        {
+            boost::asio::post(io_context, [this, batch = std::move(batch), written]() mutable { finish_batch(std::move(batch), written); });
+        };
+
+        auto result = users_db.execute_statement("BEGIN TRANSACTION;");
+        if (result.rc != SQLITE_OK)
+        {
+            log_error(LogCategory::Users, "Users DB unable to begin transaction: " + result.errmsg);
+            done(false);
+            return;
+        }
+
+        for (auto&& user : batch)
+        {
+            // failing on an already known user is expected, the transaction continues
+            if (user.displayname)
+            {
+                users_db.execute_prepared_statement("INSERT INTO users (twitchid, username, displayname) VALUES (?, ?, ?) ON CONFLICT DO UPDATE SET displayname=?3;", { user.twitchid, user.username, *user.displayname });
+            }
+            else
+            {
+                users_db.execute_prepared_statement("INSERT INTO users (twitchid, username) VALUES (?, ?);", { user.twitchid, user.username });
+            }
+        }
+
+        result = users_db.execute_statement("COMMIT;");
+        if (result.rc != SQLITE_OK)
+        {
+            log_error(LogCategory::Users, "Users DB unable to commit pending users: " + result.errmsg);
+            users_db.execute_statement("ROLLBACK;");
+            done(false);
+            return;
+        }
+        done(true);
+    });
+
+    return count;
 }
 
-std::optional<Users::User> Users::get_user_by_username(std::string_view username)
+void Users::add_admin(std::string_view twitchid, int permissions, DoneHandler on_done)
 {
-    auto result = users_db.execute_prepared_statement("SELECT twitchid, username, displayname FROM users WHERE username=?;", { std::string(username) });
-    if (result.rc != SQLITE_OK || result.data.size() != 1 || result.data[0].size() != 3)
+    // admins reference users, the flush is queued ahead of the insert
+    flush_pending_users();
+    users_db.async_execute_prepared_statement(io_context.get_executor(), "INSERT INTO admins (twitchid, permissions) VALUES (?, ?);", { std::string(twitchid), permissions },
+        [this, twitchid = std::string(twitchid), permissions, on_done = std::move(on_done)](Database::Result result)
     {
-        return std::nullopt;
-    }
-    return User{ *result.data[0][0], *result.data[0][1], result.data[0][2] };
+        bool ok = result.rc == SQLITE_OK;
+        if (ok)
+        {
+            auto next = std::make_shared<AdminTable>(*admins);
+            next->emplace(twitchid, permissions);
+            publish_admins(std::move(next));
+        }
+        if (on_done)
+        {
+            on_done(ok);
+        }
+    });
 }
 
-std::optional<Users::User> Users::get_user_by_displayname(std::string_view displayname)
+void Users::remove_admin(std::string_view twitchid, DoneHandler on_done)
 {
-    auto result = users_db.execute_prepared_statement("SELECT twitchid, username, displayname FROM users WHERE displayname=?;", { std::string(displayname) });
-    if (result.rc != SQLITE_OK || result.data.size() != 1 || result.data[0].size() != 3)
+    users_db.async_execute_prepared_statement(io_context.get_executor(), "DELETE FROM admins WHERE twitchid=?;", { std::string(twitchid) },
+        [this, twitchid = std::string(twitchid), on_done = std::move(on_done)](Database::Result result)
     {
-        return std::nullopt;
-    }
-    return User{ *result.data[0][0], *result.data[0][1], result.data[0][2] };
+        bool ok = result.rc == SQLITE_OK;
+        if (ok && admins->contains(twitchid))
+        {
+            auto next = std::make_shared<AdminTable>(*admins);
+            next->erase(twitchid);
+            publish_admins(std::move(next));
+        }
+        if (on_done)
+        {
+            on_done(ok);
+        }
+    });
+}
+
+void Users::get_user(const char* sql, std::string_view value, UserHandler on_user)
+{
+    // queued behind pending users so lookups see everyone already added
+    flush_pending_users();
+    users_db.async_execute_prepared_statement(io_context.get_executor(), sql, { std::string(value) }, [on_user = std::move(on_user)](Database::Result result)
+    {
+        if (result.rc != SQLITE_OK || result.data.size() != 1 || result.data[0].size() != 3)
+        {
+            on_user(std::nullopt);
+            return;
+        }
+        on_user(User{ *result.data[0][0], *result.data[0][1], result.data[0][2] });
+    });
+}
+
+void Users::get_user_by_twitchid(std::string_view twitchid, UserHandler on_user)
+{
+    get_user("SELECT twitchid, username, displayname FROM users WHERE twitchid=?;", twitchid, std::move(on_user));
+}
+
+void Users::get_user_by_username(std::string_view username, UserHandler on_user)
+{
+    get_user("SELECT twitchid, username, displayname FROM users WHERE username=?;", username, std::move(on_user));
+}
+
+void Users::get_user_by_displayname(std::string_view displayname, UserHandler on_user)
+{
+    get_user("SELECT twitchid, username, displayname FROM users WHERE displayname=?;", displayname, std::move(on_user));
 }
 
 std::optional<int> Users::get_admin_permissions(std::string_view twitchid)
 {
-    auto result = users_db.execute_prepared_statement("SELECT permissions FROM admins WHERE twitchid=?;", { std::string(twitchid) });
-    if (result.rc != SQLITE_OK || result.data.size() != 1 || result.data[0].size() != 1 || !result.data[0][0])
+    if (auto it = admins->find(twitchid); it != admins->end())
     {
-        return std::nullopt;
+        return it->second;
     }
-    return std::stoi(*result.data[0][0]);
+    return std::nullopt;
+}
+
+void Users::publish_admins(std::shared_ptr<const AdminTable> next)
+{
+    admins = std::move(next);
+    published_admins.store(admins, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const Users::AdminTable> Users::load_published_admins() const
+{
+    return published_admins.load(std::memory_order_acquire);
+}
+
+std::uint64_t Users::admins_generation() const
+{
+    return generation.load(std::memory_order_acquire);
 }
\ No newline at end of file
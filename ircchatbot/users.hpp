@@ -2,20 +2,35 @@
 #define USERS_HPP_
 
 #include "database.hpp"
+#include "stringhash.hpp"
 
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <string>
 #include <optional>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 class Users
 {
 public:
-    Users();
-    bool add_admin(std::string_view twitchid, int permissions);
-    bool remove_admin(std::string_view twitchid);
+    Users(boost::asio::io_context& io_context);
+    ~Users();
+    // written on the db thread, the in-memory table is updated when the write succeeds
+    void add_admin(std::string_view twitchid, int permissions, DoneHandler on_done = {});
+    void remove_admin(std::string_view twitchid, DoneHandler on_done = {});
+    // known users are absorbed by the cache, new or changed ones are buffered and written in batches
     bool add_user(std::string_view twitchid, std::string_view username);
     bool add_user(std::string_view twitchid, std::string_view username, std::string_view displayname);
 
+    // queues buffered users as one transaction, at most max_users of them, returns number queued
+    std::size_t flush_pending_users(std::size_t max_users = std::numeric_limits<std::size_t>::max());
+
     struct User
     {
         std::string twitchid;
@@ -23,14 +38,48 @@ public:
         std::optional<std::string> displayname;
     };
 
-    std::optional<User> get_user_by_twitchid(std::string_view twitchid);
-    std::optional<User> get_user_by_username(std::string_view username);
-    std::optional<User> get_user_by_displayname(std::string_view displayname);
+    // looked up on the db thread, on_user runs on the io_context
+    using UserHandler = std::function<void(std::optional<User>)>;
+    void get_user_by_twitchid(std::string_view twitchid, UserHandler on_user);
+    void get_user_by_username(std::string_view username, UserHandler on_user);
+    void get_user_by_displayname(std::string_view displayname, UserHandler on_user);
     std::optional<int> get_admin_permissions(std::string_view twitchid);
 
+    // permissions by twitch id, never modified once published
+    using AdminTable = std::unordered_map<std::string, int, StringHash, std::equal_to<>>;
+    // safe from any thread, reload only when the generation changed
+    std::shared_ptr<const AdminTable> load_published_admins() const;
+    std::uint64_t admins_generation() const;
+
+    static constexpr std::size_t pending_users_flush_threshold = 256;
+    static constexpr std::size_t shutdown_flush_limit = 10000;
+    static constexpr std::size_t max_known_users = 200000;
+
 private:
+    boost::asio::io_context& io_context;
     Database users_db;
     void init_db();
+    void get_user(const char* sql, std::string_view value, UserHandler on_user);
+
+    struct KnownUser
+    {
+        std::string username;
+        std::optional<std::string> displayname;
+    };
+    // users the db has, and users buffered or being written
+    std::unordered_map<std::string, KnownUser, StringHash, std::equal_to<>> known_users;
+    std::unordered_map<std::string, KnownUser, StringHash, std::equal_to<>> queued_users;
+    std::vector<User> pending_users;
+
+    // mirror of the admins table, kept write-through so permission checks never hit the db
+    std::shared_ptr<const AdminTable> admins;
+    std::atomic<std::shared_ptr<const AdminTable>> published_admins;
+    std::atomic<std::uint64_t> generation{ 0 };
+    void publish_admins(std::shared_ptr<const AdminTable> next);
+
+    void remember_user(std::string_view twitchid, std::string_view username, std::optional<std::string_view> displayname);
+    // on the io_context once a batch is written or failed
+    void finish_batch(std::vector<User> batch, bool written);
 };
 
 #endif // USERS_HPP_
\ No newline at end of file
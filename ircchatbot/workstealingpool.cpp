@@ -0,0 +1,155 @@
+#include "workstealingpool.hpp"
+
+#include <exception>
+
+#include "logger.hpp"
+
+namespace
+{
+    thread_local const WorkStealingPool* current_pool = nullptr;
+    thread_local std::size_t current_worker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        thread_count = 1;
+    }
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        workers[i]->thread = std::thread([this, i] { run_worker(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard lk(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    // tasks still queued are dropped, their completions never run
+    for (auto&& worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::post(Task task)
+{
+    std::size_t index = current_pool == this ? current_worker : next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    // counted before the push so a thief can never take it below zero
+    pending.fetch_add(1);
+    {
+        auto&& worker = *workers[index];
+        std::lock_guard lk(worker.mutex);
+        worker.tasks.push_back(QueuedTask{ std::move(task), std::chrono::steady_clock::now() });
+    }
+
+    if (sleepers.load() > 0)
+    {
+        std::lock_guard lk(sleep_mutex);
+        sleep_cv.notify_one();
+    }
+}
+
+bool WorkStealingPool::pop_own(std::size_t index, QueuedTask& task)
+{
+    auto&& worker = *workers[index];
+    std::lock_guard lk(worker.mutex);
+    if (worker.tasks.empty())
+    {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(std::size_t index, QueuedTask& task)
+{
+    for (std::size_t offset = 1; offset < workers.size(); ++offset)
+    {
+        auto&& victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard lk(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run_task(QueuedTask& task)
+{
+    try
+    {
+        task.task();
+    }
+    catch (std::exception& e)
+    {
+        log_error(LogCategory::General, std::string("Worker pool task exception: ") + e.what());
+    }
+
+    auto latency = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - task.queued_at).count());
+    executed.fetch_add(1, std::memory_order_relaxed);
+    total_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+    auto max = max_latency_ns.load(std::memory_order_relaxed);
+    while (latency > max && !max_latency_ns.compare_exchange_weak(max, latency, std::memory_order_relaxed))
+    {
+    }
+    task.task = nullptr;
+}
+
+void WorkStealingPool::run_worker(std::size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    QueuedTask task;
+    while (true)
+    {
+        if (pop_own(index, task) || steal(index, task))
+        {
+            pending.fetch_sub(1);
+            run_task(task);
+            continue;
+        }
+
+        std::unique_lock lk(sleep_mutex);
+        if (stopping)
+        {
+            return;
+        }
+        sleepers.fetch_add(1);
+        sleep_cv.wait(lk, [this] { return stopping || pending.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
+
+WorkStealingPool::Stats WorkStealingPool::get_stats() const
+{
+    Stats stats;
+    stats.threads = workers.size();
+    stats.queue_depth = pending.load(std::memory_order_relaxed);
+    stats.executed = executed.load(std::memory_order_relaxed);
+    stats.steals = steals.load(std::memory_order_relaxed);
+    if (stats.executed > 0)
+    {
+        stats.average_latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(total_latency_ns.load(std::memory_order_relaxed) / stats.executed));
+    }
+    stats.max_latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(max_latency_ns.load(std::memory_order_relaxed)));
+    return stats;
+}
\ No newline at end of file
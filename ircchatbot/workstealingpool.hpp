@@ -0,0 +1,93 @@
+#ifndef WORKSTEALINGPOOL_HPP_
+#define WORKSTEALINGPOOL_HPP_
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads for blocking side work; every worker owns a deque, takes its newest task first
+// and steals the oldest task of another worker when its own deque is empty
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(std::size_t thread_count);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // from a worker the task goes to its own deque, otherwise the deques are filled round robin
+    void post(Task task);
+
+    // runs work on the pool and posts on_done with its result to executor
+    template <typename Work, typename Completion>
+    void post(Work work, const boost::asio::any_io_executor& executor, Completion on_done)
+    {
+        post([work = std::move(work), executor, on_done = std::move(on_done)]() mutable
+        {
+            auto result = work();
+            boost::asio::post(executor, [on_done = std::move(on_done), result = std::move(result)]() mutable
+            {
+                on_done(std::move(result));
+            });
+        });
+    }
+
+    struct Stats
+    {
+        std::size_t threads = 0;
+        std::size_t queue_depth = 0;
+        std::uint64_t executed = 0;
+        std::uint64_t steals = 0;
+        // from post until the task finished
+        std::chrono::microseconds average_latency{ 0 };
+        std::chrono::microseconds max_latency{ 0 };
+    };
+    Stats get_stats() const;
+
+private:
+    struct QueuedTask
+    {
+        Task task;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> next_worker{ 0 };
+    std::atomic<std::size_t> pending{ 0 };
+
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<std::size_t> sleepers{ 0 };
+    bool stopping = false;
+
+    std::atomic<std::uint64_t> executed{ 0 };
+    std::atomic<std::uint64_t> steals{ 0 };
+    std::atomic<std::uint64_t> total_latency_ns{ 0 };
+    std::atomic<std::uint64_t> max_latency_ns{ 0 };
+
+    void run_worker(std::size_t index);
+    bool pop_own(std::size_t index, QueuedTask& task);
+    bool steal(std::size_t index, QueuedTask& task);
+    void run_task(QueuedTask& task);
+};
+
+#endif // WORKSTEALINGPOOL_HPP_
\ No newline at end of file